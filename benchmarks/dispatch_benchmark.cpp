@@ -0,0 +1,130 @@
+/**
+ * MMLogger前端分发微基准
+ *
+ * 对比旧的 std::function + std::bind 分发路径与当前函数指针分发路径的
+ * 单次调用开销。sink 为空实现, 只统计字节数, 测得的就是分发本身的成本。
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+#include <ILogger.hpp>
+#include <Log.hpp>
+#include <LogBaseDef.hpp>
+
+namespace {
+
+// 空 sink, final 与库里的 logger 一致
+class NullLogger final : public mm::ILogger {
+ public:
+  int setup() override { return 0; }
+  int teardown() override { return 0; }
+
+  void logVerbose(const char*, const std::size_t len) override { add(len); }
+  void logDebug(const char*, const std::size_t len) override { add(len); }
+  void logInfo(const char*, const std::size_t len) override { add(len); }
+  void logWarn(const char*, const std::size_t len) override { add(len); }
+  void logError(const char*, const std::size_t len) override { add(len); }
+  void logFatal(const char*, const std::size_t len) override { add(len); }
+
+  std::uint64_t bytes() const { return bytes_; }
+
+ private:
+  void add(const std::size_t len) { bytes_ += len; }
+
+  std::uint64_t bytes_ = 0;
+};
+
+// 旧路径: LoggerManager::outputLog 经 std::bind 绑定后存入 std::function
+class LegacyManager {
+ public:
+  explicit LegacyManager(mm::ILogger* logger) : logger_(logger) {}
+
+  void outputLog(const mm::detail::LogLevel lvl, const char* const msg,
+      const std::size_t len) noexcept {
+    switch (lvl) {
+      case mm::detail::LogLevel_Verbose: logger_->logVerbose(msg, len); break;
+      case mm::detail::LogLevel_Debug: logger_->logDebug(msg, len); break;
+      case mm::detail::LogLevel_Info: logger_->logInfo(msg, len); break;
+      case mm::detail::LogLevel_Warn: logger_->logWarn(msg, len); break;
+      case mm::detail::LogLevel_Error: logger_->logError(msg, len); break;
+      case mm::detail::LogLevel_Fatal: logger_->logFatal(msg, len); break;
+      default: break;
+    }
+  }
+
+ private:
+  mm::ILogger* logger_;
+};
+
+using LegacyCallback = std::function<void(
+    const mm::detail::LogLevel, const char* const, const std::size_t)>;
+
+const mm::detail::LogLevel kLevels[] = {mm::detail::LogLevel_Info,
+    mm::detail::LogLevel_Warn, mm::detail::LogLevel_Info,
+    mm::detail::LogLevel_Error};
+
+template <typename Call>
+double measure(const long iterations, const char* msg, const std::size_t len,
+    Call&& call) {
+  const auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; ++i) {
+    call(kLevels[i & 3], msg, len);
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         static_cast<double>(iterations);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const long iterations = (argc > 1) ? std::atol(argv[1]) : 50000000L;
+  const int rounds      = 5;
+
+  const char msg[]      = "2024-01-01 00:00:00.000 01234 dispatch benchmark";
+  const std::size_t len = sizeof(msg) - 1;
+
+  NullLogger legacySink;
+  LegacyManager legacyManager(&legacySink);
+  LegacyCallback legacyCb = std::bind(&LegacyManager::outputLog,
+      &legacyManager, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3);
+
+  // 当前路径: 与 LoggerManager::setupLogger 相同, 经 writeLog 进入 sink
+  NullLogger fastSink;
+  mm::detail::setupLogger(&mm::detail::dispatchLog<NullLogger>, &fastSink,
+      mm::detail::LogLevelCfg_Verbose, mm::detail::LogSinkType_Stdout, false);
+
+  std::printf("iterations per round: %ld, best of %d rounds\n", iterations,
+      rounds);
+
+  double legacyBest = 0.0;
+  double fastBest   = 0.0;
+  for (int r = 0; r < rounds; ++r) {
+    const double legacy = measure(iterations, msg, len,
+        [&legacyCb](const mm::detail::LogLevel lvl, const char* m,
+            const std::size_t n) { legacyCb(lvl, m, n); });
+    const double fast   = measure(iterations, msg, len,
+        [](const mm::detail::LogLevel lvl, const char* m,
+            const std::size_t n) { mm::detail::writeLog(lvl, m, n); });
+
+    legacyBest = (0 == r || legacy < legacyBest) ? legacy : legacyBest;
+    fastBest   = (0 == r || fast < fastBest) ? fast : fastBest;
+  }
+
+  mm::detail::teardownLogger();
+
+  std::printf("std::function + bind : %6.2f ns/call\n", legacyBest);
+  std::printf("function pointer     : %6.2f ns/call\n", fastBest);
+  std::printf("saved                : %6.2f ns/call (%.1f%%)\n",
+      legacyBest - fastBest, 100.0 * (legacyBest - fastBest) / legacyBest);
+
+  // 防止 sink 被优化掉
+  return (legacySink.bytes() == fastSink.bytes()) ? 0 : 1;
+}
@@ -10,6 +10,7 @@ INSTALL_PREFIX="/usr/local"
 BUILD_SHARED=ON
 BUILD_EXAMPLES=OFF
 BUILD_TESTS=OFF
+BUILD_TOOLS=OFF
 ENABLE_DEBUG=OFF
 INSTALL_LIB=OFF
 
@@ -37,6 +38,10 @@ while [[ $# -gt 0 ]]; do
             BUILD_TESTS=ON
             shift
             ;;
+        --tools)
+            BUILD_TOOLS=ON
+            shift
+            ;;
         --enable-debug-logs)
             ENABLE_DEBUG=ON
             shift
@@ -53,6 +58,7 @@ while [[ $# -gt 0 ]]; do
             echo "  --static                Build static libraries instead of shared"
             echo "  --examples              Build example applications"
             echo "  --tests                 Build test applications"
+            echo "  --tools                 Build log tools (mmlog-query, mmlog-grep, mmlog-find, mmlog-merge)"
             echo "  --enable-debug-logs     Enable debug logging"
             echo "  --install               Install the library after building"
             echo "  --help                  Show this help message"
@@ -77,6 +83,7 @@ cmake .. \
     -DBUILD_SHARED_LIBS="$BUILD_SHARED" \
     -DMM_BUILD_EXAMPLES="$BUILD_EXAMPLES" \
     -DMM_BUILD_TESTS="$BUILD_TESTS" \
+    -DMM_BUILD_TOOLS="$BUILD_TOOLS" \
     -DMM_ENABLE_DEBUG="$ENABLE_DEBUG"
 
 # Build project
@@ -3,6 +3,7 @@
 #include <Log.hpp>
 #include <LoggerManager.hpp>
 #include <LogBaseDef.hpp>
+#include <TypedLog.hpp>
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -131,6 +132,11 @@ void demoBasicLogging() {
   MM_INFO("支持格式化: 整数=%d, 字符串=%s, 浮点数=%.2f", 42, "Hello World",
       3.14159);
 
+  // 类型安全的日志: 格式串在编译期检查, 参数类型不匹配直接编译失败
+  const std::string name = "Hello World";
+  MM_LOG(Info, "类型安全格式化: 整数=%d, 字符串=%s, 浮点数=%.2f", 42, name,
+      3.14159);
+
   // 带文件、函数、行号信息的日志
   MM_INFO("日志会自动包含文件、函数和行号信息");
 
@@ -180,6 +186,11 @@ void demoRateLimitedLogging() {
     rateLimitedLogger.Log(
         mm::detail::LogLevel_Info, "这是速率限制的日志 #%d", i);
 
+    // 宏版本: 每个调用点自带无锁状态, 被抑制时不会对参数求值
+    MM_INFO_EVERY_MS(1000, "这是按时间限速的日志 #%d", i);
+    MM_WARN_EVERY_N(3, "这是每3次输出一次的日志 #%d", i);
+    MM_ERROR_FIRST_N(2, "这是只输出前2次的日志 #%d", i);
+
     // 这些非速率限制的日志将全部输出
     MM_INFO("这是常规日志 #%d", i);
 
@@ -88,6 +88,19 @@ int main(int argc, char* argv[]) {
   MM_INFO("Rate: %f logs/second",
       (numThreads * logsPerThread * 1000.0) / duration.count());
 
+  // Counters of the logger so far
+  mm::LoggerStats stats;
+  if (MM_STATUS_OK == logManager.getStats(stats)) {
+    MM_INFO("Enqueued: %lu, Processed: %lu, Dropped: %lu, Overflow: %lu",
+        static_cast<unsigned long>(stats.enqueued),
+        static_cast<unsigned long>(stats.processed),
+        static_cast<unsigned long>(stats.dropped),
+        static_cast<unsigned long>(stats.overflow));
+    MM_INFO("End to end latency p50: %.1f us, p99: %.1f us, max: %.1f us",
+        stats.endToEnd.percentile(50) / 1e3,
+        stats.endToEnd.percentile(99) / 1e3, stats.endToEnd.max() / 1e3);
+  }
+
   // Clean up
   logManager.teardown();
 
@@ -0,0 +1,277 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_ASYNCFILELOGGER_HPP_
+#define INCLUDE_COMMON_LOG_ASYNCFILELOGGER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DisallowCopy.hpp"
+#include "ILogger.hpp"
+#include "LatencyHistogram.hpp"
+#include "LogCompressor.hpp"
+#include "LogFile.hpp"
+#include "LogMaintainer.hpp"
+#include "UringFileWriter.hpp"
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * @brief Fixed size buffer of newline terminated messages
+ */
+class LogFileBuffer {
+ public:
+  /**
+   * @param index Index of the buffer registered with the io_uring writer,
+   * -1 if it is not registered
+   */
+  LogFileBuffer(
+      char* data, const std::size_t capacity, const int index = -1) noexcept
+      : data_(data),
+        capacity_(capacity),
+        size_(0),
+        count_(0),
+        index_(index),
+        firstNs_(0) {}
+
+  /**
+   * @brief Appends msg and a newline, the first message also stamps the
+   * buffer with the wall clock time
+   *
+   * @return false if they do not fit
+   */
+  bool append(const char* msg, const std::size_t len) noexcept;
+
+  void reset() noexcept {
+    size_    = 0;
+    count_   = 0;
+    firstNs_ = 0;
+  }
+
+  const char* data() const noexcept { return data_.get(); }
+  std::size_t size() const noexcept { return size_; }
+  std::size_t capacity() const noexcept { return capacity_; }
+  std::size_t count() const noexcept { return count_; }
+  int index() const noexcept { return index_; }
+  int64_t firstNs() const noexcept { return firstNs_; }
+
+ private:
+  std::unique_ptr<char[]> data_;
+  std::size_t capacity_;
+  std::size_t size_;
+  std::size_t count_;  // Messages held
+  int index_;
+  int64_t firstNs_;  // Wall clock time the first message was appended
+
+  MM_DISALLOW_COPY_AND_MOVE(LogFileBuffer)
+};
+
+}  // namespace detail
+
+/**
+ * @brief Asynchronous file sink with double buffering
+ *
+ * Producers append formatted messages to the current buffer under a short
+ * lock. A filled buffer is moved to the pending list and replaced by the
+ * spare one, and a single writer thread swaps the whole list out, writing
+ * each buffer with one write(2). There is no per message allocation, pool or
+ * queue entry, and the writer returns the buffers for reuse. Partly filled
+ * buffers are written at least once per flush interval.
+ *
+ * With FileWriter_Uring the writer submits every swapped out buffer in one
+ * io_uring_enter(2) instead, up to uringDepth writes at explicit offsets stay
+ * in flight while it swaps the next ones out. uringDepth buffers and the
+ * spares are allocated and registered with the ring up front, and the log
+ * file is registered as a fixed file. Without io_uring each batch is written
+ * with pwritev(2).
+ *
+ * With FileWriter_Mmap and no compression there are no buffers, producers
+ * copy each message straight into a mapped window of the file under the
+ * lock, so a crash of the process loses nothing logged. The writer maps the
+ * next window ahead of them and syncs and unmaps the ones they are done
+ * with.
+ *
+ * With FileCompress_Gzip the writer compresses each batch into one gzip
+ * member before writing it, the segments are then readable with zcat.
+ *
+ * After each batch the writer syncs the file as fileConfig.sync asks.
+ *
+ * Levels are filtered by the front end, every message given to this sink is
+ * written.
+ */
+class AsyncFileLogger final : public ILogger {
+ public:
+  /**
+   * @param appId Base name of the log files
+   * @param logFilePath Directory of the log files, empty = "./logs/"
+   * @param fileConfig Buffer, flush and roll settings
+   * @param maintainConfig Compression and retention of the rolled segments
+   */
+  AsyncFileLogger(const std::string& appId, const LogFilePath logFilePath,
+      const LogFileConfig& fileConfig = LogFileConfig(),
+      const LogMaintainConfig& maintainConfig = LogMaintainConfig()) noexcept;
+
+  virtual ~AsyncFileLogger() override;
+
+  virtual int setup() override;
+  virtual int teardown() override;
+
+  virtual void logVerbose(const char* msg, const std::size_t len) override;
+  virtual void logDebug(const char* msg, const std::size_t len) override;
+  virtual void logInfo(const char* msg, const std::size_t len) override;
+  virtual void logWarn(const char* msg, const std::size_t len) override;
+  virtual void logError(const char* msg, const std::size_t len) override;
+  virtual void logFatal(const char* msg, const std::size_t len) override;
+
+  virtual int getStats(LoggerStats& stats) const override;
+
+ private:
+  using BufferPtr = std::unique_ptr<detail::LogFileBuffer>;
+
+  /**
+   * @brief Appends a message to the current buffer
+   *
+   * @param urgent Wakes the writer without waiting for a full buffer
+   */
+  void append(const char* msg, const std::size_t len, const bool urgent);
+
+  /**
+   * @brief Copies a message into the mapped window, with mappedWrites_
+   */
+  void appendMapped(const char* msg, const std::size_t len, const bool urgent);
+
+  /**
+   * @brief Allocates a buffer of bufferSize_ bytes, null on failure
+   */
+  BufferPtr newBuffer() const noexcept;
+
+  /**
+   * @brief Allocates and registers the io_uring writer's buffers as spares,
+   * false if io_uring is unavailable
+   */
+  bool setupUring();
+
+  /**
+   * @brief Writer thread, swaps the filled buffers out and writes them
+   */
+  void writerThread();
+
+  /**
+   * @brief Writer thread with mappedWrites_, maps the windows ahead of the
+   * producers and syncs the ones they wrote
+   */
+  void mappedWriterThread();
+
+  /**
+   * @brief Writes or submits buffers with the configured writer, taking
+   * them out of the vector
+   */
+  void writeBuffers(std::vector<BufferPtr>& buffers);
+
+  void compressBuffers(std::vector<BufferPtr>& buffers);
+  void submitBuffers(std::vector<BufferPtr>& buffers);
+  void pwriteBuffers(std::vector<BufferPtr>& buffers);
+
+  /**
+   * @brief Completes the finished io_uring writes
+   *
+   * @param waitFor Blocks until this many writes are finished
+   */
+  void reapWrites(const unsigned waitFor);
+
+  // Waits for every io_uring write in flight
+  void drainWrites();
+
+  /**
+   * @brief Leaves io_uring for pwritev(2): closes the ring, writes again
+   * what it did not complete, then writes buffers from first on, the first
+   * one at the offset already reserved for it
+   */
+  void stopUring(std::vector<BufferPtr>& buffers, std::size_t first,
+      const int fd, const off_t offset, const int64_t startNs);
+
+  /**
+   * @brief Accounts for a written buffer and keeps it for reuse
+   */
+  void writeDone(BufferPtr buffer, const bool ok, const int64_t startNs);
+
+  const std::size_t bufferSize_;
+  const std::chrono::milliseconds flushInterval_;
+  const std::size_t maxBuffers_;
+  const detail::FileWriter fileWriter_;
+  const std::size_t uringDepth_;
+  const detail::FileSync fileSync_;
+  const detail::FileCompress fileCompress_;
+  const int compressLevel_;
+  const bool mappedWrites_;  // Producers write the mapped file themselves
+
+  detail::LogFile file_;
+  detail::LogMaintainer maintainer_;  // Of the rolled segments
+
+  // Producer side, guarded by mutex_
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  BufferPtr current_;               // Buffer the producers append to
+  BufferPtr next_;                  // Spare taking over when current_ fills
+  std::vector<BufferPtr> buffers_;  // Filled, waiting for the writer
+  bool running_;
+  uint64_t enqueued_;
+  uint64_t dropped_;  // Messages lost while maxBuffers_ were pending
+  bool windowWake_;   // Writer woken to map the next window
+
+  // Writer side
+  std::thread writer_;
+  std::vector<BufferPtr> spares_;  // Written buffers kept for reuse
+  bool writeFailed_;               // Reported until a write succeeds
+  std::atomic<uint64_t> processed_;
+  detail::LatencyHistogram writeLatency_;  // One sample per buffer
+  detail::LogCompressor compressor_;
+
+  // io_uring writes, writer side
+  struct InFlightWrite {
+    BufferPtr buffer;
+    int fd;
+    off_t offset;
+    int64_t startNs;
+  };
+  detail::UringFileWriter uring_;
+  bool uringActive_;                   // Set up, else pwritev(2)
+  int uringFd_;                        // Descriptor registered as fixed file
+  std::vector<InFlightWrite> writes_;  // By user data, uringDepth_ slots
+
+  MM_DISALLOW_COPY_AND_MOVE(AsyncFileLogger)
+};
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_ASYNCFILELOGGER_HPP_
@@ -0,0 +1,472 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_BASICLOGGER_HPP_
+#define INCLUDE_COMMON_LOG_BASICLOGGER_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "DisallowCopy.hpp"
+#include "ILogger.hpp"
+#include "LogBaseDef.hpp"
+#include "LoggerStatus.hpp"
+#include "StdoutLogger.hpp"
+#include "TypedLog.hpp"
+
+/**
+ * Compile time configured logger for binaries that know their sink, queue
+ * and formatter at build time. Everything from the call site to the sink is
+ * resolved statically, so the compiler can inline the whole path; the
+ * runtime configured LoggerFactory / LoggerManager front stays for
+ * everything else.
+ *
+ *   using ConsoleLogger =
+ *       mm::BasicLogger<mm::TimestampFormatter, mm::SyncQueue, mm::StdoutSink>;
+ *
+ *   ConsoleLogger logger(mm::detail::LogLevelCfg_Info);
+ *   logger.setup();
+ *   MM_BASIC_LOG(logger, Info, "frame %d took %.2f ms", id, ms);
+ *
+ * Policies:
+ *   Formatter  static format(buf, len, lvl, fmt, args...) -> message length
+ *   Queue      start(sink), push(sink, lvl, msg, len), stop()
+ *   Sink       setup(), teardown(), write(lvl, msg, len)
+ */
+
+namespace mm {
+
+namespace detail {
+
+// Appends the call site and the body of fmt behind offset bytes of buf
+template <typename Tag, typename... Args>
+inline std::size_t formatBasicMessage(char* buf, const std::size_t len,
+    const int offset, const LogLevel lvl, const TypedFormat<Tag>& fmt,
+    const Args&... args) noexcept {
+  if (0 > offset) {
+    return 0;
+  }
+
+  std::size_t pos = static_cast<std::size_t>(offset);
+  if (pos < len) {
+    const int n = formatLogCallSite(
+        buf + pos, len - pos, lvl, fmt.file, fmt.func, fmt.line);
+    if (0 > n) {
+      return 0;
+    }
+    pos += static_cast<std::size_t>(n);
+  }
+
+  if (pos < len) {
+    const int n = formatTypedBody<Tag>(buf + pos, len - pos, args...);
+    if (0 > n) {
+      return 0;
+    }
+    pos += static_cast<std::size_t>(n);
+  }
+
+  return (pos < len) ? pos : len - 1;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Formatter policy: timestamp, tid, call site and message, the layout
+ * of the Stdout sink
+ */
+struct TimestampFormatter {
+  template <typename Tag, typename... Args>
+  static std::size_t format(char* buf, const std::size_t len,
+      const detail::LogLevel lvl, const detail::TypedFormat<Tag>& fmt,
+      const Args&... args) noexcept {
+    const int offset = detail::formatLogTimestamp(buf, len);
+    return detail::formatBasicMessage(buf, len, offset, lvl, fmt, args...);
+  }
+};
+
+/**
+ * @brief Formatter policy: call site and message only, for sinks that stamp
+ * by themselves (glog)
+ */
+struct PlainFormatter {
+  template <typename Tag, typename... Args>
+  static std::size_t format(char* buf, const std::size_t len,
+      const detail::LogLevel lvl, const detail::TypedFormat<Tag>& fmt,
+      const Args&... args) noexcept {
+    return detail::formatBasicMessage(buf, len, 0, lvl, fmt, args...);
+  }
+};
+
+/**
+ * @brief Queue policy: the caller writes to the sink itself
+ *
+ * Callers in the sink are counted, so that stop() returns only once none is
+ * left and the sink can be torn down.
+ */
+class SyncQueue {
+ public:
+  SyncQueue() noexcept = default;
+
+  MM_DISALLOW_COPY_AND_MOVE(SyncQueue)
+
+  template <typename Sink>
+  int start(Sink& sink) noexcept {
+    (void)sink;
+    stopped_.store(false, std::memory_order_release);
+    return MM_STATUS_OK;
+  }
+
+  // Rejects the pushes from here on and waits for those in the sink
+  void stop() noexcept {
+    stopped_.store(true, std::memory_order_seq_cst);
+    while (0 != writers_.load(std::memory_order_seq_cst)) {
+      std::this_thread::yield();
+    }
+  }
+
+  template <typename Sink>
+  bool push(Sink& sink, const detail::LogLevel lvl, const char* msg,
+      const std::size_t len) noexcept {
+    // counted before the check, stop() either sees the count or is seen
+    writers_.fetch_add(1, std::memory_order_seq_cst);
+    if (stopped_.load(std::memory_order_seq_cst)) {
+      writers_.fetch_sub(1, std::memory_order_release);
+      return false;
+    }
+
+    sink.write(lvl, msg, len);
+    writers_.fetch_sub(1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  std::atomic<bool> stopped_{true};
+  std::atomic<std::uint32_t> writers_{0};
+};
+
+/**
+ * @brief Queue policy: bounded ring of fixed size slots drained by one
+ * worker thread
+ *
+ * Messages longer than a slot are truncated, and messages arriving while
+ * the ring is full are dropped and counted, the caller never blocks on the
+ * sink.
+ *
+ * @tparam Capacity number of slots, a power of two
+ * @tparam SlotSize bytes per slot, terminator included
+ */
+template <std::size_t Capacity = 4096, std::size_t SlotSize = 512>
+class AsyncQueue {
+  static_assert((Capacity > 0) && (0 == (Capacity & (Capacity - 1))),
+      "AsyncQueue capacity must be a power of two");
+  static_assert(SlotSize > 1, "AsyncQueue slots must hold a message");
+
+ public:
+  AsyncQueue() noexcept = default;
+  ~AsyncQueue() { stop(); }
+
+  MM_DISALLOW_COPY_AND_MOVE(AsyncQueue)
+
+  template <typename Sink>
+  int start(Sink& sink) noexcept {
+    Slot* slots = new (std::nothrow) Slot[Capacity];
+    if (!slots) {
+      return MM_STATUS_ENOMEM;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (slots_) {
+        delete[] slots;
+        return MM_STATUS_OK;
+      }
+
+      slots_    = slots;
+      head_     = 0;
+      tail_     = 0;
+      shutdown_ = false;
+    }
+
+    try {
+      worker_ = std::thread([this, &sink] { run(sink); });
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      delete[] slots_;
+      slots_ = nullptr;
+      return MM_STATUS_ERROR;
+    }
+
+    return MM_STATUS_OK;
+  }
+
+  // Drains the queued messages and joins the worker, pushes are rejected
+  // from here on
+  void stop() noexcept {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!slots_ || shutdown_) {
+        return;
+      }
+      shutdown_ = true;
+    }
+    cv_.notify_one();
+
+    if (worker_.joinable()) {
+      worker_.join();
+    }
+
+    // a push holding the lock has finished with the slots once it is ours
+    Slot* slots = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::swap(slots, slots_);
+    }
+    delete[] slots;
+  }
+
+  template <typename Sink>
+  bool push(Sink& sink, const detail::LogLevel lvl, const char* msg,
+      const std::size_t len) noexcept {
+    (void)sink;
+
+    const std::size_t copy = (len < SlotSize) ? len : SlotSize - 1;
+    bool wake              = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!slots_ || shutdown_ || (Capacity == head_ - tail_)) {
+        ++dropped_;
+        return false;
+      }
+
+      Slot& slot = slots_[head_ & (Capacity - 1)];
+      slot.lvl   = lvl;
+      slot.len   = copy;
+      std::memcpy(slot.msg, msg, copy);
+      slot.msg[copy] = '\0';
+
+      // the worker only sleeps on an empty ring
+      wake = (head_++ == tail_);
+    }
+
+    if (wake) {
+      cv_.notify_one();
+    }
+    return true;
+  }
+
+  std::uint64_t droppedCount() const noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+  }
+
+ private:
+  struct Slot {
+    detail::LogLevel lvl;
+    std::size_t len;
+    char msg[SlotSize];
+  };
+
+  template <typename Sink>
+  void run(Sink& sink) noexcept {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this] { return shutdown_ || (head_ != tail_); });
+      if (head_ == tail_) {
+        break;  // shut down and drained
+      }
+
+      // slots in [tail_, end) stay ours until tail_ moves past them
+      const std::uint64_t begin = tail_;
+      const std::uint64_t end   = head_;
+      lock.unlock();
+
+      for (std::uint64_t i = begin; i != end; ++i) {
+        const Slot& slot = slots_[i & (Capacity - 1)];
+        sink.write(slot.lvl, slot.msg, slot.len);
+      }
+
+      lock.lock();
+      tail_ = end;
+    }
+  }
+
+  Slot* slots_           = nullptr;
+  std::uint64_t head_    = 0;
+  std::uint64_t tail_    = 0;
+  std::uint64_t dropped_ = 0;
+  bool shutdown_         = false;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread worker_;
+};
+
+/**
+ * @brief Sink policy: console output of StdoutLogger, inlined
+ */
+class StdoutSink {
+ public:
+  int setup() noexcept { return MM_STATUS_OK; }
+  int teardown() noexcept { return MM_STATUS_OK; }
+
+  void write(const detail::LogLevel lvl, const char* msg,
+      const std::size_t len) noexcept {
+    (void)lvl;
+    detail::writeStdoutLine(msg, len);
+  }
+};
+
+/**
+ * @brief Sink policy: adapts any of the final loggers, i.e. GlogLogger or
+ * OptimizedGlogLogger, calling it without virtual dispatch
+ *
+ * @tparam Logger concrete logger, constructed from the BasicLogger's
+ * trailing constructor arguments
+ */
+template <typename Logger>
+class LoggerSink {
+ public:
+  template <typename... LoggerArgs>
+  explicit LoggerSink(LoggerArgs&&... args) noexcept
+      : logger_(std::forward<LoggerArgs>(args)...) {}
+
+  MM_DISALLOW_COPY_AND_MOVE(LoggerSink)
+
+  int setup() noexcept { return logger_.setup(); }
+  int teardown() noexcept { return logger_.teardown(); }
+
+  void write(const detail::LogLevel lvl, const char* msg,
+      const std::size_t len) noexcept {
+    detail::dispatchLog<Logger>(&logger_, lvl, msg, len);
+  }
+
+  Logger& logger() noexcept { return logger_; }
+
+ private:
+  Logger logger_;
+};
+
+/**
+ * @brief Logger whose formatter, queue and sink are fixed at compile time
+ *
+ * @tparam Formatter i.e. TimestampFormatter or PlainFormatter
+ * @tparam Queue i.e. SyncQueue or AsyncQueue<>
+ * @tparam Sink i.e. StdoutSink or LoggerSink<GlogLogger>
+ */
+template <typename Formatter, typename Queue, typename Sink>
+class BasicLogger {
+ public:
+  /**
+   * @param levels Level mask (detail::LogLevelCfg_*) to emit
+   * @param sinkArgs Forwarded to the Sink constructor
+   */
+  template <typename... SinkArgs>
+  explicit BasicLogger(
+      const detail::LogLevelCfg levels, SinkArgs&&... sinkArgs) noexcept
+      : levels_(levels), sink_(std::forward<SinkArgs>(sinkArgs)...) {}
+
+  ~BasicLogger() { teardown(); }
+
+  MM_DISALLOW_COPY_AND_MOVE(BasicLogger)
+
+  int setup() noexcept {
+    if (started_.load(std::memory_order_acquire)) {
+      return MM_STATUS_OK;
+    }
+
+    int ec = sink_.setup();
+    if (MM_STATUS_OK != ec) {
+      return ec;
+    }
+
+    ec = queue_.start(sink_);
+    if (MM_STATUS_OK != ec) {
+      sink_.teardown();
+      return ec;
+    }
+
+    started_.store(true, std::memory_order_release);
+    return MM_STATUS_OK;
+  }
+
+  int teardown() noexcept {
+    // the queue rejects the messages logged meanwhile and its stop() waits
+    // for those already in the sink
+    if (!started_.exchange(false, std::memory_order_acq_rel)) {
+      return MM_STATUS_OK;
+    }
+
+    queue_.stop();
+    return sink_.teardown();
+  }
+
+  bool isEnabled(const detail::LogLevel lvl) const noexcept {
+    return 0 != (levels_ & lvl);
+  }
+
+  /**
+   * @brief Formats and emits one message, see MM_BASIC_LOG()
+   *
+   * @param fmt format built with MM_FMT(), checked against args at compile
+   * time as for mm::log()
+   */
+  template <detail::LogLevel Level, typename Tag, typename... Args>
+  void log(const detail::TypedFormat<Tag>& fmt, const Args&... args) noexcept {
+    using Traits = detail::TypedFormatTraits<Tag, Args...>;
+
+    if (!started_.load(std::memory_order_acquire) || !isEnabled(Level)) {
+      return;
+    }
+
+    char buf[Traits::bufferSize];
+    const std::size_t len =
+        Formatter::format(buf, sizeof(buf), Level, fmt, args...);
+    if (0 < len) {
+      queue_.push(sink_, Level, buf, len);
+    }
+  }
+
+  Queue& queue() noexcept { return queue_; }
+  Sink& sink() noexcept { return sink_; }
+
+ private:
+  const detail::LogLevelCfg levels_;
+  std::atomic<bool> started_{false};
+  Queue queue_;
+  Sink sink_;
+};
+
+}  // namespace mm
+
+// lvl is one of Verbose, Debug, Info, Warn, Error, Fatal
+#define MM_BASIC_LOG(logger, lvl, fmt, ...) \
+  (logger).template log<mm::detail::LogLevel_##lvl>(MM_FMT(fmt), ##__VA_ARGS__)
+
+#endif  // INCLUDE_COMMON_LOG_BASICLOGGER_HPP_
@@ -25,6 +25,7 @@
 #define INCLUDE_COMMON_LOG_ILOGGER_HPP_
 
 #include "LogBaseDef.hpp"
+#include "LoggerStatus.hpp"
 
 namespace mm {
 
@@ -44,8 +45,46 @@ class ILogger {
   virtual void logWarn(const char* msg, const std::size_t len)    = 0;
   virtual void logError(const char* msg, const std::size_t len)   = 0;
   virtual void logFatal(const char* msg, const std::size_t len)   = 0;
+
+  /**
+   * @brief Adds the logger's counters to stats
+   *
+   * @return MM_STATUS_ENOENT when the logger keeps no statistics
+   */
+  virtual int getStats(LoggerStats& stats) const {
+    (void)(stats);
+    return MM_STATUS_ENOENT;
+  }
 };
 
+namespace detail {
+
+/**
+ * @brief Front end callback forwarding to a logger of concrete type Logger
+ *
+ * The loggers are final, so once instantiated for the concrete type the
+ * calls below are direct and the front end pays for a single indirect call.
+ * Instantiated for ILogger it falls back to virtual dispatch.
+ *
+ * @param ctx the Logger registered with setupLogger()
+ */
+template <typename Logger>
+void dispatchLog(void* ctx, const LogLevel lvl, const char* const msg,
+    const std::size_t len) noexcept {
+  Logger* logger = static_cast<Logger*>(ctx);
+  switch (lvl) {
+    case LogLevel_Verbose: logger->logVerbose(msg, len); break;
+    case LogLevel_Debug: logger->logDebug(msg, len); break;
+    case LogLevel_Info: logger->logInfo(msg, len); break;
+    case LogLevel_Warn: logger->logWarn(msg, len); break;
+    case LogLevel_Error: logger->logError(msg, len); break;
+    case LogLevel_Fatal: logger->logFatal(msg, len); break;
+    default: break;
+  }
+}
+
+}  // namespace detail
+
 }  // namespace mm
 
 #endif  // INCLUDE_COMMON_LOG_ILOGGER_HPP_
@@ -0,0 +1,158 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_LATENCYHISTOGRAM_HPP_
+#define INCLUDE_COMMON_LOG_LATENCYHISTOGRAM_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * Log-linear (HDR style) bucketing of nanosecond values: values below
+ * 2^LatencySubBucketBits get a bucket each, above that every power of two is
+ * split into 2^LatencySubBucketBits linear buckets, so a bucket is never
+ * wider than 1/32 (~3%) of the values it holds. Values from 2^40 ns (~18
+ * minutes) on share the last bucket.
+ */
+enum : unsigned { LatencySubBucketBits = 5 };
+enum : unsigned { LatencyMaxValueBits = 40 };
+enum : std::size_t {
+  LatencySubBucketCount = std::size_t{1} << LatencySubBucketBits,
+  LatencyBucketCount    = (LatencyMaxValueBits - LatencySubBucketBits + 1) *
+                           LatencySubBucketCount,
+};
+
+constexpr std::size_t latencyBucketIndex(const std::uint64_t ns) noexcept {
+  if (ns < LatencySubBucketCount) {
+    return static_cast<std::size_t>(ns);
+  }
+
+  if (ns >> LatencyMaxValueBits) {
+    return LatencyBucketCount - 1;
+  }
+
+  const unsigned msb   = 63u - static_cast<unsigned>(__builtin_clzll(ns));
+  const unsigned shift = msb - LatencySubBucketBits;
+  return (shift + 1) * LatencySubBucketCount +
+         static_cast<std::size_t>((ns >> shift) - LatencySubBucketCount);
+}
+
+// Largest value that falls into bucket index
+constexpr std::uint64_t latencyBucketUpperBound(
+    const std::size_t index) noexcept {
+  if (index < LatencySubBucketCount) {
+    return index;
+  }
+
+  const std::size_t shift = index / LatencySubBucketCount - 1;
+  const std::uint64_t sub = index % LatencySubBucketCount;
+  return ((LatencySubBucketCount + sub + 1) << shift) - 1;
+}
+
+class LatencyHistogram;
+
+}  // namespace detail
+
+/**
+ * @brief Copy of one or more latency histograms, for percentile queries
+ *
+ * All values are in nanoseconds. Percentiles are reported as the upper bound
+ * of the bucket holding them, i.e. at most ~3% above the exact value.
+ */
+class LatencySnapshot {
+ public:
+  LatencySnapshot() noexcept : count_(0), sum_(0), max_(0) {}
+
+  std::uint64_t count() const noexcept { return count_; }
+  std::uint64_t max() const noexcept { return max_; }
+  double mean() const noexcept {
+    return count_ ? static_cast<double>(sum_) / count_ : 0.0;
+  }
+
+  /**
+   * @brief Value below which percent of the samples fall
+   *
+   * @param percent in [0, 100], i.e. 99.9
+   * @return 0 when the snapshot is empty
+   */
+  std::uint64_t percentile(const double percent) const noexcept;
+
+  /**
+   * @brief Adds the samples of other
+   */
+  void merge(const LatencySnapshot& other);
+
+ private:
+  friend class detail::LatencyHistogram;
+
+  std::vector<std::uint64_t> counts_;  // empty until the first sample
+  std::uint64_t count_;
+  std::uint64_t sum_;
+  std::uint64_t max_;
+};
+
+namespace detail {
+
+/**
+ * @brief Concurrent log-linear latency histogram
+ *
+ * record() is a few relaxed atomic adds, and addTo() reads the buckets
+ * without locking, so statistics can be taken while workers keep recording.
+ * A snapshot taken under load may be off by the samples in flight.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram() noexcept;
+
+  void record(const std::uint64_t ns) noexcept {
+    counts_[latencyBucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+
+    std::uint64_t max = max_.load(std::memory_order_relaxed);
+    while ((ns > max) &&
+           !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+   * @brief Adds the current samples to snapshot
+   */
+  void addTo(LatencySnapshot& snapshot) const;
+
+ private:
+  std::atomic<std::uint64_t> counts_[LatencyBucketCount];
+  std::atomic<std::uint64_t> sum_;
+  std::atomic<std::uint64_t> max_;
+};
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_LATENCYHISTOGRAM_HPP_
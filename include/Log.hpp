@@ -29,8 +29,8 @@
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <cstring>
-#include <unordered_map>
 #include <string>
 
 #include "LogBaseDef.hpp"
@@ -39,11 +39,14 @@ namespace mm {
 
 namespace detail {
 
-static const int64_t mTimeStampDelta = 1000;
-static std::unordered_map<std::string, int64_t> mmKeyTimeStamp;
+enum { LogStackBufferSize = 2048 };
 
-void setupLogger(detail::LogCallback&& cb, const detail::LogLevelCfg cfg,
-    const LogSinkType stype) noexcept;
+// Upper bound of formatLogPrefix(), timestamp and tid included
+enum { LogPrefixMaxSize = 128 };
+
+void setupLogger(const detail::LogCallback cb, void* ctx,
+    const detail::LogLevelCfg cfg, const LogSinkType stype,
+    const bool timestamp) noexcept;
 
 void teardownLogger() noexcept;
 
@@ -51,6 +54,39 @@ void outputLog(const detail::LogLevel lvl, const char* const file,
     const char* const func, const int line, const char* const fmt,
     ...) noexcept;
 
+/**
+ * @brief Whether a message of lvl passes the front end filter
+ */
+bool isLogEnabled(const detail::LogLevel lvl) noexcept;
+
+/**
+ * @brief Formats "YYYY-mm-dd HH:MM:SS.mmm tid", snprintf style
+ */
+int formatLogTimestamp(char* buf, const std::size_t len) noexcept;
+
+/**
+ * @brief Formats the call site, i.e. " Example::main() 0042 I: ", snprintf
+ * style
+ */
+int formatLogCallSite(char* buf, const std::size_t len,
+    const detail::LogLevel lvl, const char* const file,
+    const char* const func, const int line) noexcept;
+
+/**
+ * @brief Formats the timestamp and call site prefix of a message
+ *
+ * @return the length of the prefix, snprintf style
+ */
+int formatLogPrefix(char* buf, const std::size_t len,
+    const detail::LogLevel lvl, const char* const file,
+    const char* const func, const int line) noexcept;
+
+/**
+ * @brief Hands a formatted message to the installed sink
+ */
+void writeLog(const detail::LogLevel lvl, const char* const msg,
+    const std::size_t len) noexcept;
+
 std::string convertOutputLogToStr(const detail::LogLevel lvl,
     const char* const file, const char* const func, const int line,
     const char* const fmt, ...) noexcept;
@@ -107,6 +143,71 @@ bool noError(int ec) noexcept;
   mm::detail::outputLog(mm::detail::LogLevel_Fatal, __file__, __func__, \
       __LINE__, fmt, ##__VA_ARGS__)
 
+/**
+ * Rate limited variants. Every call site owns a static, lock-free state, and
+ * the arguments are only evaluated when the message is actually emitted.
+ *   MM_INFO_EVERY_MS(1000, "queue depth %zu", depth());  // once a second
+ *   MM_WARN_EVERY_N(100, "retry %d", n);                 // 1st, 101st, ...
+ *   MM_ERROR_FIRST_N(3, "bad frame %d", id);             // first 3 only
+ */
+#define MM_LOG_EVERY_MS_IMPL(LOG, ms, fmt, ...)                 \
+  do {                                                          \
+    static mm::detail::LogEveryMsState mmLogEveryMsState;       \
+    if (mmLogEveryMsState.shouldLog(ms)) {                      \
+      LOG(fmt, ##__VA_ARGS__);                                  \
+    }                                                           \
+  } while (0)
+
+#define MM_LOG_EVERY_N_IMPL(LOG, n, fmt, ...)                   \
+  do {                                                          \
+    static mm::detail::LogEveryNState mmLogEveryNState;         \
+    if (mmLogEveryNState.shouldLog(n)) {                        \
+      LOG(fmt, ##__VA_ARGS__);                                  \
+    }                                                           \
+  } while (0)
+
+#define MM_LOG_FIRST_N_IMPL(LOG, n, fmt, ...)                   \
+  do {                                                          \
+    static mm::detail::LogFirstNState mmLogFirstNState;         \
+    if (mmLogFirstNState.shouldLog(n)) {                        \
+      LOG(fmt, ##__VA_ARGS__);                                  \
+    }                                                           \
+  } while (0)
+
+#ifdef MM_ENABLE_DEBUG
+#define MM_DEBUG_EVERY_MS(ms, fmt, ...) \
+  MM_LOG_EVERY_MS_IMPL(MM_DEBUG, ms, fmt, ##__VA_ARGS__)
+#define MM_DEBUG_EVERY_N(n, fmt, ...) \
+  MM_LOG_EVERY_N_IMPL(MM_DEBUG, n, fmt, ##__VA_ARGS__)
+#define MM_DEBUG_FIRST_N(n, fmt, ...) \
+  MM_LOG_FIRST_N_IMPL(MM_DEBUG, n, fmt, ##__VA_ARGS__)
+#else
+#define MM_DEBUG_EVERY_MS(ms, fmt, ...)
+#define MM_DEBUG_EVERY_N(n, fmt, ...)
+#define MM_DEBUG_FIRST_N(n, fmt, ...)
+#endif
+
+#define MM_INFO_EVERY_MS(ms, fmt, ...) \
+  MM_LOG_EVERY_MS_IMPL(MM_INFO, ms, fmt, ##__VA_ARGS__)
+#define MM_INFO_EVERY_N(n, fmt, ...) \
+  MM_LOG_EVERY_N_IMPL(MM_INFO, n, fmt, ##__VA_ARGS__)
+#define MM_INFO_FIRST_N(n, fmt, ...) \
+  MM_LOG_FIRST_N_IMPL(MM_INFO, n, fmt, ##__VA_ARGS__)
+
+#define MM_WARN_EVERY_MS(ms, fmt, ...) \
+  MM_LOG_EVERY_MS_IMPL(MM_WARN, ms, fmt, ##__VA_ARGS__)
+#define MM_WARN_EVERY_N(n, fmt, ...) \
+  MM_LOG_EVERY_N_IMPL(MM_WARN, n, fmt, ##__VA_ARGS__)
+#define MM_WARN_FIRST_N(n, fmt, ...) \
+  MM_LOG_FIRST_N_IMPL(MM_WARN, n, fmt, ##__VA_ARGS__)
+
+#define MM_ERROR_EVERY_MS(ms, fmt, ...) \
+  MM_LOG_EVERY_MS_IMPL(MM_ERROR, ms, fmt, ##__VA_ARGS__)
+#define MM_ERROR_EVERY_N(n, fmt, ...) \
+  MM_LOG_EVERY_N_IMPL(MM_ERROR, n, fmt, ##__VA_ARGS__)
+#define MM_ERROR_FIRST_N(n, fmt, ...) \
+  MM_LOG_FIRST_N_IMPL(MM_ERROR, n, fmt, ##__VA_ARGS__)
+
 #else
 
 #define MM_VERBOSE(fmt, ...)
@@ -116,26 +217,99 @@ bool noError(int ec) noexcept;
 #define MM_ERROR(fmt, ...)
 #define MM_FATAL(fmt, ...)
 
+#define MM_DEBUG_EVERY_MS(ms, fmt, ...)
+#define MM_DEBUG_EVERY_N(n, fmt, ...)
+#define MM_DEBUG_FIRST_N(n, fmt, ...)
+#define MM_INFO_EVERY_MS(ms, fmt, ...)
+#define MM_INFO_EVERY_N(n, fmt, ...)
+#define MM_INFO_FIRST_N(n, fmt, ...)
+#define MM_WARN_EVERY_MS(ms, fmt, ...)
+#define MM_WARN_EVERY_N(n, fmt, ...)
+#define MM_WARN_FIRST_N(n, fmt, ...)
+#define MM_ERROR_EVERY_MS(ms, fmt, ...)
+#define MM_ERROR_EVERY_N(n, fmt, ...)
+#define MM_ERROR_FIRST_N(n, fmt, ...)
+
 #endif
 
 namespace mm {
 namespace detail {
 
+/**
+ * State behind MM_*_EVERY_MS, one static instance per call site. Constant
+ * initialized, so the first call pays no static guard.
+ */
+class LogEveryMsState {
+ public:
+  constexpr LogEveryMsState() noexcept : nextLogTimeNs_(0) {}
+
+  bool shouldLog(const int64_t intervalMs) noexcept {
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+    int64_t next = nextLogTimeNs_.load(std::memory_order_relaxed);
+    if (now < next) {
+      return false;
+    }
+
+    // only the thread that moves the deadline forward gets to log
+    return nextLogTimeNs_.compare_exchange_strong(
+        next, now + intervalMs * 1000000, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> nextLogTimeNs_;
+};
+
+// State behind MM_*_EVERY_N, logs the 1st, (n+1)th, (2n+1)th... call
+class LogEveryNState {
+ public:
+  constexpr LogEveryNState() noexcept : count_(0) {}
+
+  bool shouldLog(const uint64_t n) noexcept {
+    const uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+    return (n <= 1) || (0 == (count % n));
+  }
+
+ private:
+  std::atomic<uint64_t> count_;
+};
+
+// State behind MM_*_FIRST_N, logs the first n calls only
+class LogFirstNState {
+ public:
+  constexpr LogFirstNState() noexcept : count_(0) {}
+
+  bool shouldLog(const uint64_t n) noexcept {
+    // plain load first, so a saturated call site stops writing the line
+    if (count_.load(std::memory_order_relaxed) >= n) {
+      return false;
+    }
+    return count_.fetch_add(1, std::memory_order_relaxed) < n;
+  }
+
+ private:
+  std::atomic<uint64_t> count_;
+};
+
 class RateLimitedLog {
  private:
   std::chrono::milliseconds interval_;
-  std::chrono::steady_clock::time_point last_log_time_;
+  std::atomic<int64_t> lastLogTimeNs_;
+
+  static int64_t nowNs() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
 
  public:
   RateLimitedLog(std::chrono::milliseconds interval)
-      : interval_(interval), last_log_time_(std::chrono::steady_clock::now()) {}
+      : interval_(interval), lastLogTimeNs_(nowNs()) {}
 
   template <typename... Args>
   void Log(mm::detail::LogLevel severity, const char* format, Args... args) {
-    auto now         = std::chrono::steady_clock::now();
-    auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now - last_log_time_);
-    if (duration_ms >= interval_) {
+    if (noRateLimited()) {
       switch (severity) {
         case mm::detail::LogLevel_Debug: MM_DEBUG(format, args...); break;
         case mm::detail::LogLevel_Info: MM_INFO(format, args...); break;
@@ -144,19 +318,21 @@ class RateLimitedLog {
         case mm::detail::LogLevel_Fatal: MM_FATAL(format, args...); break;
         default: MM_INFO(format, args...);
       }
-      last_log_time_ = now;
     }
   }
 
   bool noRateLimited() {
-    auto now         = std::chrono::steady_clock::now();
-    auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now - last_log_time_);
-    if (duration_ms >= interval_) {
-      last_log_time_ = now;
-      return true;
+    const int64_t now = nowNs();
+    int64_t last      = lastLogTimeNs_.load(std::memory_order_relaxed);
+    if (now - last <
+        std::chrono::duration_cast<std::chrono::nanoseconds>(interval_)
+            .count()) {
+      return false;
     }
-    return false;
+
+    // several threads may see the interval expire, only one wins the slot
+    return lastLogTimeNs_.compare_exchange_strong(
+        last, now, std::memory_order_relaxed);
   }
 };
 };  // namespace detail
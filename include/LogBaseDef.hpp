@@ -25,8 +25,11 @@
 #define INCLUDE_COMMON_LOG_LOGBASEDEF_HPP_
 
 #include <chrono>
-#include <functional>
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include "LatencyHistogram.hpp"
 
 namespace mm {
 
@@ -56,15 +59,89 @@ enum : LogLevelCfg {
   LogLevelCfg_Verbose = detail::LogLevelCfg_Debug | detail::LogLevel_Verbose,
 };
 
+// Mask of all levels at or above lvl, i.e. LogLevel_Info -> LogLevelCfg_Info
+inline LogLevelCfg convertLogLevelToCfg(const LogLevel lvl) noexcept {
+  LogLevelCfg ret = detail::LogLevelCfg_NoLog;
+
+  switch (lvl) {
+    case detail::LogLevel_Verbose: ret = detail::LogLevelCfg_Verbose; break;
+    case detail::LogLevel_Debug: ret = detail::LogLevelCfg_Debug; break;
+    case detail::LogLevel_Info: ret = detail::LogLevelCfg_Info; break;
+    case detail::LogLevel_Warn: ret = detail::LogLevelCfg_Warn; break;
+    case detail::LogLevel_Error: ret = detail::LogLevelCfg_Error; break;
+    case detail::LogLevel_Fatal: ret = detail::LogLevelCfg_Fatal; break;
+    default: break;
+  }
+
+  return ret;
+}
+
 enum LogSinkType : std::uint8_t {
   LogSinkType_None = 0u,
   LogSinkType_Stdout,
   LogSinkType_GLog,
   LogSinkType_OptimizedGLog,
+  LogSinkType_Router,
+  LogSinkType_AsyncFile,
+};
+
+enum WorkerSchedPolicy : std::uint8_t {
+  WorkerSchedPolicy_Normal = 0u,
+  WorkerSchedPolicy_Batch,
+  WorkerSchedPolicy_Idle,
+};
+
+enum WaitStrategy : std::uint8_t {
+  WaitStrategy_Block = 0u,    // Park, producers notify on threshold crossings
+  WaitStrategy_SpinThenPark,  // Spin for a while, then park
+  WaitStrategy_BusySpin,      // Never park, for dedicated cores
+};
+
+enum ThreadRingMode : std::uint8_t {
+  ThreadRingMode_Off = 0u,    // One shared queue per shard
+  ThreadRingMode_RoundRobin,  // A ring per producer, drained in turn
+  ThreadRingMode_Merge,       // A ring per producer, merged by enqueue time
+};
+
+enum PoolHugePages : std::uint8_t {
+  PoolHugePages_None = 0u,
+  PoolHugePages_Transparent,  // madvise(MADV_HUGEPAGE)
+  PoolHugePages_Explicit,     // MAP_HUGETLB, needs reserved huge pages
+};
+
+// Same values as the kernel's IOPRIO_CLASS_*
+enum WorkerIoClass : std::uint8_t {
+  WorkerIoClass_None = 0u,
+  WorkerIoClass_RealTime,
+  WorkerIoClass_BestEffort,
+  WorkerIoClass_Idle,
 };
 
-using LogCallback = std::function<void(
-    const detail::LogLevel, const char* const, const std::size_t)>;
+enum FileWriter : std::uint8_t {
+  FileWriter_Write = 0u,  // write(2) per buffer
+  FileWriter_Uring,       // Batched io_uring writes, pwritev(2) without it
+  FileWriter_Mmap,        // memcpy into a mapped window of the segment
+};
+
+enum FileCompress : std::uint8_t {
+  FileCompress_None = 0u,
+  FileCompress_Gzip,  // A gzip member per batch, needs zlib
+};
+
+// When the file sinks ask the kernel to write their data back
+enum FileSync : std::uint8_t {
+  FileSync_None = 0u,  // Left to the kernel's writeback
+  FileSync_Async,      // Writeback started after every batch
+  FileSync_Sync,       // Batch on disk before the writer goes on
+};
+
+/**
+ * Front end callback, a plain function pointer so that a message reaches its
+ * sink through a single indirect call. ctx is the pointer registered with
+ * setupLogger(), see dispatchLog() in ILogger.hpp.
+ */
+using LogCallback = void (*)(void* ctx, const detail::LogLevel,
+    const char* const, const std::size_t) noexcept;
 
 }  // namespace detail
 
@@ -73,15 +150,165 @@ using LogDebugSwitch   = bool;
 using LogFilePath      = std::string;
 using LoggerManagerPid = pid_t;
 
+// Placement and priorities each OptimizedGlogLogger worker applies to itself
+struct LogWorkerThreadConfig {
+  LogWorkerThreadConfig() noexcept
+      : cpus(),
+        name("mmlog"),
+        schedPolicy(detail::WorkerSchedPolicy_Normal),
+        nice(0),
+        ioClass(detail::WorkerIoClass_None),
+        ioLevel(4) {}
+
+  std::vector<int> cpus;                  // Cores to run on, empty = any
+  std::string name;                       // Workers are named "<name>-<id>"
+  detail::WorkerSchedPolicy schedPolicy;  // SCHED_OTHER, SCHED_BATCH, ...
+  int nice;                               // Nice level, 0 = inherited
+  detail::WorkerIoClass ioClass;          // ioprio_set() class
+  int ioLevel;                            // 0 (highest) to 7 within ioClass
+};
+
+// How the OptimizedGlogLogger message pool memory is backed
+struct LogPoolMemoryConfig {
+  LogPoolMemoryConfig() noexcept
+      : prefault(false), lock(false), hugePages(detail::PoolHugePages_None) {}
+
+  bool prefault;                    // Fault every page in at construction
+  bool lock;                        // mlock() the pool
+  detail::PoolHugePages hugePages;  // Page size backing the pool
+};
+
+// Buffering and rolling of the AsyncFile sink
+struct LogFileConfig {
+  LogFileConfig() noexcept
+      : bufferKb(4096),
+        flushIntervalMs(1000),
+        maxBuffers(16),
+        rollMb(1024),
+        writer(detail::FileWriter_Write),
+        uringDepth(4),
+        mapMb(16),
+        sync(detail::FileSync_None),
+        compress(detail::FileCompress_None),
+        compressLevel(1),
+        indexKb(0) {}
+
+  size_t bufferKb;                // Size of each buffer the producers append to
+  size_t flushIntervalMs;         // Longest time a partly filled buffer waits
+  size_t maxBuffers;              // Filled buffers pending before drops
+  size_t rollMb;                  // Segment size starting a new file
+  detail::FileWriter writer;      // How the writer thread issues the writes
+  size_t uringDepth;              // Writes in flight with FileWriter_Uring
+  size_t mapMb;                   // Window mapped at once with FileWriter_Mmap
+  detail::FileSync sync;          // Durability of the written batches
+  detail::FileCompress compress;  // Compression of the written batches
+  int compressLevel;              // 1 (fastest) to 9 (smallest)
+  size_t indexKb;                 // Bytes between time index entries, 0 = off
+};
+
+// Compression and retention of the rotated files of the file sinks
+struct LogMaintainConfig {
+  LogMaintainConfig() noexcept
+      : compress(false),
+        bloom(false),
+        maxTotalMb(0),
+        maxAgeHours(0),
+        intervalSec(60) {}
+
+  bool compress;       // gzip the rotated segments, needs zlib
+  bool bloom;          // Token Bloom filter of every rotated segment
+  size_t maxTotalMb;   // Budget of all the sink's files, 0 = unlimited
+  size_t maxAgeHours;  // Rotated files older than this are removed, 0 = kept
+  size_t intervalSec;  // Pause between two passes of the maintainer
+};
+
 // Add additional configuration options for OptimizedGlogLogger
 struct LoggerOptimizationConfig {
   LoggerOptimizationConfig() noexcept
-      : batchSize(100), queueCapacity(10000), numWorkers(2), poolSize(10000) {}
+      : batchSize(100),
+        queueCapacity(10000),
+        numWorkers(2),
+        minWorkers(1),
+        maxWorkers(4),
+        scaleUpWaitMs(20),
+        workerIdleMs(5000),
+        poolSize(10000),
+        dedupWindowMs(0),
+        targetFlushLatencyMs(0),
+        numaAware(false),
+        waitStrategy(detail::WaitStrategy_Block),
+        spinUs(50),
+        threadRings(detail::ThreadRingMode_Off),
+        ringKb(64),
+        workerFiles(false),
+        poolMemory(),
+        workerThread() {}
+
+  size_t batchSize;             // Number of messages to process in a batch
+  size_t queueCapacity;         // Maximum queue size before dropping messages
+  size_t numWorkers;            // Number of worker threads started by setup()
+  size_t minWorkers;            // Idle workers never retire below this count
+  size_t maxWorkers;            // Upper bound of the elastic worker pool
+  size_t scaleUpWaitMs;         // Queue wait adding a worker, and its cooldown
+  size_t workerIdleMs;          // Idle time after which a worker retires
+  size_t poolSize;              // Size of the memory pool
+  size_t dedupWindowMs;         // Window collapsing repeated messages, 0 = off
+  size_t targetFlushLatencyMs;  // Tunes batching against this latency, 0 = off
+  bool numaAware;               // Pool, queue and workers per NUMA node
+
+  detail::WaitStrategy waitStrategy;   // How idle workers wait for messages
+  size_t spinUs;                       // Spin time of SpinThenPark
+  detail::ThreadRingMode threadRings;  // Per thread rings instead of queues
+  size_t ringKb;                       // Size of each thread ring
+  bool workerFiles;                    // File per worker, see LogShard.hpp
+  LogPoolMemoryConfig poolMemory;      // Prefaulting, locking, huge pages
+  LogWorkerThreadConfig workerThread;  // Affinity, name and priorities
+};
+
+// Counters and latencies of a logger, see ILogger::getStats()
+struct LoggerStats {
+  LoggerStats() noexcept
+      : enqueued(0),
+        processed(0),
+        dropped(0),
+        overflow(0),
+        deduplicated(0),
+        notifications(0),
+        workers(0),
+        workerScaleUps(0),
+        workerScaleDowns(0),
+        batchSize(0),
+        wakeThreshold(0),
+        queueWait(),
+        write(),
+        endToEnd() {}
+
+  uint64_t enqueued;       // Messages accepted into the queue
+  uint64_t processed;      // Messages handed to the sink by the workers
+  uint64_t dropped;        // Messages dropped by the overload policy
+  uint64_t overflow;       // Messages lost to an exhausted pool
+  uint64_t deduplicated;   // Repeats collapsed into summaries
+  uint64_t notifications;  // Worker wakeups signalled by producers
+
+  uint64_t workers;           // Worker threads currently running
+  uint64_t workerScaleUps;    // Workers added because the queue fell behind
+  uint64_t workerScaleDowns;  // Workers retired after sustained idleness
+  uint64_t batchSize;         // Batch size currently used by the workers
+  uint64_t wakeThreshold;     // Queue depth currently waking a worker
+
+  LatencySnapshot queueWait;  // Enqueue until a worker picks it up, ns
+  LatencySnapshot write;      // Time spent in the sink write, ns
+  LatencySnapshot endToEnd;   // Enqueue until the write returned, ns
+};
+
+// One child sink of the router sink and the lowest level it accepts
+struct LogRouteConfig {
+  LogRouteConfig(const detail::LogSinkType sinkType,
+      const detail::LogLevel level) noexcept
+      : sinkType_(sinkType), level_(level) {}
 
-  size_t batchSize;      // Number of messages to process in a batch
-  size_t queueCapacity;  // Maximum queue size before dropping messages
-  size_t numWorkers;     // Number of worker threads
-  size_t poolSize;       // Size of the memory pool
+  detail::LogSinkType sinkType_;
+  detail::LogLevel level_;
 };
 
 struct LogConfig {
@@ -94,7 +321,10 @@ struct LogConfig {
         logFilePath_(),
         logDebugSwitch_(false),
         logToConsole_(false),
-        optimizationConfig_() {}
+        optimizationConfig_(),
+        fileConfig_(),
+        maintainConfig_(),
+        routes_() {}
 
   virtual ~LogConfig() = default;
 
@@ -107,6 +337,9 @@ struct LogConfig {
   mm::LogDebugSwitch logDebugSwitch_;
   bool logToConsole_;  // New option to control console output
   LoggerOptimizationConfig optimizationConfig_;
+  LogFileConfig fileConfig_;  // Settings of LogSinkType_AsyncFile
+  LogMaintainConfig maintainConfig_;  // Rotated files of the file sinks
+  std::vector<LogRouteConfig> routes_;  // Child sinks of LogSinkType_Router
 };
 
 }  // namespace mm
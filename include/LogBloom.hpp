@@ -0,0 +1,217 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_LOGBLOOM_HPP_
+#define INCLUDE_COMMON_LOG_LOGBLOOM_HPP_
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "LogShard.hpp"
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * Token Bloom filter of a rotated segment, written next to it by
+ * logBloomPath(): a LogBloomHeader followed by the filter's bits as
+ * 64 bit words. A token is a run of letters, digits and '_' of at least
+ * LogBloomMinToken characters from the call site and the message of a line,
+ * the time and thread id in front of them are left out. Native byte order,
+ * the filter is read on the host that wrote it.
+ */
+constexpr char LogBloomMagic[8] = {'M', 'M', 'L', 'O', 'G', 'B', 'L', 'M'};
+constexpr std::uint32_t LogBloomVersion = 1;
+constexpr const char* LogBloomSuffix    = ".bloom";
+constexpr std::uint32_t LogBloomHashes  = 6;
+constexpr std::size_t LogBloomMinToken  = 2;
+
+struct LogBloomHeader {
+  char magic[8];           // LogBloomMagic
+  std::uint32_t version;   // LogBloomVersion
+  std::uint32_t hashes;    // Bits set per token
+  std::uint64_t bits;      // Size of the filter, a power of two
+  std::uint64_t tokens;    // Tokens added, repeats included
+};
+
+static_assert(sizeof(LogBloomHeader) == 32, "LogBloomHeader is 32 bytes");
+
+/**
+ * @brief "<segment>.bloom", without the ".gz" of a compressed segment so
+ * the filter outlives the compression of its segment
+ */
+inline std::string logBloomPath(const std::string& segment) {
+  const std::size_t gz = segment.size() >= 3 ? segment.size() - 3 : 0;
+  if (segment.size() >= 3 && 0 == segment.compare(gz, 3, ".gz")) {
+    return segment.substr(0, gz) + LogBloomSuffix;
+  }
+  return segment + LogBloomSuffix;
+}
+
+inline std::uint64_t logTokenHash(
+    const char* token, const std::size_t len) noexcept {
+  // FNV-1a, then the MurmurHash3 finalizer to spread it over all the bits
+  std::uint64_t hash = 14695981039346656037ull;
+  for (std::size_t i = 0; i < len; ++i) {
+    hash ^= static_cast<unsigned char>(token[i]);
+    hash *= 1099511628211ull;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * @brief Offset of the call site in a line
+ *
+ * Skips the "YYYY-mm-dd HH:MM:SS.mmm tid " of outputLog() and glog's
+ * "Lyyyymmdd hh:mm:ss.uuuuuu tid ", which every segment is full of, behind
+ * the key of a per worker file record.
+ */
+inline std::size_t logTokenStart(
+    const char* line, const std::size_t len) noexcept {
+  std::uint64_t key = 0;
+  std::size_t pos   = 0;
+  if (parseLogShardKey(line, len, key)) {
+    pos = LogShardKeyLen;
+  }
+
+  const char* stamp = line + pos;
+  if (len > pos + 24 && '-' == stamp[4] && '-' == stamp[7] &&
+      ' ' == stamp[10] && ':' == stamp[13] && '.' == stamp[19]) {
+    pos += 24;
+  } else if (len > pos + 26 && ' ' == stamp[9] && ':' == stamp[12] &&
+             '.' == stamp[18] && ' ' == stamp[25]) {
+    pos += 26;
+  } else {
+    return pos;
+  }
+
+  for (; pos < len; ++pos) {
+    const unsigned char c = static_cast<unsigned char>(line[pos]);
+    if (' ' != c && !std::isdigit(c)) {
+      break;
+    }
+  }
+  return pos;
+}
+
+/**
+ * @brief Calls func(token, len) for every token of data
+ */
+template <typename Func>
+void forEachLogToken(const char* data, const std::size_t len, Func&& func) {
+  std::size_t start = 0;
+  for (std::size_t pos = 0; pos <= len; ++pos) {
+    const unsigned char c =
+        pos < len ? static_cast<unsigned char>(data[pos]) : ' ';
+    if (std::isalnum(c) || '_' == c) {
+      continue;
+    }
+    if (pos - start >= LogBloomMinToken) {
+      func(data + start, pos - start);
+    }
+    start = pos + 1;
+  }
+}
+
+/**
+ * @brief Bloom filter of token hashes
+ *
+ * The LogBloomHashes bits of a hash are picked by double hashing modulo the
+ * power of two size, so halving the filter by OR-ing its halves keeps every
+ * token in it. Filters are built oversized and shrunk to their content.
+ */
+class LogBloomFilter {
+ public:
+  explicit LogBloomFilter(const std::uint64_t bits = 64) : words_() {
+    std::uint64_t size = 64;
+    while (size < bits) {
+      size <<= 1;
+    }
+    words_.assign(size / 64, 0);
+  }
+
+  void add(const std::uint64_t hash) noexcept {
+    const std::uint64_t mask = bits() - 1;
+    const std::uint64_t step = (hash >> 32 | hash << 32) | 1;
+    for (std::uint32_t i = 0; i < LogBloomHashes; ++i) {
+      const std::uint64_t bit = (hash + i * step) & mask;
+      words_[bit / 64] |= 1ull << (bit % 64);
+    }
+  }
+
+  bool contains(const std::uint64_t hash) const noexcept {
+    const std::uint64_t mask = bits() - 1;
+    const std::uint64_t step = (hash >> 32 | hash << 32) | 1;
+    for (std::uint32_t i = 0; i < LogBloomHashes; ++i) {
+      const std::uint64_t bit = (hash + i * step) & mask;
+      if (0 == (words_[bit / 64] & (1ull << (bit % 64)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Halves the filter as long as no more than maxFill of its bits
+   * end up set
+   */
+  void shrink(const double maxFill) {
+    while (words_.size() > 1) {
+      const std::size_t half = words_.size() / 2;
+      std::uint64_t set      = 0;
+      for (std::size_t i = 0; i < half; ++i) {
+        set += static_cast<std::uint64_t>(
+            __builtin_popcountll(words_[i] | words_[i + half]));
+      }
+      if (static_cast<double>(set) > maxFill * static_cast<double>(half * 64)) {
+        return;
+      }
+      for (std::size_t i = 0; i < half; ++i) {
+        words_[i] |= words_[i + half];
+      }
+      words_.resize(half);
+    }
+  }
+
+  std::uint64_t bits() const noexcept { return words_.size() * 64; }
+
+  std::vector<std::uint64_t>& words() noexcept { return words_; }
+
+ private:
+  std::vector<std::uint64_t> words_;
+};
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_LOGBLOOM_HPP_
@@ -0,0 +1,103 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_LOGCOMPRESSOR_HPP_
+#define INCLUDE_COMMON_LOG_LOGCOMPRESSOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "DisallowCopy.hpp"
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * @brief Streaming gzip compression of the file sink batches
+ *
+ * Every batch becomes one gzip member, begin() starts it, add() compresses
+ * the buffers of the batch and finish() ends it. Concatenated members are a
+ * valid gzip file, readable with zcat, and a crash loses at most the member
+ * being written. The deflate state and the output buffer are reused from
+ * batch to batch. Needs zlib at build time, without it setup() fails.
+ */
+class LogCompressor {
+ public:
+  LogCompressor() noexcept;
+  ~LogCompressor();
+
+  /**
+   * @param level zlib level, 1 (fastest) to 9 (smallest)
+   * @return MM_STATUS_OK, MM_STATUS_ENOMEM or MM_STATUS_ERROR if built
+   * without zlib
+   */
+  int setup(const int level) noexcept;
+
+  bool active() const noexcept { return nullptr != stream_; }
+
+  void begin() noexcept;
+
+  /**
+   * @return MM_STATUS_OK, MM_STATUS_ENOMEM if the output can not grow or
+   * MM_STATUS_ERROR
+   */
+  int add(const char* data, const std::size_t len) noexcept;
+
+  /**
+   * @brief Ends the member
+   *
+   * @return MM_STATUS_OK, data() and size() then hold the member, or the
+   * errors of add()
+   */
+  int finish() noexcept;
+
+  const char* data() const noexcept { return out_.get(); }
+  std::size_t size() const noexcept { return size_; }
+
+  // Bytes given to add() and produced by finish() so far
+  std::uint64_t bytesIn() const noexcept { return bytesIn_; }
+  std::uint64_t bytesOut() const noexcept { return bytesOut_; }
+
+ private:
+  /**
+   * @brief Runs deflate until it consumed its input, growing the output
+   */
+  int deflateAll(const int flush) noexcept;
+
+  void* stream_;  // z_stream, kept out of the header
+  std::unique_ptr<char[]> out_;
+  std::size_t capacity_;
+  std::size_t size_;
+  std::uint64_t bytesIn_;
+  std::uint64_t bytesOut_;
+
+  MM_DISALLOW_COPY_AND_MOVE(LogCompressor)
+};
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_LOGCOMPRESSOR_HPP_
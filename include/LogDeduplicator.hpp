@@ -0,0 +1,156 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_LOGDEDUPLICATOR_HPP_
+#define INCLUDE_COMMON_LOG_LOGDEDUPLICATOR_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "DisallowCopy.hpp"
+#include "LogBaseDef.hpp"
+#include "ShardedCounter.hpp"
+
+namespace mm {
+
+/**
+ * @brief Collapses bursts of identical log lines
+ *
+ * Messages are keyed by a hash of the rendered line, which already starts
+ * with the call site ("file::func() line"), so the key covers both where and
+ * what was logged. The first occurrence passes, repeats inside the window are
+ * suppressed and counted, and once per window a "last message repeated N
+ * times" summary is produced for the run. Slots are independently locked, so
+ * producers only contend when they log the same (or a colliding) message.
+ */
+class LogDeduplicator {
+ public:
+  enum : std::size_t { DefaultNumSlots = 1024 };
+  enum : std::size_t { SummaryBufferSize = 256 };
+
+  /**
+   * @brief Summary line for a run of suppressed repeats
+   */
+  struct Summary {
+    detail::LogLevel level;
+    char msg[SummaryBufferSize];
+    std::size_t len;
+  };
+
+  LogDeduplicator(const std::chrono::milliseconds window,
+      const std::size_t numSlots = DefaultNumSlots);
+  ~LogDeduplicator() = default;
+
+  /**
+   * @brief Checks a message against the recent history
+   *
+   * @param level Log level of the message
+   * @param msg Rendered message
+   * @param len Length of the message
+   * @param summary Filled when a previous run has to be reported first
+   * @param hasSummary Set to true when summary was filled
+   * @return true if the message is a repeat and must be dropped
+   */
+  bool suppress(const detail::LogLevel level, const char* msg,
+      const std::size_t len, Summary& summary, bool& hasSummary);
+
+  /**
+   * @brief Reports the runs whose window has expired
+   *
+   * Meant to be called periodically from a worker, and with force set on
+   * shutdown so that no repeat count is lost.
+   */
+  template <typename Emit>
+  void flushExpired(Emit&& emit, const bool force = false);
+
+  /**
+   * @brief Total number of suppressed messages
+   */
+  uint64_t suppressedCount() const noexcept {
+    return suppressedCount_.load();
+  }
+
+ private:
+  enum : std::size_t { SampleSize = 160 };
+
+  struct Slot {
+    std::mutex mutex;
+    uint64_t hash          = 0;
+    int64_t windowStartNs  = 0;  // start of the current window
+    uint64_t repeats       = 0;  // suppressed within the current window
+    detail::LogLevel level = detail::LogLevel_NoLog;
+    char sample[SampleSize] = {0};  // head of the message, for the summary
+  };
+
+  static std::size_t roundUpToPowerOfTwo(const std::size_t n) noexcept;
+  static uint64_t hashMessage(const char* msg, const std::size_t len) noexcept;
+  static int64_t nowNs() noexcept;
+
+  void makeSummary(Slot& slot, const int64_t now, Summary& summary) const
+      noexcept;
+
+  const int64_t windowNs_;
+  const std::size_t slotMask_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<int64_t> nextFlushNs_;
+  detail::ShardedCounter suppressedCount_;
+
+  MM_DISALLOW_COPY_AND_MOVE(LogDeduplicator)
+};
+
+template <typename Emit>
+void LogDeduplicator::flushExpired(Emit&& emit, const bool force) {
+  const int64_t now = nowNs();
+
+  // one sweep per half window is enough for the summaries to be timely
+  int64_t next = nextFlushNs_.load(std::memory_order_relaxed);
+  if (!force && ((now < next) || !nextFlushNs_.compare_exchange_strong(
+                                     next, now + windowNs_ / 2,
+                                     std::memory_order_relaxed))) {
+    return;
+  }
+
+  for (std::size_t i = 0; i <= slotMask_; ++i) {
+    Slot& slot = slots_[i];
+    Summary summary;
+    bool hasSummary = false;
+    {
+      std::lock_guard<std::mutex> lock(slot.mutex);
+      if ((0 != slot.repeats) &&
+          (force || (now - slot.windowStartNs >= windowNs_))) {
+        makeSummary(slot, now, summary);
+        hasSummary = true;
+      }
+    }
+
+    if (hasSummary) {
+      emit(summary.level, summary.msg, summary.len);
+    }
+  }
+}
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_LOGDEDUPLICATOR_HPP_
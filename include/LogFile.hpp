@@ -0,0 +1,289 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_LOGFILE_HPP_
+#define INCLUDE_COMMON_LOG_LOGFILE_HPP_
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DisallowCopy.hpp"
+#include "LogBaseDef.hpp"
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * @brief Mapped window of a segment handed out by LogFile::takeWindows()
+ */
+struct LogFileWindow {
+  char* map;
+  std::size_t offset;  // Of map in its segment
+  std::size_t begin;   // Bytes [begin, end) of the segment left to sync
+  std::size_t end;
+  bool retired;  // Done with, unmapped once synced
+};
+
+/**
+ * @brief Window mapped ahead of the appends, see LogFile::requestWindow()
+ */
+struct LogFileMapRequest {
+  int fd;  // dup(2) of the segment, -1 if none
+  std::size_t offset;
+  std::uint64_t segment;  // Segments opened before it
+  char* map;              // Null until mapped, and once installed
+  bool closed;            // The segment was closed before installWindow()
+};
+
+/**
+ * @brief Append only log file of the file sinks, rolled into a new segment
+ * once it exceeds the roll size
+ *
+ * Segments are named "<baseName>.<YYYYmmdd-HHMMSS>.<pid>.<seq>.log", seq
+ * numbering the segments the process opened, and the symlink
+ * "<baseName>.log" points at the current one, ".log.gz" when the sink
+ * compresses. Not thread safe, the sink writes it from a single thread or
+ * under its own lock.
+ *
+ * With FileWriter_Uring the file is opened without O_APPEND, its writer
+ * reserves the offsets with reserve() and writes them itself, possibly out
+ * of order. With FileWriter_Mmap append() copies into a window of mapSize
+ * bytes mapped over the segment, fallocate(2)d as the window advances. The
+ * segment is truncated to its data when closed, after a crash it ends with
+ * the zeros of the last window.
+ *
+ * With deferUnmap() the windows are kept by another thread, so appends under
+ * a lock make no system call of their own: it maps the next window ahead
+ * with requestWindow(), mapWindowAhead() and installWindow(), and syncs and
+ * unmaps the windows done with through takeWindows() and releaseWindows(),
+ * the system calls outside the lock.
+ *
+ * With an index size the file also writes the sparse time index described
+ * in LogIndex.hpp, an entry at most every indexKb of data.
+ */
+class LogFile {
+ public:
+  /**
+   * @param config Roll size, writer, window and sync settings
+   */
+  LogFile(const std::string& dir, const std::string& baseName,
+      const LogFileConfig& config) noexcept;
+  ~LogFile();
+
+  /**
+   * @brief Creates the directory and opens the first segment
+   *
+   * @return MM_STATUS_OK, MM_STATUS_ENOENT if the directory can not be
+   * created or MM_STATUS_ERROR if the segment can not be opened
+   */
+  int open() noexcept;
+
+  /**
+   * @brief Writes data with a single write(2) unless interrupted, or copies
+   * it into the mapped window, rolling first when it would take the segment
+   * past the roll size
+   *
+   * @param wallNs Time the first record of data was appended, for the time
+   * index, 0 if unknown
+   * @return MM_STATUS_OK or MM_STATUS_ERROR
+   */
+  int append(const char* data, const std::size_t len,
+      const int64_t wallNs = 0) noexcept;
+
+  /**
+   * @brief append() of msg and a newline, both in the same segment
+   */
+  int appendLine(const char* msg, const std::size_t len,
+      const int64_t wallNs = 0) noexcept;
+
+  // Whether an append() with a wall clock time adds an index entry
+  bool indexDue() const noexcept {
+    return 0 != indexSize_ && !indexFailed_ &&
+           (0 > indexFd_ || written_ >= lastIndexed_ + indexSize_);
+  }
+
+  /**
+   * @brief Starts or waits for the writeback of what was written since the
+   * last call, as the sync setting asks
+   *
+   * @return MM_STATUS_OK or MM_STATUS_ERROR
+   */
+  int sync() noexcept;
+
+  /**
+   * @brief Reserves len bytes at the end of the file, rolling first like
+   * append() does
+   *
+   * @param fd Descriptor of the segment to write to
+   * @param offset Offset of the reserved bytes in that segment
+   * @param wallNs As for append()
+   * @return MM_STATUS_OK or MM_STATUS_ERROR if no segment is open
+   */
+  int reserve(const std::size_t len, int& fd, off_t& offset,
+      const int64_t wallNs = 0) noexcept;
+
+  // Whether writing len more bytes starts a new segment
+  bool wouldRoll(const std::size_t len) const noexcept {
+    return written_ > 0 && written_ + len > rollSize_;
+  }
+
+  /**
+   * @brief Syncs, unmaps and truncates the current segment to its data
+   */
+  void close() noexcept;
+
+  /**
+   * @brief Keeps the windows append() and close() are done with for
+   * takeWindows() instead of syncing and unmapping them, call before open()
+   */
+  void deferUnmap() noexcept { deferUnmap_ = true; }
+
+  // Whether no window is mapped ahead of the appends to the current segment
+  bool windowNeeded() const noexcept {
+    return FileWriter_Mmap == writer_ && 0 <= fd_ && !mapFailed_ && !nextMap_;
+  }
+
+  /**
+   * @brief Starts mapping the window following the current one
+   *
+   * @return false if no window is needed or the segment can not be dup(2)ed
+   */
+  bool requestWindow(LogFileMapRequest& request) noexcept;
+
+  /**
+   * @brief fallocate(2)s and maps the requested window, without the lock
+   *
+   * @return MM_STATUS_OK or MM_STATUS_ERROR
+   */
+  int mapWindowAhead(LogFileMapRequest& request) const noexcept;
+
+  /**
+   * @brief Makes the mapped window the next one append() moves to, unless
+   * the appends moved past it or to another segment meanwhile
+   */
+  void installWindow(LogFileMapRequest& request) noexcept;
+
+  /**
+   * @brief Unmaps a window that was not installed and closes the dup(2),
+   * without the lock
+   */
+  void finishRequest(LogFileMapRequest& request) const noexcept;
+
+  /**
+   * @brief Hands out the windows done with and what the current one holds
+   * since the last call, for releaseWindows()
+   */
+  void takeWindows(std::vector<LogFileWindow>& windows) noexcept;
+
+  /**
+   * @brief Syncs the windows as the sync setting asks and unmaps the retired
+   * ones, without the lock
+   *
+   * @return MM_STATUS_OK or MM_STATUS_ERROR if a sync failed
+   */
+  int releaseWindows(std::vector<LogFileWindow>& windows) const noexcept;
+
+  // Directory of the segments, ends with a separator
+  const std::string& dir() const noexcept { return dir_; }
+  const std::string& baseName() const noexcept { return baseName_; }
+
+  // Path of the current segment, empty before open()
+  const std::string& path() const noexcept { return path_; }
+
+  // Descriptor of the current segment, -1 before open()
+  int fd() const noexcept { return fd_; }
+
+ private:
+  int roll() noexcept;
+
+  // Writes or copies data at offset written_
+  int appendData(const char* data, const std::size_t len) noexcept;
+
+  int appendMapped(const char* data, const std::size_t len) noexcept;
+
+  // Offset of the window following the current one
+  std::size_t nextWindowOffset() const noexcept;
+
+  /**
+   * @brief Moves to the window mapped ahead, or maps the window holding
+   * offset written_
+   */
+  int nextWindow() noexcept;
+
+  /**
+   * @brief Maps the window holding offset written_, allocating it first
+   */
+  int mapWindow() noexcept;
+
+  void unmapWindow() noexcept;
+
+  // unmapWindow(), or keeps the window for takeWindows() with deferUnmap_
+  void retireWindow() noexcept;
+
+  /**
+   * @brief Adds an index entry for offset written_ unless the last one is
+   * less than indexSize_ behind
+   */
+  void index(const int64_t wallNs) noexcept;
+
+  std::string dir_;  // Ends with a separator
+  std::string baseName_;
+  std::string suffix_;  // ".log" or ".log.gz"
+  std::size_t rollSize_;
+  FileWriter writer_;
+  FileSync sync_;
+  int fd_;
+  std::size_t written_;  // Bytes in the current segment
+  std::size_t synced_;   // Bytes of the segment synced by sync()
+  std::string path_;
+
+  // FileWriter_Mmap
+  std::size_t mapSize_;    // Window size, a multiple of the page size
+  char* map_;              // Current window, null if none
+  std::size_t mapOffset_;  // Offset of map_ in the segment
+  std::size_t allocated_;  // Bytes of the segment fallocate(2)d
+  bool mapFailed_;         // pwrite(2) the rest of the segment instead
+  bool deferUnmap_;        // Windows done with go to retired_
+  char* nextMap_;          // Window mapped ahead, null if none
+  std::size_t nextMapOffset_;
+  std::uint64_t segment_;  // Segments opened before the current one
+  std::vector<LogFileWindow> retired_;  // Left to sync and unmap
+
+  // Time index of the current segment
+  std::size_t indexSize_;    // Data between two entries, 0 = no index
+  int indexFd_;              // "<path_>.idx", -1 until the first entry
+  std::size_t lastIndexed_;  // Offset of the last entry
+  bool indexFailed_;         // No more entries for this segment
+
+  MM_DISALLOW_COPY_AND_MOVE(LogFile)
+};
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_LOGFILE_HPP_
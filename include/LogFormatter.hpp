@@ -0,0 +1,349 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_LOGFORMATTER_HPP_
+#define INCLUDE_COMMON_LOG_LOGFORMATTER_HPP_
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * @brief One printf conversion, i.e. "%-08.3lf"
+ */
+struct FormatSpec {
+  enum Flag : std::uint8_t {
+    Flag_Left  = 1u,       // '-'
+    Flag_Zero  = 1u << 1,  // '0'
+    Flag_Plus  = 1u << 2,  // '+'
+    Flag_Space = 1u << 3,  // ' '
+    Flag_Alt   = 1u << 4,  // '#'
+  };
+
+  enum Length : std::uint8_t {
+    Length_None = 0u,
+    Length_hh,
+    Length_h,
+    Length_l,
+    Length_ll,
+    Length_z,
+    Length_j,
+    Length_t,
+  };
+
+  char conv;           // d i u x X o f F e g s p c
+  std::uint8_t flags;  // FormatSpec::Flag bits
+  std::uint8_t length;
+  int width;      // -1 when absent
+  int precision;  // -1 when absent
+};
+
+enum : std::size_t { MaxFormatConversions = 16 };
+enum : int { MaxFloatPrecision = 64 };
+
+/**
+ * @brief A conversion and the literal run in front of it
+ */
+struct FormatSegment {
+  std::uint16_t literalOffset;
+  std::uint16_t literalLen;
+  FormatSpec spec;  // conv '%' prints a single "%" and takes no argument
+};
+
+/**
+ * @brief A printf format split into literal runs and conversions
+ *
+ * Produced by compileFormat(), at compile time for the typed API and once
+ * per call site for the printf style macros. The literal runs are offsets
+ * into the format text.
+ */
+struct CompiledFormat {
+  FormatSegment segments[MaxFormatConversions];
+  std::size_t count;
+  std::uint16_t tailOffset;  // literal run after the last conversion
+  std::uint16_t tailLen;
+  bool supported;  // false: syntax the fast formatter does not handle
+};
+
+constexpr bool isFormatDigit(const char c) noexcept {
+  return (c >= '0') && (c <= '9');
+}
+
+/**
+ * @brief Splits a printf format into segments
+ *
+ * Supports flags, numeric width and precision, the hh h l ll z j t length
+ * modifiers and the d i u x X o f F e g s p c conversions. '*' widths,
+ * positional arguments, %n, %a, long double, wide strings, '#' with %e or
+ * %g, and %p with a precision or the '0', '+' or ' ' flag mark the result
+ * unsupported.
+ */
+constexpr CompiledFormat compileFormat(const std::string_view fmt) noexcept {
+  CompiledFormat ret{};
+  ret.supported = false;
+
+  if (fmt.size() > UINT16_MAX) {
+    return ret;
+  }
+
+  std::size_t i   = 0;
+  std::size_t lit = 0;
+  auto at = [&fmt](const std::size_t pos) {
+    return (pos < fmt.size()) ? fmt[pos] : '\0';
+  };
+
+  while (i < fmt.size()) {
+    if ('%' != fmt[i]) {
+      ++i;
+      continue;
+    }
+
+    if (MaxFormatConversions == ret.count) {
+      return ret;
+    }
+
+    const std::size_t start = i++;
+    FormatSpec spec         = {0, 0, FormatSpec::Length_None, -1, -1};
+
+    if ('%' == at(i)) {
+      spec.conv = '%';
+      ret.segments[ret.count++] = {static_cast<std::uint16_t>(lit),
+          static_cast<std::uint16_t>(start - lit), spec};
+      lit = ++i;
+      continue;
+    }
+
+    // flags
+    for (bool more = true; more;) {
+      switch (at(i)) {
+        case '-': spec.flags |= FormatSpec::Flag_Left; ++i; break;
+        case '0': spec.flags |= FormatSpec::Flag_Zero; ++i; break;
+        case '+': spec.flags |= FormatSpec::Flag_Plus; ++i; break;
+        case ' ': spec.flags |= FormatSpec::Flag_Space; ++i; break;
+        case '#': spec.flags |= FormatSpec::Flag_Alt; ++i; break;
+        default: more = false; break;
+      }
+    }
+
+    // width, "*" and "n$" are not digits and end up unsupported below
+    if (isFormatDigit(at(i))) {
+      spec.width = 0;
+      while (isFormatDigit(at(i)) && (spec.width < 4096)) {
+        spec.width = spec.width * 10 + (at(i++) - '0');
+      }
+    }
+
+    if ('.' == at(i)) {
+      ++i;
+      spec.precision = 0;
+      while (isFormatDigit(at(i)) && (spec.precision < 4096)) {
+        spec.precision = spec.precision * 10 + (at(i++) - '0');
+      }
+    }
+
+    // length modifier
+    switch (at(i)) {
+      case 'h':
+        spec.length = ('h' == at(i + 1)) ? FormatSpec::Length_hh
+                                         : FormatSpec::Length_h;
+        i += (FormatSpec::Length_hh == spec.length) ? 2 : 1;
+        break;
+      case 'l':
+        spec.length = ('l' == at(i + 1)) ? FormatSpec::Length_ll
+                                         : FormatSpec::Length_l;
+        i += (FormatSpec::Length_ll == spec.length) ? 2 : 1;
+        break;
+      case 'z': spec.length = FormatSpec::Length_z; ++i; break;
+      case 'j': spec.length = FormatSpec::Length_j; ++i; break;
+      case 't': spec.length = FormatSpec::Length_t; ++i; break;
+      default: break;
+    }
+
+    spec.conv      = at(i);
+    bool supported = false;
+    switch (spec.conv) {
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o': supported = true; break;
+      case 'f':
+      case 'F':
+        supported = ((FormatSpec::Length_None == spec.length) ||
+                        (FormatSpec::Length_l == spec.length)) &&
+                    (spec.precision <= MaxFloatPrecision);
+        break;
+      case 'e':
+      case 'g':
+        // '#' keeps the point and, for %g, the trailing zeros, which
+        // std::to_chars has no option for
+        supported = ((FormatSpec::Length_None == spec.length) ||
+                        (FormatSpec::Length_l == spec.length)) &&
+                    (spec.precision <= MaxFloatPrecision) &&
+                    !(spec.flags & FormatSpec::Flag_Alt);
+        break;
+      case 's':
+      case 'c':
+        // %ls and %lc take wide characters
+        supported = (FormatSpec::Length_None == spec.length);
+        break;
+      case 'p':
+        // glibc prints %p as %#lx, zero padded, signed and with a precision
+        supported = (FormatSpec::Length_None == spec.length) &&
+                    (spec.precision < 0) &&
+                    !(spec.flags & (FormatSpec::Flag_Zero |
+                                       FormatSpec::Flag_Plus |
+                                       FormatSpec::Flag_Space));
+        break;
+      default: break;
+    }
+
+    if (!supported) {
+      return ret;
+    }
+
+    ret.segments[ret.count++] = {static_cast<std::uint16_t>(lit),
+        static_cast<std::uint16_t>(start - lit), spec};
+    lit = ++i;
+  }
+
+  ret.tailOffset = static_cast<std::uint16_t>(lit);
+  ret.tailLen    = static_cast<std::uint16_t>(i - lit);
+  ret.supported  = true;
+  return ret;
+}
+
+/**
+ * @brief Bounded output cursor with snprintf semantics: writes are truncated
+ * at the end of the buffer but the would-be length keeps counting
+ */
+class FormatBuffer {
+ public:
+  FormatBuffer(char* buf, const std::size_t len) noexcept
+      : pos_(buf),
+        end_(len ? buf + len - 1 : buf),
+        total_(0),
+        terminate_(len > 0) {}
+
+  void append(const char* s, const std::size_t n) noexcept;
+  void fill(const char c, const std::size_t n) noexcept;
+
+  // Terminates the output and returns the would-be length
+  int finish() noexcept;
+
+ private:
+  char* pos_;
+  char* end_;  // last byte, reserved for the terminator
+  std::size_t total_;
+  bool terminate_;  // false for a zero length buffer
+};
+
+void formatSigned(FormatBuffer& out, const FormatSpec& spec,
+    const long long value) noexcept;
+void formatUnsigned(FormatBuffer& out, const FormatSpec& spec,
+    const unsigned long long value) noexcept;
+void formatDouble(
+    FormatBuffer& out, const FormatSpec& spec, const double value) noexcept;
+void formatString(FormatBuffer& out, const FormatSpec& spec, const char* value,
+    const std::size_t len) noexcept;
+void formatString(
+    FormatBuffer& out, const FormatSpec& spec, const char* value) noexcept;
+void formatPointer(
+    FormatBuffer& out, const FormatSpec& spec, const void* value) noexcept;
+void formatChar(
+    FormatBuffer& out, const FormatSpec& spec, const int value) noexcept;
+
+/**
+ * @brief An argument of the typed log API, reduced to what the formatter
+ * needs. Which conversion may consume which kind is checked at compile time.
+ */
+struct TypedArg {
+  enum Kind : std::uint8_t {
+    Kind_None = 0,
+    Kind_Signed,
+    Kind_Unsigned,
+    Kind_Double,
+    Kind_CString,  // NUL terminated, may be nullptr
+    Kind_String,   // pointer and length, std::string and std::string_view
+    Kind_Pointer,
+  };
+
+  struct StringRef {
+    const char* data;
+    std::size_t len;
+  };
+
+  Kind kind;
+  std::uint8_t size;  // sizeof the original integer, for %x of negatives
+  union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const void* p;
+    StringRef s;
+  } value;
+};
+
+/**
+ * @brief Formats args along an already compiled format
+ *
+ * text is the format the segments were compiled from. No parsing happens
+ * here, and args must hold one entry per conversion other than "%%".
+ *
+ * @return the would-be length, snprintf style
+ */
+int formatTyped(char* buf, const std::size_t len,
+    const CompiledFormat& compiled, const char* text,
+    const TypedArg* args) noexcept;
+
+/**
+ * @brief vsnprintf() replacement for the log front end
+ *
+ * The format is parsed once and cached by its address, so a call site pays
+ * for parsing only on its first message. Integers and floats are converted
+ * with std::to_chars, which neither parses generically nor consults the
+ * locale. Formats with conversions outside the common set (%n, %a, '*'
+ * widths, positional arguments, long double...) go to vsnprintf().
+ *
+ * @return Same as vsnprintf(): the would-be length, or negative on error
+ */
+int formatLog(char* buf, const std::size_t len, const char* fmt,
+    va_list args) noexcept;
+
+/**
+ * @brief snprintf() counterpart of formatLog()
+ */
+int formatLogArgs(char* buf, const std::size_t len, const char* fmt,
+    ...) noexcept __attribute__((format(printf, 3, 4)));
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_LOGFORMATTER_HPP_
@@ -0,0 +1,63 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_LOGINDEX_HPP_
+#define INCLUDE_COMMON_LOG_LOGINDEX_HPP_
+
+#include <cstdint>
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * Sparse time index of a file sink segment, written next to it as
+ * "<segment>.idx": a LogIndexHeader followed by LogIndexEntry records in the
+ * order of their offsets. Every record before an entry's offset was appended
+ * before the entry's time, so a range query starts reading at the last entry
+ * not after its start. For gzip segments the offsets are member boundaries.
+ * Native byte order, the index is read on the host that wrote it.
+ */
+constexpr char LogIndexMagic[8] = {'M', 'M', 'L', 'O', 'G', 'I', 'D', 'X'};
+constexpr std::uint32_t LogIndexVersion = 1;
+constexpr const char* LogIndexSuffix    = ".idx";
+
+struct LogIndexHeader {
+  char magic[8];           // LogIndexMagic
+  std::uint32_t version;   // LogIndexVersion
+  std::uint32_t reserved;  // Zero
+};
+
+struct LogIndexEntry {
+  std::int64_t wallNs;   // Wall clock time the record at offset was appended
+  std::uint64_t offset;  // Offset of the record in the segment
+};
+
+static_assert(sizeof(LogIndexHeader) == 16, "LogIndexHeader is 16 bytes");
+static_assert(sizeof(LogIndexEntry) == 16, "LogIndexEntry is 16 bytes");
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_LOGINDEX_HPP_
@@ -0,0 +1,126 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_LOGMAINTAINER_HPP_
+#define INCLUDE_COMMON_LOG_LOGMAINTAINER_HPP_
+
+#include <sys/types.h>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DisallowCopy.hpp"
+#include "LogBaseDef.hpp"
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * @brief Background maintainer of the rotated files of a file sink
+ *
+ * Every interval a low priority thread lists the files of the sink's
+ * directory starting with one of its prefixes, removes rotated files past
+ * the age limit, builds the token Bloom filters of the rotated segments and
+ * gzips them, then removes rotated files, oldest first, until all the files
+ * fit the byte budget. A file is rotated when no symlink of
+ * the directory points at it and it was not modified for an interval, the
+ * sink's writers are never waited for.
+ */
+class LogMaintainer {
+ public:
+  /**
+   * @param dir Directory of the sink's files
+   * @param prefixes Name prefixes of the sink's files
+   */
+  LogMaintainer(const std::string& dir,
+      const std::vector<std::string>& prefixes,
+      const LogMaintainConfig& config) noexcept;
+  ~LogMaintainer();
+
+  /**
+   * @brief Starts the thread, unless the config asks for nothing
+   *
+   * @return MM_STATUS_OK or MM_STATUS_ERROR if the thread can not start
+   */
+  int start() noexcept;
+
+  /**
+   * @brief Stops the thread, interrupting a compression in progress
+   */
+  void stop() noexcept;
+
+ private:
+  struct LogFileEntry {
+    std::string name;
+    std::uint64_t size;
+    time_t mtime;
+    bool active;  // Written by the sink, never touched
+  };
+
+  void maintainerThread();
+
+  /**
+   * @brief One pass over the directory
+   */
+  void maintain();
+
+  std::vector<LogFileEntry> listFiles() const;
+
+  /**
+   * @brief gzips name into name.gz and removes name
+   *
+   * @return false if stopped or on failure, name is then left alone
+   */
+  bool compressFile(LogFileEntry& entry);
+
+  /**
+   * @brief Writes the token Bloom filter of a segment, see LogBloom.hpp
+   *
+   * @param bloom Entry of the filter file, when built
+   * @return false if stopped or on failure
+   */
+  bool buildBloom(const LogFileEntry& entry, LogFileEntry& bloom);
+
+  bool stopping() const noexcept;
+
+  std::string dir_;  // Ends with a separator
+  std::vector<std::string> prefixes_;
+  const LogMaintainConfig config_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_;
+  std::thread thread_;
+
+  MM_DISALLOW_COPY_AND_MOVE(LogMaintainer)
+};
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_LOGMAINTAINER_HPP_
@@ -0,0 +1,83 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_LOGSHARD_HPP_
+#define INCLUDE_COMMON_LOG_LOGSHARD_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * Records of the per worker files of OptimizedGlogLogger (workerFiles) are
+ * "<key> <message>\n", the key being the steady clock time the message was
+ * enqueued at as LogShardKeyDigits lower case hex digits. The steady clock
+ * is shared by all the threads of the host, so the keys of all the shards
+ * order their records as the producers enqueued them, mmlog-merge uses
+ * them to turn the shards back into one stream. Messages start with the
+ * wall time and thread id of the front end, as glog no longer adds them.
+ */
+constexpr std::size_t LogShardKeyDigits = 16;
+constexpr std::size_t LogShardKeyLen    = LogShardKeyDigits + 1;  // + ' '
+
+inline void formatLogShardKey(char* out, std::uint64_t key) noexcept {
+  static const char digits[] = "0123456789abcdef";
+  for (std::size_t i = LogShardKeyDigits; i > 0; --i) {
+    out[i - 1] = digits[key & 0xf];
+    key >>= 4;
+  }
+  out[LogShardKeyDigits] = ' ';
+}
+
+/**
+ * @return false if the line does not start with a key, i.e. it continues
+ * a multi-line message
+ */
+inline bool parseLogShardKey(
+    const char* line, const std::size_t len, std::uint64_t& key) noexcept {
+  if (len < LogShardKeyLen || ' ' != line[LogShardKeyDigits]) {
+    return false;
+  }
+
+  key = 0;
+  for (std::size_t i = 0; i < LogShardKeyDigits; ++i) {
+    const char c = line[i];
+    if (c >= '0' && c <= '9') {
+      key = key << 4 | static_cast<std::uint64_t>(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      key = key << 4 | static_cast<std::uint64_t>(c - 'a' + 10);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_LOGSHARD_HPP_
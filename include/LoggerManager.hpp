@@ -51,6 +51,14 @@ class LoggerManager {
   void Start() noexcept;
 
   inline const LogConfig& config() const noexcept { return config_; }
+
+  /**
+   * @brief Reads the counters of the active logger
+   *
+   * @return MM_STATUS_ENOENT when there is no logger or it keeps no
+   * statistics
+   */
+  int getStats(LoggerStats& stats) const noexcept;
   inline LoggerManagerPid pid() const noexcept { return pid_; }
 
  private:
@@ -67,45 +75,14 @@ class LoggerManager {
   int parseCmdLineFlags(int argc, char* argv[]) noexcept;
   void checkLogConfig() noexcept;
   detail::LogLevel transCmdLevelToLogLevel(const char* cmdLevel) noexcept;
+  detail::LogSinkType transCmdSinkToSinkType(const char* cmdSink) noexcept;
+  void parseCmdRoutes(const char* cmdRoutes) noexcept;
+  void parseCmdCpus(const char* cmdCpus) noexcept;
+  detail::WorkerSchedPolicy transCmdSchedToSchedPolicy(
+      const char* cmdSched) noexcept;
+  void parseCmdIoPrio(const char* cmdIoPrio) noexcept;
+  bool hasSinkType(const detail::LogSinkType stype) const noexcept;
   detail::LogLevelCfg convertLogLevel() noexcept;
-  void outputLog(const detail::LogLevel lvl, const char* const msg,
-      const std::size_t len) noexcept;
-
-  inline void logVerbose(const char* msg, const std::size_t len) noexcept {
-    if (logger_) {
-      logger_->logVerbose(msg, len);
-    }
-  }
-
-  inline void logDebug(const char* msg, const std::size_t len) noexcept {
-    if (logger_) {
-      logger_->logDebug(msg, len);
-    }
-  }
-
-  inline void logInfo(const char* msg, const std::size_t len) noexcept {
-    if (logger_) {
-      logger_->logInfo(msg, len);
-    }
-  }
-
-  inline void logWarn(const char* msg, const std::size_t len) noexcept {
-    if (logger_) {
-      logger_->logWarn(msg, len);
-    }
-  }
-
-  inline void logError(const char* msg, const std::size_t len) noexcept {
-    if (logger_) {
-      logger_->logError(msg, len);
-    }
-  }
-
-  inline void logFatal(const char* msg, const std::size_t len) noexcept {
-    if (logger_) {
-      logger_->logFatal(msg, len);
-    }
-  }
 
   LoggerManagerPid pid_;
   LogConfig config_;
@@ -0,0 +1,73 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_NUMATOPOLOGY_HPP_
+#define INCLUDE_COMMON_LOG_NUMATOPOLOGY_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mm {
+
+namespace detail {
+
+// A NUMA node and the cpus it owns
+struct NumaNode {
+  int id;
+  std::vector<int> cpus;
+};
+
+/**
+ * @brief Parses a cpu list in the sysfs format, i.e. "0-3,6"
+ *
+ * @param list Comma separated cpus and inclusive ranges
+ * @param cpus Receives the cpus in list order
+ * @return false if the list is malformed
+ */
+bool parseCpuList(const std::string& list, std::vector<int>& cpus) noexcept;
+
+/**
+ * @brief Reads the online nodes that have cpus from sysfs
+ *
+ * @return The nodes, empty if the topology can not be read
+ */
+std::vector<NumaNode> detectNumaNodes() noexcept;
+
+/**
+ * @brief Sets the memory policy of a mapping to prefer one node, so its pages
+ * come from that node whichever thread touches them first
+ *
+ * @param addr Page aligned start of the mapping
+ * @param len Length of the mapping
+ * @param node Preferred node
+ * @return MM_STATUS_OK or MM_STATUS_ERROR
+ */
+int bindMemoryToNode(
+    void* addr, const std::size_t len, const int node) noexcept;
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_NUMATOPOLOGY_HPP_
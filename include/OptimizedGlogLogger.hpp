@@ -20,6 +20,13 @@
 
 #include "ILogger.hpp"
 #include "DisallowCopy.hpp"
+#include "LatencyHistogram.hpp"
+#include "LogDeduplicator.hpp"
+#include "LogFile.hpp"
+#include "LogMaintainer.hpp"
+#include "NumaTopology.hpp"
+#include "ShardedCounter.hpp"
+#include "SpscLogRing.hpp"
 
 namespace mm {
 
@@ -32,10 +39,18 @@ class LogMessagePool;
  * This logger implements an optimized logging strategy designed for
  * high-throughput multi-threaded environments. Features include:
  * - Asynchronous logging with non-blocking write operations
- * - Memory pooling to reduce allocations
+ * - Coalesced worker wakeups, optional spinning consumers
+ * - Optional per thread SPSC rings instead of the shared queue
+ * - Memory pooling to reduce allocations, optionally prefaulted, locked and
+ *   backed by huge pages
  * - Batch processing to reduce I/O operations
  * - Smart message dropping during overload
- * - Configurable worker threads for log processing
+ * - Optional collapsing of repeated messages
+ * - Elastic worker pool that grows under load and shrinks when idle
+ * - Optional online tuning of the batch size against a flush latency target
+ * - Configurable CPU set, scheduling policy and I/O priority of the workers
+ * - Optional pool, queue and workers per NUMA node
+ * - Optional file per worker instead of glog's shared files
  */
 class OptimizedGlogLogger final : public ILogger {
  public:
@@ -48,6 +63,7 @@ class OptimizedGlogLogger final : public ILogger {
     std::size_t len;
     LogMessage* next;  // For memory pool linked list
     size_t bufferIndex;
+    int64_t enqueueNs;  // steady clock, for the latency histograms
   };
 
   /**
@@ -59,19 +75,17 @@ class OptimizedGlogLogger final : public ILogger {
    * @param logToFile Whether to log to file
    * @param logFilePath Path for log files
    * @param logDebugSwitch Whether to enable debug logs
-   * @param batchSize Number of messages to process in a batch (default: 100)
-   * @param queueCapacity Maximum queue size before dropping messages (default:
-   * 10000)
-   * @param numWorkers Number of worker threads (default: 2)
-   * @param poolSize Size of the memory pool (default: 10000)
+   * @param logToConsole Whether to also print to the console
+   * @param optimizationConfig Batch, queue, worker, pool and dedup settings
    */
   OptimizedGlogLogger(const std::string& appId,
       const detail::LogLevel logLevelToStderr,
       const detail::LogLevel logLevelToFile, const LogToFile logToFile,
       const LogFilePath logFilePath, const LogDebugSwitch logDebugSwitch,
-      const bool logToConsole = false, size_t batchSize = 100,
-      size_t queueCapacity = 10000, size_t numWorkers = 2,
-      size_t poolSize = 10000) noexcept;
+      const bool logToConsole = false,
+      const LoggerOptimizationConfig& optimizationConfig =
+          LoggerOptimizationConfig(),
+      const LogMaintainConfig& maintainConfig = LogMaintainConfig()) noexcept;
 
   virtual ~OptimizedGlogLogger() override;
 
@@ -85,7 +99,25 @@ class OptimizedGlogLogger final : public ILogger {
   virtual void logError(const char* msg, const std::size_t len) override;
   virtual void logFatal(const char* msg, const std::size_t len) override;
 
+  virtual int getStats(LoggerStats& stats) const override;
+
  private:
+  // Indices of the performance counters
+  enum Counter : std::size_t {
+    Counter_Enqueued = 0,
+    Counter_Processed,
+    Counter_Dropped,
+    Counter_Overflow,
+    Counter_Notify,
+    Counter_WorkerScaleUp,
+    Counter_WorkerScaleDown,
+    Counter_Num,
+  };
+
+  struct QueueShard;
+  struct RingCursor;
+  struct WorkerFile;
+
   /**
    * @brief Converts internal log level to glog level
    */
@@ -93,8 +125,68 @@ class OptimizedGlogLogger final : public ILogger {
 
   /**
    * @brief Worker thread function that processes log messages
+   *
+   * @param id Number of the worker within this logger, used in its name
+   * @param shard Shard whose queue the worker drains
+   */
+  void workerThread(const size_t id, QueueShard* shard);
+
+  /**
+   * @brief Applies the name, CPU set and priorities of workerThreadConfig_
+   * to the calling worker, failures only print a warning
+   */
+  void configureWorkerThread(const size_t id, const QueueShard& shard);
+
+  /**
+   * @brief Waits with the configured strategy until the shard has enough
+   * messages queued, shutdown is requested or timeout expires
+   *
+   * @return false on timeout
+   */
+  bool waitForWork(QueueShard& shard, const std::chrono::milliseconds timeout);
+
+  /**
+   * @brief waitForWork() of the thread ring mode, producers notify once the
+   * messages pushed while workers are parked reach the wake threshold, or a
+   * ring fills up
+   *
+   * @param cursor The calling worker's view of the rings, polled for depth
+   * @return false on timeout
+   */
+  bool waitForRingWork(
+      RingCursor& cursor, const std::chrono::milliseconds timeout);
+
+  /**
+   * @brief Whether a queue depth is worth waking a worker for
+   */
+  bool isWakeDepth(const size_t depth) const noexcept;
+
+  /**
+   * @brief Starts one more worker on a shard unless the shard is at its
+   * upper bound or its last scale up is more recent than the scale up wait
+   */
+  void addWorker(QueueShard& shard);
+
+  /**
+   * @brief Lets the calling worker leave the shard if it is above its lower
+   * bound, the thread is joined by the next addWorker() or teardown()
+   *
+   * @return true if the calling worker has to exit
+   */
+  bool retireWorker(QueueShard& shard);
+
+  /**
+   * @brief Joins the workers that retired, requires workersMutex_
    */
-  void workerThread();
+  void joinRetiredWorkers();
+
+  /**
+   * @brief Adjusts the batch size and the wake threshold once per tuning
+   * period from the flush latency, enqueue rate and queue depth it saw
+   *
+   * @param cursor The calling worker's view of the rings
+   */
+  void tuneBatching(RingCursor& cursor);
 
   /**
    * @brief Enqueues a log message for async processing
@@ -108,22 +200,130 @@ class OptimizedGlogLogger final : public ILogger {
       detail::LogLevel level, const char* msg, std::size_t len);
 
   /**
-   * @brief Process a batch of log messages
+   * @brief Enqueues a log message without the repeat check
+   */
+  bool enqueueRawLogMessage(
+      detail::LogLevel level, const char* msg, std::size_t len);
+
+  /**
+   * @brief Process a batch of log messages from one shard
+   *
+   * @return true if the batch was full and the queue is falling behind,
+   * either by its depth or by the time the batch waited
+   */
+  bool processLogBatch(QueueShard& shard);
+
+  /**
+   * @brief Drains up to a batch from the thread rings, in turn or merged by
+   * enqueue time, skipping rings another worker is draining
+   *
+   * @param cursor The calling worker's view of the rings
+   * @param processed Receives the number of messages written
+   * @return true if the batch was full and its oldest message waited longer
+   * than the scale up wait
+   */
+  bool processRingBatch(RingCursor& cursor, size_t& processed);
+
+  /**
+   * @brief Copies a message into the calling thread's ring, creating and
+   * registering the ring on the thread's first message
+   *
+   * @return true if message was enqueued, false if the ring was full
+   */
+  bool enqueueToRing(detail::LogLevel level, const char* msg, std::size_t len);
+
+  /**
+   * @brief Writes an Error or Fatal message that finds no room in the
+   * calling thread's ring from that thread, so that rings drop only the
+   * levels the shared queue drops when it is full
+   *
+   * @return false for the lower levels, dropped as overflow
+   */
+  bool writeRingOverflow(
+      detail::LogLevel level, const char* msg, std::size_t len);
+
+  /**
+   * @brief Refreshes a worker's copy of the ring registry if it changed
+   */
+  void refreshRings(RingCursor& cursor);
+
+  /**
+   * @brief Messages queued in the rings of a worker's copy of the registry,
+   * read without ringsMutex_
+   */
+  size_t ringDepth(RingCursor& cursor);
+
+  /**
+   * @brief Hands one message to glog and records its latencies
+   *
+   * @param writeStartNs Start of the write, the end of the previous one
+   * @param maxEndToEndNs Raised to the end to end latency of the message
+   * @return End of the write
+   */
+  int64_t writeQueuedMessage(detail::LogLevel level, const char* msg,
+      const int64_t enqueueNs, const int64_t writeStartNs,
+      uint64_t& maxEndToEndNs);
+
+  /**
+   * @brief Feeds the worst flush of a batch to tuneBatching()
+   */
+  void recordFlushLatency(const uint64_t maxEndToEndNs);
+
+  /**
+   * @brief Hands one message to glog, or to the worker's file when they
+   * are on
+   *
+   * @param enqueueNs Key of the record in the worker's file
+   */
+  void writeLogMessage(
+      detail::LogLevel level, const char* msg, const int64_t enqueueNs);
+
+  /**
+   * @brief Opens the file "<appId>.w<id>" of a worker in the log directory
+   *
+   * @return null if it can not be opened, the worker writes to glog then
+   */
+  std::unique_ptr<WorkerFile> openWorkerFile(const size_t id);
+
+  /**
+   * @brief Appends a record to the calling worker's file, or to the file
+   * of the messages written outside of the workers, the fatal ones and
+   * those teardown() drains after the workers exited
+   *
+   * @return false if there is no file to append to, the message goes to
+   * glog then
+   */
+  bool writeWorkerRecord(const char* msg, const int64_t enqueueNs);
+
+  /**
+   * @brief Writes the records a worker file buffered
    */
-  void processLogBatch();
+  void flushWorkerFile(WorkerFile& file);
+
+  /**
+   * @brief Writes the "repeated N times" summaries of expired dedup windows
+   */
+  void flushDedupSummaries(const bool force);
 
   /**
    * @brief Determines if a message should be dropped based on priority and
    * queue state
    */
-  bool shouldDropMessage(detail::LogLevel level) const;
+  bool shouldDropMessage(detail::LogLevel level, const QueueShard& shard) const;
+
+  /**
+   * @brief Shard of the NUMA node the calling thread runs on
+   */
+  QueueShard& currentShard() noexcept;
 
   /**
    * @brief Memory pool for log messages to avoid allocations
    */
   class LogMessagePool {
    public:
-    LogMessagePool(size_t poolSize, size_t msgBufferSize);
+    // node >= 0 places the pool memory on that NUMA node
+    LogMessagePool(size_t poolSize, size_t msgBufferSize, int node,
+        const LogPoolMemoryConfig& memory);
     ~LogMessagePool();
 
     // Get a log message with buffer for the message content
@@ -135,13 +335,63 @@ class OptimizedGlogLogger final : public ILogger {
    private:
     std::mutex poolMutex_;
     LogMessage* freeList_;
-    std::vector<char*> buffers_;
-    std::vector<LogMessage*> messages_;
+    void* region_;  // One mapping holding the messages and their buffers
+    size_t regionSize_;
+    char* buffers_;
+    size_t poolSize_;
     size_t msgBufferSize_;
 
     MM_DISALLOW_COPY_AND_MOVE(LogMessagePool)
   };
 
+  /**
+   * @brief Pool, queue and workers of one NUMA node, or of the whole logger
+   * when it is not NUMA aware
+   */
+  struct QueueShard {
+    QueueShard(const int node, const std::vector<int>& cpus, size_t poolSize,
+        size_t msgBufferSize, const LogPoolMemoryConfig& memory);
+
+    const int node;               // -1 when not placed on a node
+    const std::vector<int> cpus;  // Cpus of the node, empty = any
+    LogMessagePool pool;
+    std::queue<LogMessage*> queue;
+    std::atomic<size_t> depth;  // queue.size(), readable without the lock
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t sleepers;  // Workers parked on cv, guarded by mutex
+    std::atomic<size_t> activeWorkers;
+    std::atomic<int64_t> lastScaleUpNs;
+
+    MM_DISALLOW_COPY_AND_MOVE(QueueShard)
+  };
+
+  /**
+   * @brief A worker's copy of the ring registry, refreshed when the
+   * registry version changes, and where its round robin continues
+   */
+  struct RingCursor {
+    RingCursor() : rings(), version(0), next(0) {}
+
+    std::vector<std::shared_ptr<detail::SpscLogRing>> rings;
+    uint64_t version;
+    size_t next;
+  };
+
+  /**
+   * @brief File written by one worker, records are buffered for a batch
+   * and written with a single append
+   */
+  struct WorkerFile {
+    WorkerFile(const std::string& dir, const std::string& baseName)
+        : file(dir, baseName, LogFileConfig()), records() {}
+
+    detail::LogFile file;
+    std::string records;
+
+    MM_DISALLOW_COPY_AND_MOVE(WorkerFile)
+  };
+
   // Logger configuration
   std::string appId_;
   detail::LogLevel logLevelToStderr_;
@@ -151,27 +401,85 @@ class OptimizedGlogLogger final : public ILogger {
   LogDebugSwitch logDebugSwitch_;
   bool logToConsole_;
 
-  // Performance configuration
+  // Performance configuration, queueCapacity_ is per shard
+  const std::vector<detail::NumaNode> numaNodes_;  // Empty if not NUMA aware
   const size_t batchSize_;
   const size_t queueCapacity_;
   const size_t numWorkers_;
+  const size_t minWorkers_;
+  const size_t maxWorkers_;
+  const int64_t scaleUpWaitNs_;
+  const std::chrono::milliseconds workerIdle_;
+  const int64_t targetFlushLatencyNs_;  // 0 when tuning is off
+  const LogWorkerThreadConfig workerThreadConfig_;
+  const detail::WaitStrategy waitStrategy_;
+  const std::chrono::microseconds spinTime_;
+  const detail::ThreadRingMode threadRingMode_;
+  const size_t ringSize_;  // Bytes per thread ring
+  const bool workerFiles_;
   const size_t msgBufferSize_ = 2048;  // Max message size
 
-  // Worker threads and synchronization
+  // Worker threads, retired workers wait in retiredWorkers_ to be joined
+  std::mutex workersMutex_;
   std::vector<std::thread> workers_;
-  std::queue<LogMessage*> messageQueue_;
-  std::mutex queueMutex_;
-  std::condition_variable queueCV_;
-  std::atomic<bool> shutdown_;
-
-  // Memory management
-  std::unique_ptr<LogMessagePool> messagePool_;
-
-  // Performance metrics
-  std::atomic<uint64_t> enqueuedCount_;
-  std::atomic<uint64_t> processedCount_;
-  std::atomic<uint64_t> droppedCount_;
-  std::atomic<uint64_t> overflowCount_;
+  std::vector<std::thread::id> retiredWorkers_;
+  size_t nextWorkerId_;
+
+  // Worker files, set up only when logging to a file. The workers own
+  // theirs, drainFile_ takes the fatal messages and what teardown() drains
+  // after the workers exited
+  std::string workerFileDir_;  // Empty when the workers write to glog
+  static thread_local WorkerFile* currentWorkerFile_;
+  static thread_local bool inWorker_;  // A worker, with or without a file
+  std::mutex drainFileMutex_;
+  std::unique_ptr<WorkerFile> drainFile_;
+
+  // Batching tuned by tuneBatching(), fixed at batchSize_ when it is off
+  std::atomic<size_t> effectiveBatchSize_;
+  std::atomic<size_t> wakeThreshold_;
+  std::atomic<int64_t> lastTuneNs_;
+  std::atomic<uint64_t> lastTuneEnqueued_;
+  std::atomic<uint64_t> maxFlushLatencyNs_;  // Worst of the tuning period
+
+  // Message queues and pools, one per NUMA node, cpuShards_ maps a cpu to
+  // the index of its node's shard
+  std::vector<std::unique_ptr<QueueShard>> shards_;
+  std::vector<size_t> cpuShards_;
+
+  // Thread rings, registered by their producers on first use and dropped
+  // by the workers once their thread exited and they are drained. The
+  // version changes with every registration or removal
+  const uint64_t loggerId_;  // Tells this logger's rings apart in a thread
+  std::mutex ringsMutex_;
+  std::vector<std::shared_ptr<detail::SpscLogRing>> rings_;
+  std::atomic<uint64_t> ringsVersion_;
+
+  // Workers parked in waitForRingWork(), producers read ringSleepers_ and
+  // only count their pushes in ringParkedDepth_ while a worker is parked
+  std::mutex ringWaitMutex_;
+  std::condition_variable ringCv_;
+  std::atomic<size_t> ringSleepers_;
+  std::atomic<size_t> ringParkedDepth_;  // Queued since the first one parked
+  size_t ringWakeups_;  // Pending producer notifications, guarded
+
+  // Polled by every worker, kept away from the lines written per message
+  alignas(detail::CacheLineSize) std::atomic<bool> shutdown_;
+
+  // Repeated message suppression, null when disabled
+  std::unique_ptr<LogDeduplicator> deduplicator_;
+  const std::chrono::milliseconds dedupWindow_;
+
+  // Compression and retention of glog's rotated files, null without them
+  std::unique_ptr<detail::LogMaintainer> maintainer_;
+  const LogMaintainConfig maintainConfig_;
+
+  // Performance metrics, sharded per thread
+  detail::ShardedCounters<Counter_Num> counters_;
+
+  // Latencies recorded by the workers
+  detail::LatencyHistogram queueWaitLatency_;
+  detail::LatencyHistogram writeLatency_;
+  detail::LatencyHistogram endToEndLatency_;
 
   // Rate limiting for log types
   struct RateLimitEntry {
@@ -0,0 +1,98 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_ROUTERLOGGER_HPP_
+#define INCLUDE_COMMON_LOG_ROUTERLOGGER_HPP_
+
+#include <vector>
+
+#include "DisallowCopy.hpp"
+#include "ILogger.hpp"
+
+namespace mm {
+
+/**
+ * @brief Fan-out sink that forwards every message to several child sinks
+ *
+ * The message is formatted once by the logging front end and the same buffer
+ * is handed to every child whose level mask accepts it, so "console at WARN,
+ * file at INFO" costs one format and one pass over the children. The router
+ * owns its children and destroys them with itself.
+ */
+class RouterLogger final : public ILogger {
+ public:
+  RouterLogger() noexcept = default;
+  virtual ~RouterLogger() override;
+
+  /**
+   * @brief Adds a child sink, taking ownership of it
+   *
+   * @param logger Child sink, created by the logger factory
+   * @param mask Level mask (detail::LogLevelCfg_*) the child accepts
+   * @param timestamp Whether the child prints the front end timestamp, sinks
+   * that stamp by themselves (glog) get the message without it
+   */
+  void addRoute(ILogger* logger, const detail::LogLevelCfg mask,
+      const bool timestamp);
+
+  virtual int setup() override;
+  virtual int teardown() override;
+
+  virtual void logVerbose(const char* msg, const std::size_t len) override;
+  virtual void logDebug(const char* msg, const std::size_t len) override;
+  virtual void logInfo(const char* msg, const std::size_t len) override;
+  virtual void logWarn(const char* msg, const std::size_t len) override;
+  virtual void logError(const char* msg, const std::size_t len) override;
+  virtual void logFatal(const char* msg, const std::size_t len) override;
+
+  // Sum of the children that keep statistics
+  virtual int getStats(LoggerStats& stats) const override;
+
+ private:
+  using LogFunc = void (ILogger::*)(const char*, const std::size_t);
+
+  struct Route {
+    ILogger* logger;
+    detail::LogLevelCfg mask;
+    bool timestamp;
+  };
+
+  void dispatch(const detail::LogLevel lvl, LogFunc func, const char* msg,
+      const std::size_t len);
+
+  /**
+   * @brief Length of the "date time.ms tid" prefix outputLog() puts in front
+   * of the message when timestamps are enabled
+   */
+  std::size_t timestampLength(const char* msg, const std::size_t len) const
+      noexcept;
+
+  std::vector<Route> routes_;
+  bool timestamp_ = false;  // Messages carry the front end timestamp
+
+  MM_DISALLOW_COPY_AND_MOVE(RouterLogger)
+};
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_ROUTERLOGGER_HPP_
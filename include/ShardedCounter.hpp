@@ -0,0 +1,111 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_SHARDEDCOUNTER_HPP_
+#define INCLUDE_COMMON_LOG_SHARDEDCOUNTER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mm {
+
+namespace detail {
+
+enum : std::size_t { CacheLineSize = 64 };
+
+/**
+ * @brief Shard of the calling thread, threads are numbered on first use
+ */
+inline std::size_t counterShardIndex() noexcept {
+  static std::atomic<std::size_t> nextIndex(0);
+  thread_local const std::size_t index =
+      nextIndex.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+/**
+ * @brief N counters sharded per thread
+ *
+ * Every thread increments the counters in its own cache line, so hot path
+ * counting never bounces a line shared with other threads, and the N
+ * counters of one thread share that line. Reads sum all shards and are
+ * meant for statistics, not for synchronisation. Up to ShardCount threads
+ * never share a shard; beyond that shards are reused, which stays correct
+ * since the increments are atomic.
+ *
+ * @tparam N number of counters, indexed 0..N-1
+ */
+template <std::size_t N>
+class ShardedCounters {
+  static_assert(N > 0, "ShardedCounters needs at least one counter");
+
+ public:
+  enum : std::size_t { ShardCount = 64 };
+
+  ShardedCounters() noexcept {
+    for (Shard& shard : shards_) {
+      for (std::atomic<std::uint64_t>& value : shard.values) {
+        value.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void add(const std::size_t counter, const std::uint64_t n = 1) noexcept {
+    shards_[counterShardIndex() & (ShardCount - 1)].values[counter].fetch_add(
+        n, std::memory_order_relaxed);
+  }
+
+  std::uint64_t load(const std::size_t counter) const noexcept {
+    std::uint64_t sum = 0;
+    for (const Shard& shard : shards_) {
+      sum += shard.values[counter].load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+ private:
+  struct alignas(CacheLineSize) Shard {
+    std::atomic<std::uint64_t> values[N];
+  };
+
+  Shard shards_[ShardCount];
+};
+
+/**
+ * @brief A single sharded counter
+ */
+class ShardedCounter {
+ public:
+  void add(const std::uint64_t n = 1) noexcept { counters_.add(0, n); }
+  std::uint64_t load() const noexcept { return counters_.load(0); }
+
+ private:
+  ShardedCounters<1> counters_;
+};
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_SHARDEDCOUNTER_HPP_
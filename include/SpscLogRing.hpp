@@ -0,0 +1,252 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_SPSCLOGRING_HPP_
+#define INCLUDE_COMMON_LOG_SPSCLOGRING_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#include "DisallowCopy.hpp"
+#include "LogBaseDef.hpp"
+#include "ShardedCounter.hpp"
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * @brief Single producer, single consumer ring of variable length messages
+ *
+ * One thread pushes, and whichever consumer holds tryAcquire() reads, so
+ * several workers can share the rings of many producers while each ring
+ * keeps a single reader at a time. The producer and the consumer indices
+ * live in separate cache lines and the producer caches the consumer's
+ * index, so a push only reads the consumer's line when the ring looks full.
+ *
+ * A record is a header followed by the NUL terminated message, padded to
+ * the header size, and never wraps: a record not fitting before the
+ * end of the buffer is preceded by a skip marker and starts at offset 0.
+ */
+class SpscLogRing {
+ public:
+  // A record handed to the consumer, valid until pop()
+  struct Record {
+    LogLevel level;
+    const char* msg;  // NUL terminated
+    std::size_t len;
+    std::int64_t enqueueNs;
+  };
+
+  /**
+   * @param capacity Bytes, rounded up to a power of two, empty if the
+   * buffer can not be allocated
+   */
+  explicit SpscLogRing(const std::size_t capacity) noexcept
+      : tail_(0),
+        cachedHead_(0),
+        pushed_(0),
+        head_(0),
+        popped_(0),
+        consuming_(false),
+        closed_(false),
+        capacity_(roundUpPow2(capacity)),
+        data_(new (std::nothrow) char[capacity_]) {
+    if (!data_) {
+      capacity_ = 0;
+    }
+  }
+
+  // Producer side
+
+  /**
+   * @brief Copies a message into the ring
+   *
+   * @return false if the ring is full or the message can never fit
+   */
+  bool push(const LogLevel level, const char* msg, const std::size_t len,
+      const std::int64_t enqueueNs) noexcept {
+    const std::size_t size = recordSize(len);
+    if (size > capacity_ / 2) {
+      return false;
+    }
+
+    std::size_t tail       = tail_.load(std::memory_order_relaxed);
+    const std::size_t pos  = tail & (capacity_ - 1);
+    const std::size_t room = capacity_ - pos;
+    const std::size_t need = (room < size) ? room + size : size;
+
+    if (tail + need - cachedHead_ > capacity_) {
+      cachedHead_ = head_.load(std::memory_order_acquire);
+      if (tail + need - cachedHead_ > capacity_) {
+        return false;
+      }
+    }
+
+    if (room < size) {
+      Header skip{SkipMarker, 0, 0};
+      std::memcpy(data_.get() + pos, &skip, sizeof(skip));
+      tail += room;
+    }
+
+    char* record = data_.get() + (tail & (capacity_ - 1));
+    Header header{static_cast<std::uint32_t>(len),
+        static_cast<std::uint32_t>(level), enqueueNs};
+    std::memcpy(record, &header, sizeof(header));
+    std::memcpy(record + sizeof(header), msg, len);
+    record[sizeof(header) + len] = '\0';
+
+    tail_.store(tail + size, std::memory_order_release);
+    pushed_.store(pushed_.load(std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+    return true;
+  }
+
+  // Messages pushed so far, for the producer's depth checks
+  std::size_t pushed() const noexcept {
+    return pushed_.load(std::memory_order_relaxed);
+  }
+
+  // Marks the ring as abandoned by its producer
+  void close() noexcept { closed_.store(true, std::memory_order_release); }
+
+  // Consumer side
+
+  /**
+   * @brief Makes the caller the ring's only consumer until release()
+   */
+  bool tryAcquire() noexcept {
+    return !consuming_.load(std::memory_order_relaxed) &&
+           !consuming_.exchange(true, std::memory_order_acquire);
+  }
+
+  void release() noexcept {
+    consuming_.store(false, std::memory_order_release);
+  }
+
+  /**
+   * @brief Reads the oldest record without removing it
+   *
+   * @return false if the ring is empty
+   */
+  bool peek(Record& record) noexcept {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    const char* data = data_.get() + (head & (capacity_ - 1));
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (SkipMarker == header.len) {
+      // the producer wrote the real record at offset 0
+      head += capacity_ - (head & (capacity_ - 1));
+      head_.store(head, std::memory_order_release);
+      data = data_.get();
+      std::memcpy(&header, data, sizeof(header));
+    }
+
+    record.level     = static_cast<LogLevel>(header.level);
+    record.msg       = data + sizeof(header);
+    record.len       = header.len;
+    record.enqueueNs = header.enqueueNs;
+    return true;
+  }
+
+  /**
+   * @brief Removes the record returned by the last peek()
+   */
+  void pop(const Record& record) noexcept {
+    head_.store(head_.load(std::memory_order_relaxed) + recordSize(record.len),
+        std::memory_order_release);
+    popped_.store(popped_.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+  }
+
+  // Messages queued, as seen from the consumer side
+  std::size_t size() const noexcept {
+    return pushed_.load(std::memory_order_acquire) -
+           popped_.load(std::memory_order_relaxed);
+  }
+
+  // Messages the consumers have taken, for the producer's depth checks
+  std::size_t popped() const noexcept {
+    return popped_.load(std::memory_order_relaxed);
+  }
+
+  bool closed() const noexcept {
+    return closed_.load(std::memory_order_acquire);
+  }
+
+  bool valid() const noexcept { return 0 != capacity_; }
+
+ private:
+  struct Header {
+    std::uint32_t len;
+    std::uint32_t level;
+    std::int64_t enqueueNs;
+  };
+
+  enum : std::uint32_t { SkipMarker = 0xffffffffu };
+
+  // Records are multiples of the header size, so the room left before the
+  // end of the buffer always holds a skip marker
+  static std::size_t recordSize(const std::size_t len) noexcept {
+    return (sizeof(Header) + len + 1 + sizeof(Header) - 1) &
+           ~(sizeof(Header) - 1);
+  }
+
+  static std::size_t roundUpPow2(const std::size_t n) noexcept {
+    std::size_t pow2 = sizeof(Header) * 2;
+    while (pow2 < n) {
+      pow2 <<= 1;
+    }
+    return pow2;
+  }
+
+  // Written by the producer
+  alignas(CacheLineSize) std::atomic<std::size_t> tail_;
+  std::size_t cachedHead_;  // Last head_ the producer read
+  std::atomic<std::size_t> pushed_;
+
+  // Written by the consumer
+  alignas(CacheLineSize) std::atomic<std::size_t> head_;
+  std::atomic<std::size_t> popped_;
+  std::atomic<bool> consuming_;
+
+  alignas(CacheLineSize) std::atomic<bool> closed_;
+  std::size_t capacity_;
+  std::unique_ptr<char[]> data_;
+
+  MM_DISALLOW_COPY_AND_MOVE(SpscLogRing)
+};
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_SPSCLOGRING_HPP_
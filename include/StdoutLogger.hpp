@@ -24,10 +24,24 @@
 #ifndef INCLUDE_COMMON_LOG_STDOUTLOGGER_HPP_
 #define INCLUDE_COMMON_LOG_STDOUTLOGGER_HPP_
 
+#include <cstdio>
+
 #include "ILogger.hpp"
 
 namespace mm {
 
+namespace detail {
+
+// Writes msg and a newline as one line, shared with StdoutSink
+inline void writeStdoutLine(const char* msg, const std::size_t len) noexcept {
+  ::flockfile(stdout);
+  ::fwrite_unlocked(msg, 1, len, stdout);
+  ::fputc_unlocked('\n', stdout);
+  ::funlockfile(stdout);
+}
+
+}  // namespace detail
+
 class StdoutLogger final : public ILogger {
  public:
   StdoutLogger(bool logToConsole = false) noexcept
@@ -0,0 +1,356 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_TYPEDLOG_HPP_
+#define INCLUDE_COMMON_LOG_TYPEDLOG_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "Log.hpp"
+#include "LogFormatter.hpp"
+
+/**
+ * Type safe counterpart of the MM_* macros:
+ *   MM_LOG(Info, "frame %d took %.2f ms", id, ms);
+ *   mm::log<mm::detail::LogLevel_Warn>(MM_FMT("lost %s"), name);
+ *
+ * The format is compiled into segments at compile time. A malformed format,
+ * a wrong argument count or an argument that does not fit its conversion is
+ * a compile error rather than undefined behaviour. The worst case length of
+ * the message is known as well, so the stack buffer is sized for it and no
+ * format is parsed at runtime. Length modifiers are accepted but not needed,
+ * the argument's own type decides.
+ */
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * @brief Call site of a typed log statement. Tag carries the format string
+ * in its type, see MM_FMT().
+ */
+template <typename Tag>
+struct TypedFormat {
+  const char* file;
+  const char* func;
+  int line;
+};
+
+template <typename Tag>
+constexpr TypedFormat<Tag> makeTypedFormat(const Tag, const char* file,
+    const char* func, const int line) noexcept {
+  return {file, func, line};
+}
+
+template <typename T>
+constexpr TypedArg::Kind typedArgKind() noexcept {
+  using U = std::remove_cv_t<std::decay_t<T>>;
+
+  if constexpr (std::is_enum_v<U>) {
+    return typedArgKind<std::underlying_type_t<U>>();
+  } else if constexpr (std::is_same_v<U, bool>) {
+    return TypedArg::Kind_Unsigned;
+  } else if constexpr (std::is_integral_v<U>) {
+    static_assert(sizeof(U) <= sizeof(long long), "integer too wide to log");
+    return std::is_signed_v<U> ? TypedArg::Kind_Signed
+                               : TypedArg::Kind_Unsigned;
+  } else if constexpr (std::is_same_v<U, float> || std::is_same_v<U, double>) {
+    return TypedArg::Kind_Double;
+  } else if constexpr (std::is_same_v<U, char*> ||
+                       std::is_same_v<U, const char*>) {
+    return TypedArg::Kind_CString;
+  } else if constexpr (std::is_same_v<U, std::string> ||
+                       std::is_same_v<U, std::string_view>) {
+    return TypedArg::Kind_String;
+  } else if constexpr (std::is_same_v<U, std::nullptr_t>) {
+    return TypedArg::Kind_Pointer;
+  } else if constexpr (std::is_pointer_v<U>) {
+    return std::is_function_v<std::remove_pointer_t<U>>
+               ? TypedArg::Kind_None
+               : TypedArg::Kind_Pointer;
+  } else {
+    return TypedArg::Kind_None;
+  }
+}
+
+constexpr bool isTypedArgAccepted(
+    const char conv, const TypedArg::Kind kind) noexcept {
+  switch (conv) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+    case 'c':
+      return (TypedArg::Kind_Signed == kind) ||
+             (TypedArg::Kind_Unsigned == kind);
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'g': return TypedArg::Kind_Double == kind;
+    case 's':
+      return (TypedArg::Kind_CString == kind) ||
+             (TypedArg::Kind_String == kind);
+    case 'p':
+      return (TypedArg::Kind_Pointer == kind) ||
+             (TypedArg::Kind_CString == kind);
+    default: return false;
+  }
+}
+
+// Number of arguments the format consumes
+constexpr std::size_t countTypedArgs(const CompiledFormat& fmt) noexcept {
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < fmt.count; ++i) {
+    if ('%' != fmt.segments[i].spec.conv) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+template <typename... Args>
+constexpr bool checkTypedArgs(const CompiledFormat& fmt) noexcept {
+  constexpr TypedArg::Kind kinds[] = {
+      typedArgKind<Args>()..., TypedArg::Kind_None};
+
+  std::size_t arg = 0;
+  for (std::size_t i = 0; i < fmt.count; ++i) {
+    const char conv = fmt.segments[i].spec.conv;
+    if ('%' == conv) {
+      continue;
+    }
+    if ((arg >= sizeof...(Args)) || !isTypedArgAccepted(conv, kinds[arg])) {
+      return false;
+    }
+    ++arg;
+  }
+  return true;
+}
+
+enum : std::size_t { TypedSizeUnbounded = SIZE_MAX };
+
+// Worst case output of one conversion
+constexpr std::size_t maxConversionSize(const FormatSpec& spec) noexcept {
+  const std::size_t width =
+      (spec.width > 0) ? static_cast<std::size_t>(spec.width) : 0;
+  const std::size_t precision =
+      (spec.precision > 0) ? static_cast<std::size_t>(spec.precision) : 0;
+
+  std::size_t n = 0;
+  switch (spec.conv) {
+    case '%': return 1;
+    case 'c': n = 1; break;
+    case 'p': n = 2 + 16; break;
+    case 's':
+      // strings are bounded by an explicit precision only
+      if (spec.precision < 0) {
+        return TypedSizeUnbounded;
+      }
+      n = precision;
+      break;
+    case 'f':
+    case 'F':
+      // sign, the 309 integral digits of DBL_MAX, point and decimals
+      n = 1 + 309 + 1 + ((spec.precision < 0) ? 6 : precision);
+      break;
+    case 'e':
+    case 'g':
+      // sign, digit, point, decimals and "e+308"
+      n = 1 + 1 + 1 + ((spec.precision < 0) ? 6 : precision) + 5;
+      break;
+    default:
+      // sign or "0x" and the 22 octal digits of a 64 bit value
+      n = 2 + ((precision > 22) ? precision : 22);
+      break;
+  }
+
+  return (width > n) ? width : n;
+}
+
+constexpr std::size_t maxFormattedSize(const CompiledFormat& fmt) noexcept {
+  std::size_t n = fmt.tailLen;
+  for (std::size_t i = 0; i < fmt.count; ++i) {
+    const std::size_t conv = maxConversionSize(fmt.segments[i].spec);
+    if (TypedSizeUnbounded == conv) {
+      return TypedSizeUnbounded;
+    }
+    n += fmt.segments[i].literalLen + conv;
+  }
+  return n;
+}
+
+template <typename T>
+inline TypedArg makeTypedArg(const T& value) noexcept {
+  using U = std::remove_cv_t<std::decay_t<T>>;
+  constexpr TypedArg::Kind kind = typedArgKind<T>();
+
+  TypedArg arg = {};
+  arg.kind     = kind;
+
+  if constexpr (std::is_enum_v<U>) {
+    return makeTypedArg(static_cast<std::underlying_type_t<U>>(value));
+  } else if constexpr (TypedArg::Kind_Signed == kind) {
+    arg.size    = sizeof(U);
+    arg.value.i = value;
+  } else if constexpr (TypedArg::Kind_Unsigned == kind) {
+    arg.size    = sizeof(U);
+    arg.value.u = value;
+  } else if constexpr (TypedArg::Kind_Double == kind) {
+    arg.value.d = value;
+  } else if constexpr (TypedArg::Kind_CString == kind) {
+    arg.value.s = {value, 0};
+  } else if constexpr (TypedArg::Kind_String == kind) {
+    arg.value.s = {value.data(), value.size()};
+  } else if constexpr (TypedArg::Kind_Pointer == kind) {
+    arg.value.p = value;
+  }
+
+  return arg;
+}
+
+/**
+ * @brief Compile time facts about format Tag used with Args
+ *
+ * Instantiating it checks the format against the arguments.
+ */
+template <typename Tag, typename... Args>
+struct TypedFormatTraits {
+  static constexpr std::string_view text = Tag::value();
+  static constexpr CompiledFormat format = compileFormat(text);
+
+  static_assert(format.supported,
+      "mm::log: unsupported format, too many conversions or '*', '$', %n, "
+      "%a, %L, wide conversions, '#' with %e/%g or '0', '+', ' ' and a "
+      "precision with %p");
+  static_assert(countTypedArgs(format) == sizeof...(Args),
+      "mm::log: argument count does not match the format");
+  static_assert(checkTypedArgs<Args...>(format),
+      "mm::log: argument type does not match its conversion");
+
+  static constexpr std::size_t bodyMax = maxFormattedSize(format);
+
+  // Worst case prefix and body, capped at LogStackBufferSize
+  static constexpr std::size_t bufferSize =
+      (bodyMax < std::size_t{LogStackBufferSize} - LogPrefixMaxSize - 1)
+          ? LogPrefixMaxSize + bodyMax + 1
+          : std::size_t{LogStackBufferSize};
+};
+
+/**
+ * @brief Formats the body of a typed log statement, snprintf style
+ */
+template <typename Tag, typename... Args>
+inline int formatTypedBody(
+    char* buf, const std::size_t len, const Args&... args) noexcept {
+  using Traits = TypedFormatTraits<Tag, Args...>;
+
+  const TypedArg typedArgs[] = {makeTypedArg(args)..., TypedArg()};
+  return formatTyped(
+      buf, len, Traits::format, Traits::text.data(), typedArgs);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Logs a message through the installed sink, see MM_LOG()
+ *
+ * @param fmt format built with MM_FMT(), carrying the call site
+ * @param args one argument per conversion, checked at compile time
+ */
+template <detail::LogLevel Level, typename Tag, typename... Args>
+inline void log(const detail::TypedFormat<Tag>& fmt,
+    const Args&... args) noexcept {
+  // instantiating the traits checks fmt against Args
+  using Traits = detail::TypedFormatTraits<Tag, Args...>;
+  static_assert(Traits::bufferSize <= detail::LogStackBufferSize,
+      "mm::log: buffer above LogStackBufferSize");
+
+#ifdef MM_ENABLE_LOGGING
+#ifndef MM_ENABLE_DEBUG
+  if constexpr (detail::LogLevel_Debug == Level) {
+    return;
+  }
+#endif
+
+  if (!detail::isLogEnabled(Level)) {
+    return;
+  }
+
+  constexpr std::size_t bufSize = Traits::bufferSize;
+
+  char buf[bufSize];
+  const int offset = detail::formatLogPrefix(
+      buf, bufSize, Level, fmt.file, fmt.func, fmt.line);
+  if (0 > offset) {
+    return;
+  }
+
+  std::size_t len = static_cast<std::size_t>(offset);
+  if (len < bufSize) {
+    const int n =
+        detail::formatTypedBody<Tag>(buf + len, bufSize - len, args...);
+    if (0 > n) {
+      return;
+    }
+    len += static_cast<std::size_t>(n);
+  }
+
+  detail::writeLog(Level, buf, (len < bufSize) ? len : bufSize - 1);
+#else
+  (void)fmt;
+  ((void)args, ...);
+#endif
+}
+
+}  // namespace mm
+
+/**
+ * Wraps a string literal into a unique type, so that mm::log() can compile
+ * it, and records the call site.
+ */
+#define MM_FMT(str)                                                  \
+  mm::detail::makeTypedFormat(                                       \
+      [] {                                                           \
+        struct MmTypedFormat {                                       \
+          static constexpr std::string_view value() { return str; }  \
+        };                                                           \
+        return MmTypedFormat{};                                      \
+      }(),                                                           \
+      __file__, __func__, __LINE__)
+
+#ifdef MM_ENABLE_LOGGING
+// lvl is one of Verbose, Debug, Info, Warn, Error, Fatal
+#define MM_LOG(lvl, fmt, ...) \
+  mm::log<mm::detail::LogLevel_##lvl>(MM_FMT(fmt), ##__VA_ARGS__)
+#else
+#define MM_LOG(lvl, fmt, ...)
+#endif
+
+#endif  // INCLUDE_COMMON_LOG_TYPEDLOG_HPP_
@@ -0,0 +1,155 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef INCLUDE_COMMON_LOG_URINGFILEWRITER_HPP_
+#define INCLUDE_COMMON_LOG_URINGFILEWRITER_HPP_
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "DisallowCopy.hpp"
+
+namespace mm {
+
+namespace detail {
+
+/**
+ * @brief Minimal io_uring of positional file writes
+ *
+ * Talks to the kernel through the raw syscalls, so it needs the
+ * linux/io_uring.h header but not liburing. The file is registered as fixed
+ * file 0, and the buffers registered with registerBuffers() are written
+ * with IORING_OP_WRITE_FIXED, other memory with IORING_OP_WRITE. Not thread
+ * safe, one thread prepares, submits and reaps, and reaps every write before
+ * the buffers or the writer are destroyed.
+ */
+class UringFileWriter {
+ public:
+  UringFileWriter() noexcept;
+  ~UringFileWriter();
+
+  /**
+   * @brief Creates the ring and registers fd as fixed file 0
+   *
+   * @param entries Writes that can be in flight at once
+   * @return MM_STATUS_OK, MM_STATUS_ERROR if the kernel has no io_uring or
+   * forbids it
+   */
+  int setup(const unsigned entries, const int fd) noexcept;
+
+  /**
+   * @brief Pins buffers for IORING_OP_WRITE_FIXED, buffer i of iovecs is
+   * later addressed by index i
+   *
+   * @return MM_STATUS_OK or MM_STATUS_ERROR, writes then use plain
+   * IORING_OP_WRITE
+   */
+  int registerBuffers(
+      const struct iovec* iovecs, const unsigned count) noexcept;
+
+  /**
+   * @brief Points fixed file 0 at another file, call with nothing in flight
+   */
+  int updateFile(const int fd) noexcept;
+
+  /**
+   * @brief Queues a write of data at offset, submitted by submit()
+   *
+   * @param bufIndex Index of the registered buffer holding data, or -1
+   * @param userData Handed back by reap()
+   * @return false if inFlight() already reached the ring size
+   */
+  bool prepareWrite(const char* data, const std::size_t len,
+      const off_t offset, const int bufIndex,
+      const std::uint64_t userData) noexcept;
+
+  /**
+   * @brief Submits the prepared writes
+   *
+   * @param waitFor Blocks until this many completions are available
+   * @return MM_STATUS_OK or MM_STATUS_ERROR
+   */
+  int submit(const unsigned waitFor = 0) noexcept;
+
+  /**
+   * @brief Calls done(userData, result) for every completed write, result
+   * being the bytes written or -errno
+   *
+   * @return Number of completions reaped
+   */
+  template <typename Done>
+  unsigned reap(Done&& done) noexcept {
+    unsigned reaped = 0;
+    std::uint64_t userData;
+    std::int32_t result;
+    while (nextCompletion(userData, result)) {
+      ++reaped;
+      done(userData, result);
+    }
+    return reaped;
+  }
+
+  /**
+   * @brief Destroys the ring, call with nothing in flight
+   */
+  void close() noexcept;
+
+  unsigned inFlight() const noexcept { return inFlight_; }
+  bool fixedBuffers() const noexcept { return fixedBuffers_; }
+
+ private:
+  bool nextCompletion(std::uint64_t& userData, std::int32_t& result) noexcept;
+
+  int ringFd_;
+  unsigned entries_;
+  unsigned inFlight_;  // Prepared or submitted, not yet reaped
+  unsigned toSubmit_;  // Prepared since the last submit()
+  bool fixedBuffers_;
+
+  // Shared with the kernel
+  void* sqRing_;
+  std::size_t sqRingSize_;
+  void* cqRing_;
+  std::size_t cqRingSize_;
+  void* sqes_;
+  std::size_t sqesSize_;
+
+  unsigned* sqHead_;
+  unsigned* sqTail_;
+  unsigned sqMask_;
+  unsigned* sqArray_;
+  unsigned* cqHead_;
+  unsigned* cqTail_;
+  unsigned cqMask_;
+  void* cqes_;
+
+  MM_DISALLOW_COPY_AND_MOVE(UringFileWriter)
+};
+
+}  // namespace detail
+
+}  // namespace mm
+
+#endif  // INCLUDE_COMMON_LOG_URINGFILEWRITER_HPP_
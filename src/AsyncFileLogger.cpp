@@ -0,0 +1,780 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "AsyncFileLogger.hpp"
+
+#include <limits.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <system_error>
+
+#include "LoggerStatus.hpp"
+
+namespace mm {
+
+namespace {
+
+inline int64_t steadyNowNs() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Buffers kept by the writer, one to replace current_ and one for next_,
+// the ones allocated during a burst are freed once written
+constexpr std::size_t MaxSpareBuffers = 2;
+
+enum : std::uint16_t { DefaultMaxPathSize = 256 };
+
+/**
+ * @brief pwritev(2) of all of iovecs at offset, resuming after short writes
+ *
+ * @return false with errno set on failure
+ */
+bool writeFully(const int fd, off_t offset, struct iovec* iovecs, int count) {
+  while (count > 0) {
+    const ssize_t n = ::pwritev(fd, iovecs, count, offset);
+    if (0 > n) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return false;
+    }
+
+    offset += n;
+    std::size_t done = static_cast<std::size_t>(n);
+    while (count > 0 && done >= iovecs->iov_len) {
+      done -= iovecs->iov_len;
+      ++iovecs;
+      --count;
+    }
+    if (count > 0) {
+      iovecs->iov_base = static_cast<char*>(iovecs->iov_base) + done;
+      iovecs->iov_len -= done;
+    }
+  }
+  return true;
+}
+
+std::string defaultLogDirectory() noexcept {
+  char curAbsPath[DefaultMaxPathSize];
+  if (nullptr == getcwd(curAbsPath, DefaultMaxPathSize)) {
+    return "./logs/";
+  }
+
+  std::string dir = curAbsPath;
+  dir += "/logs/";
+  return dir;
+}
+
+}  // namespace
+
+namespace detail {
+
+bool LogFileBuffer::append(const char* msg, const std::size_t len) noexcept {
+  if (len + 1 > capacity_ - size_) {
+    return false;
+  }
+
+  if (0 == count_) {
+    // once per buffer, for the time index of the file
+    firstNs_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch())
+                   .count();
+  }
+
+  std::memcpy(data_.get() + size_, msg, len);
+  data_[size_ + len] = '\n';
+  size_ += len + 1;
+  ++count_;
+  return true;
+}
+
+}  // namespace detail
+
+AsyncFileLogger::AsyncFileLogger(const std::string& appId,
+    const LogFilePath logFilePath, const LogFileConfig& fileConfig,
+    const LogMaintainConfig& maintainConfig) noexcept
+    : bufferSize_(fileConfig.bufferKb * 1024),
+      flushInterval_(fileConfig.flushIntervalMs),
+      maxBuffers_(fileConfig.maxBuffers),
+      fileWriter_(fileConfig.writer),
+      uringDepth_(fileConfig.uringDepth),
+      fileSync_(fileConfig.sync),
+      fileCompress_(fileConfig.compress),
+      compressLevel_(fileConfig.compressLevel),
+      mappedWrites_(detail::FileWriter_Mmap == fileConfig.writer &&
+                    detail::FileCompress_None == fileConfig.compress),
+      file_(logFilePath.empty() ? defaultLogDirectory() : logFilePath,
+          appId.empty() ? "mmlog" : appId, fileConfig),
+      maintainer_(file_.dir(), {file_.baseName() + "."}, maintainConfig),
+      current_(),
+      next_(),
+      buffers_(),
+      running_(false),
+      enqueued_(0),
+      dropped_(0),
+      windowWake_(false),
+      writer_(),
+      spares_(),
+      writeFailed_(false),
+      processed_(0),
+      writeLatency_(),
+      compressor_(),
+      uring_(),
+      uringActive_(false),
+      uringFd_(-1),
+      writes_() {
+  if (mappedWrites_) {
+    file_.deferUnmap();
+  }
+}
+
+AsyncFileLogger::~AsyncFileLogger() { teardown(); }
+
+int AsyncFileLogger::setup() {
+  int ec = MM_STATUS_OK;
+  if (detail::FileCompress_Gzip == fileCompress_ && !compressor_.active()) {
+    ec = compressor_.setup(compressLevel_);
+    if (MM_STATUS_OK != ec) {
+      std::fprintf(stderr,
+          "Error: Failed to set up gzip compression of the log files, %s\n",
+          MM_STATUS_ENOMEM == ec ? "out of memory" : "built without zlib");
+      return ec;
+    }
+  }
+
+  ec = file_.open();
+  if (MM_STATUS_OK != ec) {
+    return ec;
+  }
+  (void)(maintainer_.start());
+
+  // the compressed batches do not fit the registered buffers
+  if (detail::FileWriter_Uring == fileWriter_ && !compressor_.active() &&
+      !setupUring()) {
+    std::fprintf(stderr,
+        "Warning: io_uring is unavailable, writing log files with "
+        "pwritev\n");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // the registered buffers, if any
+    for (BufferPtr* buffer : {&current_, &next_}) {
+      if (mappedWrites_) {
+        break;
+      }
+      if (!spares_.empty()) {
+        *buffer = std::move(spares_.back());
+        spares_.pop_back();
+      } else {
+        *buffer = newBuffer();
+      }
+    }
+    if (!mappedWrites_ && (!current_ || !next_)) {
+      return MM_STATUS_ENOMEM;
+    }
+    running_    = true;
+    windowWake_ = mappedWrites_;  // the first window
+  }
+
+  try {
+    writer_ = std::thread(mappedWrites_ ? &AsyncFileLogger::mappedWriterThread
+                                        : &AsyncFileLogger::writerThread,
+        this);
+  } catch (const std::system_error& e) {
+    std::fprintf(stderr, "Failed to start the log writer thread: %s\n",
+        e.what());
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    return MM_STATUS_ERROR;
+  }
+
+  return ec;
+}
+
+int AsyncFileLogger::teardown() {
+  maintainer_.stop();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_one();
+
+  if (writer_.joinable()) {
+    writer_.join();
+  } else if (mappedWrites_ ? 0 > file_.fd() : !current_) {
+    // never set up, or torn down already
+    return MM_STATUS_OK;
+  }
+
+  if (mappedWrites_) {
+    std::vector<detail::LogFileWindow> windows;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      file_.close();
+      file_.takeWindows(windows);
+    }
+    (void)(file_.releaseWindows(windows));
+  } else {
+    // Write what was appended after the writer's last swap
+    std::vector<BufferPtr> remaining;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      remaining.swap(buffers_);
+      if (current_ && current_->size() > 0) {
+        remaining.push_back(std::move(current_));
+      }
+      current_.reset();
+      next_.reset();
+    }
+    writeBuffers(remaining);
+    drainWrites();
+    uring_.close();
+    uringActive_ = false;
+    spares_.clear();
+    file_.close();
+  }
+
+  LoggerStats stats;
+  getStats(stats);
+  std::fprintf(stderr,
+      "AsyncFileLogger stats - Enqueued: %lu, Processed: %lu, Dropped: %lu\n",
+      static_cast<unsigned long>(stats.enqueued),
+      static_cast<unsigned long>(stats.processed),
+      static_cast<unsigned long>(stats.dropped));
+  if (compressor_.active()) {
+    std::fprintf(stderr, "AsyncFileLogger compressed %lu bytes to %lu\n",
+        static_cast<unsigned long>(compressor_.bytesIn()),
+        static_cast<unsigned long>(compressor_.bytesOut()));
+  }
+  return MM_STATUS_OK;
+}
+
+void AsyncFileLogger::logVerbose(const char* msg, const std::size_t len) {
+  append(msg, len, false);
+}
+
+void AsyncFileLogger::logDebug(const char* msg, const std::size_t len) {
+  append(msg, len, false);
+}
+
+void AsyncFileLogger::logInfo(const char* msg, const std::size_t len) {
+  append(msg, len, false);
+}
+
+void AsyncFileLogger::logWarn(const char* msg, const std::size_t len) {
+  append(msg, len, false);
+}
+
+void AsyncFileLogger::logError(const char* msg, const std::size_t len) {
+  append(msg, len, false);
+}
+
+void AsyncFileLogger::logFatal(const char* msg, const std::size_t len) {
+  // the process may be about to die, do not wait for the flush interval
+  append(msg, len, true);
+}
+
+int AsyncFileLogger::getStats(LoggerStats& stats) const {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.enqueued += enqueued_;
+    stats.dropped += dropped_;
+  }
+  stats.processed += processed_.load(std::memory_order_relaxed);
+
+  writeLatency_.addTo(stats.write);
+
+  return MM_STATUS_OK;
+}
+
+void AsyncFileLogger::append(
+    const char* msg, std::size_t len, const bool urgent) {
+  if (mappedWrites_) {
+    appendMapped(msg, len, urgent);
+    return;
+  }
+
+  // Keep room for the newline, a message never spans two buffers
+  len       = std::min(len, bufferSize_ - 1);
+  bool wake = urgent;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!current_ || !current_->append(msg, len)) {
+      if (!current_ || buffers_.size() >= maxBuffers_) {
+        // the writer is maxBuffers_ behind, or not running
+        ++dropped_;
+        return;
+      }
+
+      buffers_.push_back(std::move(current_));
+      current_ = next_ ? std::move(next_) : newBuffer();
+      if (!current_) {
+        ++dropped_;
+        cv_.notify_one();
+        return;
+      }
+
+      current_->append(msg, len);
+      wake = true;
+    }
+    ++enqueued_;
+  }
+
+  if (wake) {
+    cv_.notify_one();
+  }
+}
+
+void AsyncFileLogger::appendMapped(
+    const char* msg, const std::size_t len, const bool urgent) {
+  bool wake = urgent;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // the clock is read only for the sparse time index
+    const int64_t wallNs =
+        file_.indexDue()
+            ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::system_clock::now().time_since_epoch())
+                  .count()
+            : 0;
+    if (MM_STATUS_OK != file_.appendLine(msg, len, wallNs)) {
+      // not set up, or the disk is full
+      ++dropped_;
+      return;
+    }
+    ++enqueued_;
+    processed_.fetch_add(1, std::memory_order_relaxed);
+
+    if (!windowWake_ && file_.windowNeeded()) {
+      windowWake_ = true;
+      wake        = true;
+    }
+  }
+
+  if (wake) {
+    cv_.notify_one();
+  }
+}
+
+AsyncFileLogger::BufferPtr AsyncFileLogger::newBuffer() const noexcept {
+  char* data = new (std::nothrow) char[bufferSize_];
+  if (!data) {
+    return BufferPtr();
+  }
+
+  detail::LogFileBuffer* buffer =
+      new (std::nothrow) detail::LogFileBuffer(data, bufferSize_);
+  if (!buffer) {
+    delete[] data;
+  }
+
+  return BufferPtr(buffer);
+}
+
+bool AsyncFileLogger::setupUring() {
+  if (MM_STATUS_OK !=
+      uring_.setup(static_cast<unsigned>(uringDepth_), file_.fd())) {
+    return false;
+  }
+
+  // Enough for a full ring plus current_ and next_, none allocated later
+  // unless a burst outruns the disk
+  std::vector<struct iovec> iovecs;
+  for (std::size_t i = 0; i < uringDepth_ + MaxSpareBuffers; ++i) {
+    char* data = new (std::nothrow) char[bufferSize_];
+    if (!data) {
+      break;
+    }
+    detail::LogFileBuffer* buffer = new (std::nothrow)
+        detail::LogFileBuffer(data, bufferSize_, static_cast<int>(i));
+    if (!buffer) {
+      delete[] data;
+      break;
+    }
+
+    spares_.emplace_back(buffer);
+    iovecs.push_back({data, bufferSize_});
+  }
+
+  const unsigned count = static_cast<unsigned>(iovecs.size());
+  if (MM_STATUS_OK != uring_.registerBuffers(iovecs.data(), count)) {
+    // still written through the ring, copied by the kernel instead of pinned
+    std::fprintf(stderr,
+        "Warning: Failed to register %lu log buffers with io_uring: %s\n",
+        static_cast<unsigned long>(count), std::strerror(errno));
+  }
+
+  writes_.resize(uringDepth_);
+  uringFd_     = file_.fd();
+  uringActive_ = true;
+  return true;
+}
+
+void AsyncFileLogger::writerThread() {
+  (void)(pthread_setname_np(pthread_self(), "mmlog-file"));
+
+  std::vector<BufferPtr> toWrite;
+  bool running = true;
+
+  while (running) {
+    // Allocate outside the lock what the swap below hands to the producers
+    while (spares_.size() < MaxSpareBuffers) {
+      BufferPtr buffer = newBuffer();
+      if (!buffer) {
+        break;
+      }
+      spares_.push_back(std::move(buffer));
+    }
+
+    reapWrites(0);
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (running_ && buffers_.empty()) {
+        if (uring_.inFlight() > 0) {
+          // completions do not signal cv_, wait for them in the kernel and
+          // start the flush interval over
+          lock.unlock();
+          reapWrites(1);
+          continue;
+        }
+        // a spurious wakeup only writes a partly filled buffer early
+        cv_.wait_for(lock, flushInterval_);
+      }
+      running = running_;
+
+      if (current_ && current_->size() > 0) {
+        buffers_.push_back(std::move(current_));
+      }
+      if (!current_ && !spares_.empty()) {
+        current_ = std::move(spares_.back());
+        spares_.pop_back();
+      }
+      if (!next_ && !spares_.empty()) {
+        next_ = std::move(spares_.back());
+        spares_.pop_back();
+      }
+      toWrite.swap(buffers_);
+    }
+
+    writeBuffers(toWrite);
+  }
+}
+
+void AsyncFileLogger::mappedWriterThread() {
+  (void)(pthread_setname_np(pthread_self(), "mmlog-file"));
+
+  std::vector<detail::LogFileWindow> windows;
+  bool running   = true;
+  bool mapFailed = false;
+
+  while (running) {
+    detail::LogFileMapRequest request = {-1, 0, 0, nullptr, false};
+    bool mapAhead                     = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (running_ && (mapFailed || !windowWake_)) {
+        // a failed mapping is retried once per flush interval
+        cv_.wait_for(lock, flushInterval_);
+      }
+      running     = running_;
+      windowWake_ = false;
+      mapAhead    = running && file_.requestWindow(request);
+      file_.takeWindows(windows);
+    }
+
+    if (mapAhead) {
+      mapFailed = MM_STATUS_OK != file_.mapWindowAhead(request);
+      if (!mapFailed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_.installWindow(request);
+      }
+      file_.finishRequest(request);
+    }
+
+    if (MM_STATUS_OK != file_.releaseWindows(windows) && !writeFailed_) {
+      const int ec = errno;
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::fprintf(stderr, "Error: Failed to sync log file %s: %s\n",
+          file_.path().c_str(), std::strerror(ec));
+      writeFailed_ = true;
+    }
+  }
+}
+
+void AsyncFileLogger::writeBuffers(std::vector<BufferPtr>& buffers) {
+  if (compressor_.active()) {
+    compressBuffers(buffers);
+  } else if (uringActive_) {
+    submitBuffers(buffers);
+  } else if (detail::FileWriter_Uring == fileWriter_) {
+    pwriteBuffers(buffers);
+  } else {
+    for (auto& buffer : buffers) {
+      const int64_t start = steadyNowNs();
+      const int ec        = file_.append(
+          buffer->data(), buffer->size(), buffer->firstNs());
+      writeDone(std::move(buffer), MM_STATUS_OK == ec, start);
+    }
+  }
+  buffers.clear();
+
+  if (detail::FileSync_None != fileSync_) {
+    // the io_uring writes have to land before they can be synced
+    drainWrites();
+    if (MM_STATUS_OK != file_.sync() && !writeFailed_) {
+      std::fprintf(stderr, "Error: Failed to sync log file %s: %s\n",
+          file_.path().c_str(), std::strerror(errno));
+      writeFailed_ = true;
+    }
+  }
+}
+
+void AsyncFileLogger::compressBuffers(std::vector<BufferPtr>& buffers) {
+  if (buffers.empty()) {
+    // no empty member every flush interval
+    return;
+  }
+
+  // one gzip member per batch, a crash loses at most the last one
+  const int64_t start = steadyNowNs();
+  compressor_.begin();
+  int ec = MM_STATUS_OK;
+  for (const auto& buffer : buffers) {
+    if (MM_STATUS_OK == ec) {
+      ec = compressor_.add(buffer->data(), buffer->size());
+    }
+  }
+  if (MM_STATUS_OK == ec) {
+    ec = compressor_.finish();
+  }
+  if (MM_STATUS_OK == ec) {
+    ec = file_.append(compressor_.data(), compressor_.size(),
+        buffers.front()->firstNs());
+  }
+
+  for (auto& buffer : buffers) {
+    writeDone(std::move(buffer), MM_STATUS_OK == ec, start);
+  }
+}
+
+void AsyncFileLogger::submitBuffers(std::vector<BufferPtr>& buffers) {
+  for (std::size_t i = 0; i < buffers.size(); ++i) {
+    BufferPtr& buffer = buffers[i];
+    if (file_.wouldRoll(buffer->size())) {
+      // the old segment is closed by the roll
+      drainWrites();
+    }
+
+    const int64_t start = steadyNowNs();
+    int fd              = -1;
+    off_t offset        = 0;
+    if (MM_STATUS_OK !=
+        file_.reserve(buffer->size(), fd, offset, buffer->firstNs())) {
+      writeDone(std::move(buffer), false, start);
+      continue;
+    }
+
+    if (fd != uringFd_) {
+      if (MM_STATUS_OK != uring_.updateFile(fd)) {
+        std::fprintf(stderr,
+            "Warning: Failed to register log file %s with io_uring, "
+            "writing it with pwritev\n",
+            file_.path().c_str());
+        stopUring(buffers, i, fd, offset, start);
+        return;
+      }
+      uringFd_ = fd;
+    }
+
+    if (uring_.inFlight() >= writes_.size()) {
+      reapWrites(1);
+    }
+
+    std::size_t slot = 0;
+    while (slot < writes_.size() && writes_[slot].buffer) {
+      ++slot;
+    }
+    if (writes_.size() == slot) {
+      // io_uring_enter(2) fails, nothing completes to free a slot
+      std::fprintf(stderr,
+          "Warning: io_uring writes of log file %s do not complete, "
+          "writing it with pwritev\n",
+          file_.path().c_str());
+      stopUring(buffers, i, fd, offset, start);
+      return;
+    }
+    // the ring has a slot, at least as many entries as writes_
+    (void)(uring_.prepareWrite(
+        buffer->data(), buffer->size(), offset, buffer->index(), slot));
+    writes_[slot] = {std::move(buffer), fd, offset, start};
+  }
+
+  if (MM_STATUS_OK != uring_.submit()) {
+    // the prepared writes stay queued, submitted with the next ones
+    std::fprintf(stderr, "Error: Failed to submit log writes: %s\n",
+        std::strerror(errno));
+  }
+  reapWrites(0);
+}
+
+void AsyncFileLogger::stopUring(std::vector<BufferPtr>& buffers,
+    std::size_t first, const int fd, const off_t offset,
+    const int64_t startNs) {
+  uring_.close();
+  uringActive_ = false;
+
+  // the same bytes at the same offsets, should the kernel have written some
+  for (InFlightWrite& write : writes_) {
+    if (write.buffer) {
+      struct iovec iov = {
+          const_cast<char*>(write.buffer->data()), write.buffer->size()};
+      const bool ok = writeFully(write.fd, write.offset, &iov, 1);
+      writeDone(std::move(write.buffer), ok, write.startNs);
+    }
+  }
+
+  struct iovec iov = {
+      const_cast<char*>(buffers[first]->data()), buffers[first]->size()};
+  const bool ok = writeFully(fd, offset, &iov, 1);
+  writeDone(std::move(buffers[first]), ok, startNs);
+
+  std::vector<BufferPtr> rest;
+  for (++first; first < buffers.size(); ++first) {
+    rest.push_back(std::move(buffers[first]));
+  }
+  pwriteBuffers(rest);
+}
+
+void AsyncFileLogger::pwriteBuffers(std::vector<BufferPtr>& buffers) {
+  std::vector<struct iovec> iovecs;
+  std::size_t first = 0;
+  while (first < buffers.size()) {
+    const int64_t start = steadyNowNs();
+    int fd              = -1;
+    off_t offset        = 0;
+
+    const detail::LogFileBuffer& head = *buffers[first];
+    if (MM_STATUS_OK !=
+        file_.reserve(head.size(), fd, offset, head.firstNs())) {
+      writeDone(std::move(buffers[first++]), false, start);
+      continue;
+    }
+
+    // the buffers following the first one in the same segment
+    iovecs.clear();
+    iovecs.push_back(
+        {const_cast<char*>(buffers[first]->data()), buffers[first]->size()});
+    std::size_t last = first + 1;
+    while (last < buffers.size() && iovecs.size() < IOV_MAX &&
+           !file_.wouldRoll(buffers[last]->size())) {
+      int nextFd;
+      off_t nextOffset;
+      (void)(file_.reserve(buffers[last]->size(), nextFd, nextOffset,
+          buffers[last]->firstNs()));
+      iovecs.push_back(
+          {const_cast<char*>(buffers[last]->data()), buffers[last]->size()});
+      ++last;
+    }
+
+    const bool ok = writeFully(
+        fd, offset, iovecs.data(), static_cast<int>(iovecs.size()));
+    for (; first < last; ++first) {
+      writeDone(std::move(buffers[first]), ok, start);
+    }
+  }
+}
+
+void AsyncFileLogger::reapWrites(const unsigned waitFor) {
+  if (!uringActive_ || 0 == uring_.inFlight()) {
+    return;
+  }
+
+  if (waitFor > 0) {
+    (void)(uring_.submit(waitFor));
+  }
+
+  uring_.reap([this](const std::uint64_t slot, const std::int32_t result) {
+    InFlightWrite& write = writes_[slot];
+    bool ok              = 0 <= result;
+    if (!ok) {
+      errno = -result;
+    } else if (static_cast<std::size_t>(result) < write.buffer->size()) {
+      // short write, the disk may be full
+      const std::size_t done = static_cast<std::size_t>(result);
+      struct iovec iov       = {
+          const_cast<char*>(write.buffer->data()) + done,
+          write.buffer->size() - done};
+      ok = writeFully(write.fd, write.offset + result, &iov, 1);
+    }
+    writeDone(std::move(write.buffer), ok, write.startNs);
+  });
+}
+
+void AsyncFileLogger::drainWrites() {
+  while (uringActive_ && uring_.inFlight() > 0) {
+    const unsigned inFlight = uring_.inFlight();
+    reapWrites(inFlight);
+    if (uring_.inFlight() == inFlight) {
+      // io_uring_enter(2) fails, nothing more will complete
+      break;
+    }
+  }
+}
+
+void AsyncFileLogger::writeDone(
+    BufferPtr buffer, const bool ok, const int64_t startNs) {
+  const int64_t end = steadyNowNs();
+  writeLatency_.record(
+      end > startNs ? static_cast<uint64_t>(end - startNs) : 0);
+
+  if (ok) {
+    processed_ += buffer->count();
+    writeFailed_ = false;
+  } else if (!writeFailed_) {
+    // report once per run of failures, the disk is likely full
+    std::fprintf(stderr, "Error: Failed to write log file %s: %s\n",
+        file_.path().c_str(), std::strerror(errno));
+    writeFailed_ = true;
+  }
+
+  // the registered buffers are never freed, they are few
+  buffer->reset();
+  if (0 <= buffer->index() || spares_.size() < MaxSpareBuffers) {
+    spares_.push_back(std::move(buffer));
+  }
+}
+
+}  // namespace mm
@@ -0,0 +1,102 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "LatencyHistogram.hpp"
+
+namespace mm {
+
+std::uint64_t LatencySnapshot::percentile(const double percent) const
+    noexcept {
+  if (0 == count_) {
+    return 0;
+  }
+
+  const double clamped = (percent < 0.0) ? 0.0
+                         : (percent > 100.0) ? 100.0
+                                             : percent;
+  std::uint64_t rank =
+      static_cast<std::uint64_t>(clamped / 100.0 * count_ + 0.5);
+  if (0 == rank) {
+    rank = 1;
+  }
+
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      const std::uint64_t upper = detail::latencyBucketUpperBound(i);
+      return (upper < max_) ? upper : max_;
+    }
+  }
+
+  return max_;
+}
+
+void LatencySnapshot::merge(const LatencySnapshot& other) {
+  if (0 == other.count_) {
+    return;
+  }
+
+  if (counts_.empty()) {
+    counts_.assign(detail::LatencyBucketCount, 0);
+  }
+
+  for (std::size_t i = 0; i < other.counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  max_ = (other.max_ > max_) ? other.max_ : max_;
+}
+
+namespace detail {
+
+LatencyHistogram::LatencyHistogram() noexcept : sum_(0), max_(0) {
+  for (std::atomic<std::uint64_t>& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::addTo(LatencySnapshot& snapshot) const {
+  if (snapshot.counts_.empty()) {
+    snapshot.counts_.assign(LatencyBucketCount, 0);
+  }
+
+  // the total is derived from the buckets, so percentiles stay consistent
+  // with the count even while samples are being recorded
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < LatencyBucketCount; ++i) {
+    const std::uint64_t n = counts_[i].load(std::memory_order_relaxed);
+    snapshot.counts_[i] += n;
+    total += n;
+  }
+
+  const std::uint64_t max = max_.load(std::memory_order_relaxed);
+  snapshot.count_ += total;
+  snapshot.sum_ += sum_.load(std::memory_order_relaxed);
+  snapshot.max_ = (max > snapshot.max_) ? max : snapshot.max_;
+}
+
+}  // namespace detail
+
+}  // namespace mm
@@ -34,30 +34,36 @@
 #include <vector>
 #include <map>
 
+#include "LogFormatter.hpp"
 #include "LoggerStatus.hpp"
 
 namespace mm {
 
 namespace detail {
 
-enum { LogStackBufferSize = 2048 };
 enum { LogTimeBufferSize = 64 };
 
 static detail::LogCallback gLogCb     = nullptr;
+static void* gLogCtx                  = nullptr;
 static detail::LogLevelCfg gLogLvlCfg = detail::LogLevelCfg_NoLog;
 static LogSinkType gLogSinkType       = LogSinkType_None;
-
-void setupLogger(
-    LogCallback&& cb, const LogLevelCfg cfg, const LogSinkType stype) noexcept {
-  gLogCb       = std::move(cb);
-  gLogLvlCfg   = cfg;
-  gLogSinkType = stype;
+static bool gLogTimestamp             = false;
+
+void setupLogger(const LogCallback cb, void* ctx, const LogLevelCfg cfg,
+    const LogSinkType stype, const bool timestamp) noexcept {
+  gLogCb        = cb;
+  gLogCtx       = ctx;
+  gLogLvlCfg    = cfg;
+  gLogSinkType  = stype;
+  gLogTimestamp = timestamp;
 }
 
 void teardownLogger() noexcept {
-  gLogLvlCfg   = detail::LogLevelCfg_NoLog;
-  gLogSinkType = detail::LogSinkType_None;
-  gLogCb       = nullptr;
+  gLogLvlCfg    = detail::LogLevelCfg_NoLog;
+  gLogSinkType  = detail::LogSinkType_None;
+  gLogTimestamp = false;
+  gLogCb        = nullptr;
+  gLogCtx       = nullptr;
 }
 
 static inline const char* getLogLvlString(const detail::LogLevel lvl) {
@@ -96,162 +102,29 @@ static inline const char* getLogLvlString(const detail::LogLevel lvl) {
   return ret;
 }
 
-void outputLog(const detail::LogLevel lvl, const char* const filename,
-    const char* const funcname, const int line, const char* const fmt,
-    ...) noexcept {
-  char buf[detail::LogStackBufferSize];
-  int n      = 0;
-  int offset = 0;
-  int len    = detail::LogStackBufferSize;
-
-  bool checked = false;
-  if (detail::LogSinkType_Stdout == gLogSinkType) {
-    if (gLogLvlCfg & lvl) {
-      checked = true;
-      /* append timestamp. */
-      struct timeval tv;
-      char timebuf[LogTimeBufferSize];
-
-      ::gettimeofday(&tv, NULL);
-      ::strftime(timebuf, sizeof(timebuf) - 1, "%Y-%m-%d %H:%M:%S",
-          localtime(&tv.tv_sec));
-
-      n = std::snprintf(buf + offset, static_cast<std::size_t>(len),
-          "%s.%03d %05ld", timebuf, (int)(tv.tv_usec / 1000),
-          static_cast<long int>(gettid()));
-
-      if (0 > n) {
-        /* there is an error occurred std::snprintf(). */
-        return;
-      }
-
-      if (n >= len) {
-        /* truncated already, do ouput.*/
-        if (gLogCb) {
-          gLogCb(lvl, buf, detail::LogStackBufferSize);
-        }
-
-        return;
-      }
-
-      offset += n;
-      len -= n;
-    }
-  } else {
-    checked = true;
+bool isLogEnabled(const detail::LogLevel lvl) noexcept {
+  // glog based sinks filter by themselves
+  if ((detail::LogSinkType_Stdout == gLogSinkType) ||
+      (detail::LogSinkType_AsyncFile == gLogSinkType) ||
+      (detail::LogSinkType_Router == gLogSinkType)) {
+    return 0 != (gLogLvlCfg & lvl);
   }
 
-  if (checked) {
-    /* append log postion. */
-    const char* lvlStr = getLogLvlString(lvl);
-
-    /**
-     * Extract the main strings of the filename and function name, i.e.
-     *                        MNode::bindNode()
-     *           DeviceManager::DeviceManager()
-     * YolactObjectDetect::YolactObjectDet...()
-     */
-    const int filenameLenMax = 18;
-    const int funcnameLenMax = 18;
-
-    char body[filenameLenMax + 2 + funcnameLenMax + 2 + 1] = {0};
-
-    // remove the suffix, such as ".cpp"
-    char agent[filenameLenMax * 2 + 1] = {0};
-    strncpy(agent, filename, filenameLenMax * 2);
-    char* pFilename = strtok(agent, ".");
-    if (NULL == pFilename) pFilename = agent;
-
-    if ((strlen(pFilename) + strlen(funcname)) <=
-        (filenameLenMax + funcnameLenMax)) {
-      strcat(body, pFilename);
-      strcat(body, "::");
-      strcat(body, funcname);
-      strcat(body, "()");
-    } else {
-      int filenameLenCopied = filenameLenMax;
-      if (strlen(funcname) < funcnameLenMax) {
-        filenameLenCopied += funcnameLenMax - strlen(funcname);
-      }
-      strncpy(body, pFilename, filenameLenCopied);
-
-      strcat(body, "::");
-      int bodyLen = strlen(body);
-      strncpy(body + bodyLen, funcname,
-          filenameLenMax + 2 + funcnameLenMax - bodyLen);
-
-      if ((bodyLen + strlen(funcname)) >
-          (filenameLenMax + 2 + funcnameLenMax)) {
-        body[filenameLenMax + 2 + funcnameLenMax - 1] = '.';
-        body[filenameLenMax + 2 + funcnameLenMax - 2] = '.';
-        body[filenameLenMax + 2 + funcnameLenMax - 3] = '.';
-      }
-      strcat(body, "()");
-    }
-
-    n = std::snprintf(buf + offset, static_cast<std::size_t>(len),
-        " %40.40s %04d %c: ", body, line, lvlStr[0]);
-
-    if (0 > n) {
-      return;
-    }
-
-    if (n >= len) {
-      if (gLogCb) {
-        gLogCb(lvl, buf, detail::LogStackBufferSize);
-      }
-
-      return;
-    }
-
-    offset += n;
-    len -= n;
-
-    /* append format. */
-    va_list args;
-    va_start(args, fmt);
-    n = std::vsnprintf(buf + offset, static_cast<std::size_t>(len), fmt, args);
-    if (0 > n) {
-      return;
-    }
-
-    if (n >= len) {
-      if (gLogCb) {
-        gLogCb(lvl, buf, detail::LogStackBufferSize);
-      }
-
-      return;
-    }
-
-    offset += n;
-    len -= n;
-
-    va_end(args);
-
-    /* do final output. */
-    if (gLogCb) {
-      gLogCb(lvl, buf, offset + 1);
-    }
-  }
+  return true;
 }
 
-std::string convertOutputLogToStr(const detail::LogLevel lvl,
-    const char* const filename, const char* const funcname, const int line,
-    const char* const fmt, ...) noexcept {
-  char buf[detail::LogStackBufferSize];
-  int n      = 0;
-  int offset = 0;
-  int len    = detail::LogStackBufferSize;
-
-  /* append log postion. */
+/**
+ * Formats the call site part of the prefix, i.e. " <body> <line> <L>: ",
+ * with body the main strings of the filename and function name, i.e.
+ *                        MNode::bindNode()
+ *           DeviceManager::DeviceManager()
+ * YolactObjectDetect::YolactObjectDet...()
+ */
+int formatLogCallSite(char* buf, const std::size_t len,
+    const detail::LogLevel lvl, const char* const filename,
+    const char* const funcname, const int line) noexcept {
   const char* lvlStr = getLogLvlString(lvl);
 
-  /**
-   * Extract the main strings of the filename and function name, i.e.
-   *                        MNode::bindNode()
-   *           DeviceManager::DeviceManager()
-   * YolactObjectDetect::YolactObjectDet...()
-   */
   const int filenameLenMax = 18;
   const int funcnameLenMax = 18;
 
@@ -289,40 +162,124 @@ std::string convertOutputLogToStr(const detail::LogLevel lvl,
     strcat(body, "()");
   }
 
-  n = std::snprintf(buf + offset, static_cast<std::size_t>(len),
-      " %40.40s %04d %c: ", body, line, lvlStr[0]);
+  return detail::formatLogArgs(
+      buf, len, " %40.40s %04d %c: ", body, line, lvlStr[0]);
+}
+
+int formatLogTimestamp(char* buf, const std::size_t len) noexcept {
+  struct timeval tv;
+  char timebuf[LogTimeBufferSize];
+
+  ::gettimeofday(&tv, NULL);
+  ::strftime(timebuf, sizeof(timebuf) - 1, "%Y-%m-%d %H:%M:%S",
+      localtime(&tv.tv_sec));
 
+  return detail::formatLogArgs(buf, len, "%s.%03d %05ld", timebuf,
+      (int)(tv.tv_usec / 1000), static_cast<long int>(gettid()));
+}
+
+int formatLogPrefix(char* buf, const std::size_t len,
+    const detail::LogLevel lvl, const char* const filename,
+    const char* const funcname, const int line) noexcept {
+  int offset = 0;
+
+  if (gLogTimestamp) {
+    /* append timestamp. */
+    offset = formatLogTimestamp(buf, len);
+    if ((0 > offset) || (static_cast<std::size_t>(offset) >= len)) {
+      return offset;
+    }
+  }
+
+  /* append log postion. */
+  const int n = formatLogCallSite(buf + offset,
+      len - static_cast<std::size_t>(offset), lvl, filename, funcname, line);
   if (0 > n) {
-    return "";
+    return n;
   }
 
-  if (n >= len) {
-    std::string ret = buf;
-    return ret;
+  return offset + n;
+}
+
+void writeLog(const detail::LogLevel lvl, const char* const msg,
+    const std::size_t len) noexcept {
+  if (gLogCb) {
+    gLogCb(gLogCtx, lvl, msg, len);
+  }
+}
+
+void outputLog(const detail::LogLevel lvl, const char* const filename,
+    const char* const funcname, const int line, const char* const fmt,
+    ...) noexcept {
+  if (!isLogEnabled(lvl)) {
+    return;
+  }
+
+  char buf[detail::LogStackBufferSize];
+  const int offset = formatLogPrefix(
+      buf, detail::LogStackBufferSize, lvl, filename, funcname, line);
+
+  if (0 > offset) {
+    /* there is an error occurred formatting. */
+    return;
   }
 
-  offset += n;
-  len -= n;
+  if (offset >= detail::LogStackBufferSize) {
+    /* truncated already, do ouput.*/
+    writeLog(lvl, buf, detail::LogStackBufferSize - 1);
+    return;
+  }
 
   /* append format. */
+  const std::size_t len = detail::LogStackBufferSize - offset;
 
   va_list args;
   va_start(args, fmt);
-  n = std::vsnprintf(buf + offset, static_cast<std::size_t>(len), fmt, args);
+  const int n = detail::formatLog(buf + offset, len, fmt, args);
+  va_end(args);
 
   if (0 > n) {
+    return;
+  }
+
+  if (static_cast<std::size_t>(n) >= len) {
+    writeLog(lvl, buf, detail::LogStackBufferSize - 1);
+    return;
+  }
+
+  /* do final output. */
+  writeLog(lvl, buf, offset + n);
+}
+
+std::string convertOutputLogToStr(const detail::LogLevel lvl,
+    const char* const filename, const char* const funcname, const int line,
+    const char* const fmt, ...) noexcept {
+  char buf[detail::LogStackBufferSize];
+
+  /* append log postion. */
+  const int offset = formatLogCallSite(
+      buf, detail::LogStackBufferSize, lvl, filename, funcname, line);
+
+  if (0 > offset) {
     return "";
   }
 
-  if (n >= len) {
+  if (offset >= detail::LogStackBufferSize) {
     std::string ret = buf;
     return ret;
   }
 
-  offset += n;
-  len -= n;
+  /* append format. */
+  va_list args;
+  va_start(args, fmt);
+  const int n = detail::formatLog(
+      buf + offset, detail::LogStackBufferSize - offset, fmt, args);
   va_end(args);
 
+  if (0 > n) {
+    return "";
+  }
+
   std::string ret = buf;
   return ret;
 }
@@ -342,8 +299,10 @@ void usage(int ecode) noexcept {
       "  [--filepath]: set log output file path\n"
       "  [--help|-h|-?]: check cmdline parameters options\n"
       "  [--sim]: options for open simulation with path\n"
-      "  [--sinktype]=<Stdout|GLog|OptimizedGLog>: options for logging "
-      "protocol\n"
+      "  [--routes]=<sink:level>[,...]: child sinks of the Router sink, "
+      "i.e. Stdout:warn,OptimizedGLog:info\n"
+      "  [--sinktype]=<Stdout|GLog|OptimizedGLog|AsyncFile|Router>: options "
+      "for logging protocol\n"
       "  [--toFile]=<verbose|debug|info|warn|error|fatal>: log level\n"
       "  [--toTerm]=<verbose|debug|info|warn|error|fatal>: log level\n"
       "\n"
@@ -353,7 +312,82 @@ void usage(int ecode) noexcept {
       "  [--queueCapacity]=<number>: maximum queue size before dropping "
       "messages (default: 10000)\n"
       "  [--numWorkers]=<number>: number of worker threads (default: 2)\n"
-      "  [--poolSize]=<number>: size of the memory pool (default: 10000)\n");
+      "  [--minWorkers]=<number>: workers kept when idle (default: 1)\n"
+      "  [--maxWorkers]=<number>: upper bound of the worker pool "
+      "(default: 4)\n"
+      "  [--scaleUpWaitMs]=<number>: queue wait that adds a worker "
+      "(default: 20)\n"
+      "  [--workerIdleMs]=<number>: idle time after which a worker retires "
+      "(default: 5000)\n"
+      "  [--poolSize]=<number>: size of the memory pool (default: 10000)\n"
+      "  [--dedupWindowMs]=<number>: collapse identical messages within the "
+      "window into one line plus a repeat summary (default: 0, off)\n"
+      "  [--targetFlushLatencyMs]=<number>: tune batch size and wake "
+      "threshold online to flush within this latency (default: 0, off)\n"
+      "  [--numaAware]=<true|false>: one pool, queue and worker set per NUMA "
+      "node, queueCapacity and poolSize are split between the nodes "
+      "(default: false)\n"
+      "  [--waitStrategy]=<block|spin|busy>: how idle workers wait, block "
+      "parks them and wakes on threshold crossings, spin spins for "
+      "spinUs first, busy never parks (default: block)\n"
+      "  [--spinUs]=<number>: spin time of the spin strategy (default: 50)\n"
+      "  [--threadRings]=<off|rr|merge>: give every producing thread its own "
+      "ring, drained round robin or merged by enqueue time (default: off)\n"
+      "  [--ringKb]=<number>: size of each thread ring (default: 64)\n"
+      "  [--workerFiles]=<true|false>: every worker writes its own file "
+      "<appId>.w<n>, mmlog-merge joins them by enqueue time "
+      "(default: false)\n"
+      "  [--poolPrefault]=<true|false>: fault the pool memory in at startup "
+      "(default: false)\n"
+      "  [--poolLock]=<true|false>: mlock the pool memory (default: false)\n"
+      "  [--poolHugePages]=<none|thp|explicit>: back the pool with "
+      "transparent or reserved huge pages (default: none)\n"
+      "  [--workerCpus]=<list>: cores the workers run on, i.e. 0-3,6 "
+      "(default: any)\n"
+      "  [--workerName]=<name>: worker thread name prefix (default: mmlog)\n"
+      "  [--workerSched]=<normal|batch|idle>: worker scheduling policy "
+      "(default: normal)\n"
+      "  [--workerNice]=<number>: worker nice level, -20 to 19 "
+      "(default: 0, inherited)\n"
+      "  [--workerIoPrio]=<none|rt|be|idle>[:<0-7>]: worker I/O priority "
+      "class and level (default: none)\n"
+      "\n"
+      "  AsyncFile specific options:\n"
+      "  [--fileBufferKb]=<number>: size of each append buffer "
+      "(default: 4096)\n"
+      "  [--fileFlushMs]=<number>: longest time a partly filled buffer waits "
+      "for the writer (default: 1000)\n"
+      "  [--fileMaxBuffers]=<number>: filled buffers awaiting the writer "
+      "before messages are dropped (default: 16)\n"
+      "  [--fileRollMb]=<number>: segment size starting a new file "
+      "(default: 1024)\n"
+      "  [--fileWriter]=<write|uring|mmap>: write(2) per buffer, batched "
+      "io_uring writes falling back to pwritev, or copies into a mapped "
+      "window of the file (default: write)\n"
+      "  [--fileUringDepth]=<number>: io_uring writes in flight, 1 to 64 "
+      "(default: 4)\n"
+      "  [--fileMapMb]=<number>: window mapped at once by the mmap writer "
+      "(default: 16)\n"
+      "  [--fileSync]=<none|async|sync>: start, or wait for, the writeback "
+      "of every written batch (default: none)\n"
+      "  [--fileCompress]=<none|gzip>: write every batch as a gzip member, "
+      "readable with zcat, needs zlib (default: none)\n"
+      "  [--fileCompressLevel]=<number>: 1 (fastest) to 9 (smallest) "
+      "(default: 1)\n"
+      "  [--fileIndexKb]=<number>: write a time index entry every this many "
+      "KB to <segment>.idx for mmlog-query, 0 = off (default: 0)\n"
+      "\n"
+      "  Rotated file options (OptimizedGLog and AsyncFile):\n"
+      "  [--logCompressRotated]=<true|false>: gzip rotated files in the "
+      "background, needs zlib (default: false)\n"
+      "  [--logBloomIndex]=<true|false>: write a token Bloom filter of every "
+      "rotated file for mmlog-find (default: false)\n"
+      "  [--logMaxTotalMb]=<number>: remove the oldest rotated files once all "
+      "files exceed this size, 0 = unlimited (default: 0)\n"
+      "  [--logMaxAgeHours]=<number>: remove rotated files older than this, "
+      "0 = kept (default: 0)\n"
+      "  [--logMaintainSec]=<number>: pause between two passes of the "
+      "maintainer (default: 60)\n");
   exit(ecode);
 }
 
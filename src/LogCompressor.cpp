@@ -0,0 +1,155 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "LogCompressor.hpp"
+
+#include <cstring>
+#include <new>
+
+#include "LoggerStatus.hpp"
+
+#ifdef MM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mm {
+
+namespace detail {
+
+namespace {
+
+// Output reserved up front, grown when a batch does not compress
+constexpr std::size_t InitialOutputSize = 256 * 1024;
+
+}  // namespace
+
+LogCompressor::LogCompressor() noexcept
+    : stream_(nullptr),
+      out_(),
+      capacity_(0),
+      size_(0),
+      bytesIn_(0),
+      bytesOut_(0) {}
+
+#ifdef MM_HAVE_ZLIB
+
+LogCompressor::~LogCompressor() {
+  if (stream_) {
+    z_stream* stream = static_cast<z_stream*>(stream_);
+    (void)(deflateEnd(stream));
+    delete stream;
+  }
+}
+
+int LogCompressor::setup(const int level) noexcept {
+  z_stream* stream = new (std::nothrow) z_stream;
+  out_.reset(new (std::nothrow) char[InitialOutputSize]);
+  if (!stream || !out_) {
+    delete stream;
+    return MM_STATUS_ENOMEM;
+  }
+  capacity_ = InitialOutputSize;
+
+  std::memset(stream, 0, sizeof(*stream));
+  // 15 + 16: 32KB window with a gzip header and trailer instead of zlib's
+  if (Z_OK != deflateInit2(stream, level, Z_DEFLATED, 15 + 16, 8,
+                  Z_DEFAULT_STRATEGY)) {
+    delete stream;
+    return MM_STATUS_ENOMEM;
+  }
+
+  stream_ = stream;
+  return MM_STATUS_OK;
+}
+
+void LogCompressor::begin() noexcept {
+  (void)(deflateReset(static_cast<z_stream*>(stream_)));
+  size_ = 0;
+}
+
+int LogCompressor::add(const char* data, const std::size_t len) noexcept {
+  z_stream* stream = static_cast<z_stream*>(stream_);
+  stream->next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream->avail_in = static_cast<uInt>(len);
+  bytesIn_ += len;
+  return deflateAll(Z_NO_FLUSH);
+}
+
+int LogCompressor::finish() noexcept {
+  z_stream* stream = static_cast<z_stream*>(stream_);
+  stream->next_in  = nullptr;
+  stream->avail_in = 0;
+  const int ec     = deflateAll(Z_FINISH);
+  bytesOut_ += size_;
+  return ec;
+}
+
+int LogCompressor::deflateAll(const int flush) noexcept {
+  z_stream* stream = static_cast<z_stream*>(stream_);
+  for (;;) {
+    if (size_ == capacity_) {
+      char* out = new (std::nothrow) char[capacity_ * 2];
+      if (!out) {
+        return MM_STATUS_ENOMEM;
+      }
+      std::memcpy(out, out_.get(), size_);
+      out_.reset(out);
+      capacity_ *= 2;
+    }
+
+    stream->next_out  = reinterpret_cast<Bytef*>(out_.get() + size_);
+    stream->avail_out = static_cast<uInt>(capacity_ - size_);
+    const int ec      = deflate(stream, flush);
+    size_             = capacity_ - stream->avail_out;
+
+    if (Z_FINISH == flush ? Z_STREAM_END == ec
+                          : 0 == stream->avail_in && stream->avail_out > 0) {
+      return MM_STATUS_OK;
+    }
+    if (Z_OK != ec && Z_BUF_ERROR != ec) {
+      return MM_STATUS_ERROR;
+    }
+  }
+}
+
+#else  // MM_HAVE_ZLIB
+
+LogCompressor::~LogCompressor() {}
+
+int LogCompressor::setup(const int) noexcept { return MM_STATUS_ERROR; }
+
+void LogCompressor::begin() noexcept {}
+
+int LogCompressor::add(const char*, const std::size_t) noexcept {
+  return MM_STATUS_ERROR;
+}
+
+int LogCompressor::finish() noexcept { return MM_STATUS_ERROR; }
+
+int LogCompressor::deflateAll(const int) noexcept { return MM_STATUS_ERROR; }
+
+#endif  // MM_HAVE_ZLIB
+
+}  // namespace detail
+
+}  // namespace mm
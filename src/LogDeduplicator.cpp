@@ -0,0 +1,139 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "LogDeduplicator.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace mm {
+
+LogDeduplicator::LogDeduplicator(
+    const std::chrono::milliseconds window, const std::size_t numSlots)
+    : windowNs_(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(window).count()),
+      slotMask_(roundUpToPowerOfTwo(numSlots) - 1),
+      slots_(new Slot[slotMask_ + 1]),
+      nextFlushNs_(0),
+      suppressedCount_() {}
+
+std::size_t LogDeduplicator::roundUpToPowerOfTwo(const std::size_t n) noexcept {
+  // so that a mask picks the slot
+  std::size_t ret = 1;
+  while (ret < n) {
+    ret <<= 1;
+  }
+
+  return ret;
+}
+
+uint64_t LogDeduplicator::hashMessage(
+    const char* msg, const std::size_t len) noexcept {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (std::size_t i = 0; i < len && '\0' != msg[i]; ++i) {
+    hash ^= static_cast<unsigned char>(msg[i]);
+    hash *= 1099511628211ull;
+  }
+
+  // 0 marks an unused slot
+  return (0 == hash) ? 1 : hash;
+}
+
+int64_t LogDeduplicator::nowNs() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void LogDeduplicator::makeSummary(
+    Slot& slot, const int64_t now, Summary& summary) const noexcept {
+  int n = std::snprintf(summary.msg, sizeof(summary.msg),
+      "last message repeated %lu times in %ld ms:%s",
+      static_cast<unsigned long>(slot.repeats),
+      static_cast<long>((now - slot.windowStartNs) / 1000000), slot.sample);
+  if (0 > n) {
+    n = 0;
+  }
+
+  summary.level = slot.level;
+  summary.len =
+      std::min(static_cast<std::size_t>(n), sizeof(summary.msg) - 1);
+
+  // the run goes on in a fresh window
+  slot.repeats       = 0;
+  slot.windowStartNs = now;
+}
+
+bool LogDeduplicator::suppress(const detail::LogLevel level, const char* msg,
+    const std::size_t len, Summary& summary, bool& hasSummary) {
+  const uint64_t hash = hashMessage(msg, len);
+  const int64_t now   = nowNs();
+  Slot& slot          = slots_[hash & slotMask_];
+
+  hasSummary = false;
+
+  std::lock_guard<std::mutex> lock(slot.mutex);
+
+  if (hash == slot.hash) {
+    if (now - slot.windowStartNs < windowNs_) {
+      ++slot.repeats;
+      suppressedCount_.add();
+      return true;
+    }
+
+    if (0 != slot.repeats) {
+      // still flapping: report the finished window and count this one into
+      // the next, so a steady stream yields one summary per window
+      makeSummary(slot, now, summary);
+      hasSummary   = true;
+      slot.repeats = 1;
+      suppressedCount_.add();
+      return true;
+    }
+
+    // quiet for a whole window, log it normally again
+    slot.windowStartNs = now;
+    return false;
+  }
+
+  // a different message takes over the slot, close the old run first
+  if (0 != slot.repeats) {
+    makeSummary(slot, now, summary);
+    hasSummary = true;
+  }
+
+  const std::size_t sampleLen = std::min(len, sizeof(slot.sample) - 1);
+  std::memcpy(slot.sample, msg, sampleLen);
+  slot.sample[sampleLen] = '\0';
+
+  slot.hash          = hash;
+  slot.level         = level;
+  slot.windowStartNs = now;
+  slot.repeats       = 0;
+
+  return false;
+}
+
+}  // namespace mm
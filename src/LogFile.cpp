@@ -0,0 +1,552 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "LogFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "Log.hpp"
+#include "LogIndex.hpp"
+#include "LoggerStatus.hpp"
+
+namespace mm {
+
+namespace detail {
+
+namespace {
+
+inline std::size_t pageSize() noexcept {
+  static const std::size_t size =
+      static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+// Numbers the segments of the process, so that a segment rolled within the
+// same second as the previous one still gets a name of its own
+std::atomic<std::uint32_t> nextSegmentSeq(0);
+
+}  // namespace
+
+LogFile::LogFile(const std::string& dir, const std::string& baseName,
+    const LogFileConfig& config) noexcept
+    : dir_(dir),
+      baseName_(baseName),
+      suffix_(FileCompress_Gzip == config.compress ? ".log.gz" : ".log"),
+      rollSize_(config.rollMb * 1024 * 1024),
+      writer_(config.writer),
+      sync_(config.sync),
+      fd_(-1),
+      written_(0),
+      synced_(0),
+      path_(),
+      mapSize_(config.mapMb * 1024 * 1024),
+      map_(nullptr),
+      mapOffset_(0),
+      allocated_(0),
+      mapFailed_(false),
+      deferUnmap_(false),
+      nextMap_(nullptr),
+      nextMapOffset_(0),
+      segment_(0),
+      retired_(),
+      indexSize_(config.indexKb * 1024),
+      indexFd_(-1),
+      lastIndexed_(0),
+      indexFailed_(false) {
+  if (!dir_.empty() && dir_.back() != '/') {
+    dir_ += '/';
+  }
+  mapSize_ = std::max(mapSize_, pageSize());
+  mapSize_ = (mapSize_ + pageSize() - 1) & ~(pageSize() - 1);
+}
+
+LogFile::~LogFile() {
+  close();
+  (void)(releaseWindows(retired_));
+}
+
+int LogFile::open() noexcept {
+  if (!createAbsDirectory(dir_)) {
+    std::fprintf(
+        stderr, "Error: Failed to create log directory: %s\n", dir_.c_str());
+    return MM_STATUS_ENOENT;
+  }
+
+  return roll();
+}
+
+int LogFile::append(const char* data, const std::size_t len,
+    const int64_t wallNs) noexcept {
+  if (wouldRoll(len)) {
+    // keep writing the old segment if the new one can not be opened
+    (void)(roll());
+  }
+
+  if (0 > fd_) {
+    return MM_STATUS_ERROR;
+  }
+  index(wallNs);
+
+  return appendData(data, len);
+}
+
+int LogFile::appendLine(const char* msg, const std::size_t len,
+    const int64_t wallNs) noexcept {
+  if (wouldRoll(len + 1)) {
+    (void)(roll());
+  }
+
+  if (0 > fd_) {
+    return MM_STATUS_ERROR;
+  }
+  index(wallNs);
+
+  const int ec = appendData(msg, len);
+  return MM_STATUS_OK == ec ? appendData("\n", 1) : ec;
+}
+
+int LogFile::appendData(const char* data, const std::size_t len) noexcept {
+  if (FileWriter_Mmap == writer_) {
+    return appendMapped(data, len);
+  }
+
+  std::size_t done = 0;
+  while (done < len) {
+    const ssize_t n = ::write(fd_, data + done, len - done);
+    if (0 > n) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return MM_STATUS_ERROR;
+    }
+    done += static_cast<std::size_t>(n);
+  }
+  written_ += done;
+
+  return MM_STATUS_OK;
+}
+
+int LogFile::reserve(const std::size_t len, int& fd, off_t& offset,
+    const int64_t wallNs) noexcept {
+  if (wouldRoll(len)) {
+    (void)(roll());
+  }
+
+  if (0 > fd_) {
+    return MM_STATUS_ERROR;
+  }
+  index(wallNs);
+
+  fd       = fd_;
+  offset   = static_cast<off_t>(written_);
+  written_ += len;
+  return MM_STATUS_OK;
+}
+
+int LogFile::sync() noexcept {
+  if (FileSync_None == sync_ || 0 > fd_ || synced_ >= written_) {
+    return MM_STATUS_OK;
+  }
+
+  int ec = 0;
+  if (map_) {
+    // the windows unmapped since the last call were synced then
+    const std::size_t start =
+        std::max(synced_, mapOffset_) & ~(pageSize() - 1);
+    ec = ::msync(map_ + (start - mapOffset_), written_ - start,
+        FileSync_Sync == sync_ ? MS_SYNC : MS_ASYNC);
+  } else if (FileSync_Sync == sync_) {
+    ec = ::fdatasync(fd_);
+  } else {
+    ec = ::sync_file_range(fd_, static_cast<off_t>(synced_),
+        static_cast<off_t>(written_ - synced_), SYNC_FILE_RANGE_WRITE);
+  }
+  synced_ = written_;
+
+  return 0 == ec ? MM_STATUS_OK : MM_STATUS_ERROR;
+}
+
+void LogFile::close() noexcept {
+  if (0 > fd_) {
+    return;
+  }
+
+  if (!deferUnmap_ || !map_) {
+    (void)(sync());
+  }
+  if (FileWriter_Mmap == writer_) {
+    retireWindow();
+    if (nextMap_) {
+      // nothing written to it yet
+      ::munmap(nextMap_, mapSize_);
+      nextMap_ = nullptr;
+    }
+    if (allocated_ > written_) {
+      // drop the zeros past the data
+      (void)(::ftruncate(fd_, static_cast<off_t>(written_)));
+    }
+  }
+  ::close(fd_);
+  fd_ = -1;
+
+  if (0 <= indexFd_) {
+    ::close(indexFd_);
+    indexFd_ = -1;
+  }
+}
+
+int LogFile::appendMapped(const char* data, const std::size_t len) noexcept {
+  std::size_t done = 0;
+  while (done < len) {
+    if (!map_ || written_ >= mapOffset_ + mapSize_) {
+      if (mapFailed_ || MM_STATUS_OK != nextWindow()) {
+        break;
+      }
+    }
+
+    const std::size_t n =
+        std::min(len - done, mapOffset_ + mapSize_ - written_);
+    std::memcpy(map_ + (written_ - mapOffset_), data + done, n);
+    done += n;
+    written_ += n;
+  }
+
+  // no window, write the rest behind the mapped data
+  while (done < len) {
+    const ssize_t n = ::pwrite(
+        fd_, data + done, len - done, static_cast<off_t>(written_));
+    if (0 > n) {
+      if (EINTR == errno) {
+        continue;
+      }
+      return MM_STATUS_ERROR;
+    }
+    done += static_cast<std::size_t>(n);
+    written_ += static_cast<std::size_t>(n);
+    allocated_ = std::max(allocated_, written_);
+  }
+
+  return MM_STATUS_OK;
+}
+
+std::size_t LogFile::nextWindowOffset() const noexcept {
+  return map_ ? mapOffset_ + mapSize_ : written_ & ~(pageSize() - 1);
+}
+
+int LogFile::nextWindow() noexcept {
+  if (nextMap_ && nextWindowOffset() == nextMapOffset_) {
+    retireWindow();
+    map_       = nextMap_;
+    mapOffset_ = nextMapOffset_;
+    nextMap_   = nullptr;
+    return MM_STATUS_OK;
+  }
+
+  return mapWindow();
+}
+
+int LogFile::mapWindow() noexcept {
+  retireWindow();
+  if (nextMap_) {
+    // mapped for an offset the appends moved past
+    ::munmap(nextMap_, mapSize_);
+    nextMap_ = nullptr;
+  }
+
+  const std::size_t offset = written_ & ~(pageSize() - 1);
+  if (offset + mapSize_ > allocated_) {
+    // a page of a sparse file may fail to fault in with SIGBUS once the disk
+    // is full, allocated blocks can not
+    const int ec = ::fallocate(fd_, 0, static_cast<off_t>(allocated_),
+        static_cast<off_t>(offset + mapSize_ - allocated_));
+    if (0 != ec) {
+      std::fprintf(stderr,
+          "Warning: Failed to allocate log file %s, writing it with "
+          "pwrite: %s\n",
+          path_.c_str(), std::strerror(errno));
+      mapFailed_ = true;
+      return MM_STATUS_ERROR;
+    }
+    allocated_ = offset + mapSize_;
+  }
+
+  void* map = ::mmap(nullptr, mapSize_, PROT_READ | PROT_WRITE, MAP_SHARED,
+      fd_, static_cast<off_t>(offset));
+  if (MAP_FAILED == map) {
+    std::fprintf(stderr,
+        "Warning: Failed to map log file %s, writing it with pwrite: %s\n",
+        path_.c_str(), std::strerror(errno));
+    mapFailed_ = true;
+    return MM_STATUS_ERROR;
+  }
+
+  map_       = static_cast<char*>(map);
+  mapOffset_ = offset;
+  return MM_STATUS_OK;
+}
+
+bool LogFile::requestWindow(LogFileMapRequest& request) noexcept {
+  if (!windowNeeded()) {
+    return false;
+  }
+
+  // the segment may be rolled and closed while the window is mapped
+  const int fd = ::fcntl(fd_, F_DUPFD_CLOEXEC, 0);
+  if (0 > fd) {
+    return false;
+  }
+
+  request = {fd, nextWindowOffset(), segment_, nullptr, false};
+  return true;
+}
+
+int LogFile::mapWindowAhead(LogFileMapRequest& request) const noexcept {
+  // past the end of the file until installed, a closed segment keeps its
+  // size
+  if (0 != ::fallocate(request.fd, FALLOC_FL_KEEP_SIZE,
+               static_cast<off_t>(request.offset),
+               static_cast<off_t>(mapSize_))) {
+    return MM_STATUS_ERROR;
+  }
+
+  void* map = ::mmap(nullptr, mapSize_, PROT_READ | PROT_WRITE, MAP_SHARED,
+      request.fd, static_cast<off_t>(request.offset));
+  if (MAP_FAILED == map) {
+    return MM_STATUS_ERROR;
+  }
+
+  request.map = static_cast<char*>(map);
+  return MM_STATUS_OK;
+}
+
+void LogFile::installWindow(LogFileMapRequest& request) noexcept {
+  if (segment_ != request.segment || 0 > fd_) {
+    request.closed = true;
+    return;
+  }
+  if (!request.map || nextMap_ || nextWindowOffset() != request.offset) {
+    return;
+  }
+
+  // pages past the end of the file fault with SIGBUS
+  const std::size_t end = request.offset + mapSize_;
+  if (end > allocated_) {
+    if (0 != ::ftruncate(fd_, static_cast<off_t>(end))) {
+      return;
+    }
+    allocated_ = end;
+  }
+
+  nextMap_       = request.map;
+  nextMapOffset_ = request.offset;
+  request.map    = nullptr;
+}
+
+void LogFile::finishRequest(LogFileMapRequest& request) const noexcept {
+  if (request.map) {
+    ::munmap(request.map, mapSize_);
+    request.map = nullptr;
+  }
+
+  if (0 > request.fd) {
+    return;
+  }
+  struct stat st;
+  if (request.closed && 0 == ::fstat(request.fd, &st)) {
+    // free the blocks allocated past the end of the closed segment
+    (void)(::ftruncate(request.fd, st.st_size));
+  }
+  ::close(request.fd);
+  request.fd = -1;
+}
+
+void LogFile::takeWindows(std::vector<LogFileWindow>& windows) noexcept {
+  windows.insert(windows.end(), retired_.begin(), retired_.end());
+  retired_.clear();
+
+  if (FileSync_None == sync_ || 0 > fd_ || synced_ >= written_) {
+    return;
+  }
+  if (!map_) {
+    // written with pwrite(2), the mapping failed
+    (void)(sync());
+    return;
+  }
+  windows.push_back({map_, mapOffset_, std::max(synced_, mapOffset_),
+      std::min(written_, mapOffset_ + mapSize_), false});
+  synced_ = written_;
+}
+
+int LogFile::releaseWindows(
+    std::vector<LogFileWindow>& windows) const noexcept {
+  int ec = MM_STATUS_OK;
+  for (const LogFileWindow& window : windows) {
+    if (FileSync_None != sync_ && window.end > window.begin) {
+      const std::size_t start = window.begin & ~(pageSize() - 1);
+      if (0 != ::msync(window.map + (start - window.offset),
+                   window.end - start,
+                   FileSync_Sync == sync_ ? MS_SYNC : MS_ASYNC)) {
+        ec = MM_STATUS_ERROR;
+      }
+    }
+    if (window.retired) {
+      ::munmap(window.map, mapSize_);
+    }
+  }
+  windows.clear();
+
+  return ec;
+}
+
+void LogFile::index(const int64_t wallNs) noexcept {
+  if (0 == indexSize_ || 0 >= wallNs || indexFailed_ ||
+      (0 <= indexFd_ && written_ < lastIndexed_ + indexSize_)) {
+    return;
+  }
+
+  if (0 > indexFd_) {
+    const std::string path = path_ + LogIndexSuffix;
+    indexFd_ =
+        ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    bool ok = 0 <= indexFd_;
+    if (ok && 0 == ::lseek(indexFd_, 0, SEEK_END)) {
+      LogIndexHeader header = {};
+      std::memcpy(header.magic, LogIndexMagic, sizeof(header.magic));
+      header.version = LogIndexVersion;
+
+      ok = static_cast<ssize_t>(sizeof(header)) ==
+           ::write(indexFd_, &header, sizeof(header));
+    }
+    if (!ok) {
+      std::fprintf(stderr, "Warning: Failed to write log index %s: %s\n",
+          path.c_str(), std::strerror(errno));
+      indexFailed_ = true;
+      return;
+    }
+  }
+
+  const LogIndexEntry entry = {wallNs, static_cast<std::uint64_t>(written_)};
+  if (static_cast<ssize_t>(sizeof(entry)) !=
+      ::write(indexFd_, &entry, sizeof(entry))) {
+    // a torn entry would shift every later one
+    indexFailed_ = true;
+    return;
+  }
+  lastIndexed_ = written_;
+}
+
+void LogFile::unmapWindow() noexcept {
+  if (!map_) {
+    return;
+  }
+
+  if (FileSync_None != sync_ && synced_ < written_) {
+    const std::size_t start =
+        std::max(synced_, mapOffset_) & ~(pageSize() - 1);
+    const std::size_t end = std::min(written_, mapOffset_ + mapSize_);
+    if (end > start) {
+      (void)(::msync(map_ + (start - mapOffset_), end - start,
+          FileSync_Sync == sync_ ? MS_SYNC : MS_ASYNC));
+    }
+  }
+  ::munmap(map_, mapSize_);
+  map_ = nullptr;
+}
+
+void LogFile::retireWindow() noexcept {
+  if (!deferUnmap_ || !map_) {
+    unmapWindow();
+    return;
+  }
+
+  retired_.push_back({map_, mapOffset_, std::max(synced_, mapOffset_),
+      std::min(written_, mapOffset_ + mapSize_), true});
+  synced_ = std::max(synced_, std::min(written_, mapOffset_ + mapSize_));
+  map_    = nullptr;
+}
+
+int LogFile::roll() noexcept {
+  char stamp[32];
+  const time_t now = ::time(nullptr);
+  struct tm tm;
+  ::localtime_r(&now, &tm);
+  ::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+  // zero padded, the names of a process sort in the order it wrote them
+  char seq[16];
+  std::snprintf(seq, sizeof(seq), "%06u",
+      static_cast<unsigned>(nextSegmentSeq.fetch_add(1)));
+
+  const std::string name = baseName_ + "." + stamp + "." +
+                           std::to_string(::getpid()) + "." + seq + suffix_;
+
+  // positional writes ignore their offset on an O_APPEND file, and a
+  // shared mapping needs read access
+  int flags = O_WRONLY | O_CREAT | O_CLOEXEC | O_APPEND;
+  if (FileWriter_Uring == writer_) {
+    flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+  } else if (FileWriter_Mmap == writer_) {
+    flags = O_RDWR | O_CREAT | O_CLOEXEC;
+  }
+  const int fd = ::open((dir_ + name).c_str(), flags, 0644);
+  if (0 > fd) {
+    std::fprintf(stderr, "Error: Failed to open log file: %s%s\n",
+        dir_.c_str(), name.c_str());
+    return MM_STATUS_ERROR;
+  }
+
+  // start behind what an earlier process left in the file
+  const off_t end =
+      FileWriter_Write != writer_ ? ::lseek(fd, 0, SEEK_END) : 0;
+
+  close();
+  fd_        = fd;
+  written_   = end > 0 ? static_cast<std::size_t>(end) : 0;
+  synced_    = written_;
+  path_      = dir_ + name;
+  allocated_ = written_;
+  mapFailed_ = false;
+  ++segment_;
+
+  indexFailed_ = false;
+
+  // relative, so the directory can be moved as a whole
+  const std::string link = dir_ + baseName_ + suffix_;
+  ::unlink(link.c_str());
+  (void)(::symlink(name.c_str(), link.c_str()));
+
+  return MM_STATUS_OK;
+}
+
+}  // namespace detail
+
+}  // namespace mm
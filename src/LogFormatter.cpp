@@ -0,0 +1,529 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "LogFormatter.hpp"
+
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+namespace mm {
+
+namespace detail {
+
+namespace {
+
+enum { FormatCacheSize = 1024 };
+
+/**
+ * A format cached for a call site. Owns a copy of the text, which the
+ * literal runs of the compiled format point into.
+ */
+struct ParsedFormat {
+  const char* fmt;  // address the entry was cached for
+  const char* text;
+  std::size_t textLen;
+  CompiledFormat compiled;
+};
+
+std::atomic<const ParsedFormat*> gFormatCache[FormatCacheSize];
+
+inline std::size_t cacheIndex(const char* fmt) noexcept {
+  const std::uint64_t key = reinterpret_cast<std::uintptr_t>(fmt);
+  return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 54) %
+         FormatCacheSize;
+}
+
+/**
+ * Looks fmt up in the cache, parsing and publishing it on a miss. The text
+ * is compared as well, so a reused buffer address never hits a stale entry.
+ * Returns nullptr when the slot belongs to another format.
+ */
+const ParsedFormat* lookupFormat(const char* fmt) noexcept {
+  std::atomic<const ParsedFormat*>& slot = gFormatCache[cacheIndex(fmt)];
+
+  const ParsedFormat* cached = slot.load(std::memory_order_acquire);
+  if (cached) {
+    if ((cached->fmt == fmt) && (0 == std::strcmp(cached->text, fmt))) {
+      return cached;
+    }
+    return nullptr;
+  }
+
+  const std::size_t textLen = std::strlen(fmt);
+  char* text                = new (std::nothrow) char[textLen + 1];
+  ParsedFormat* parsed      = new (std::nothrow) ParsedFormat();
+  if (!text || !parsed) {
+    delete[] text;
+    delete parsed;
+    return nullptr;
+  }
+
+  std::memcpy(text, fmt, textLen + 1);
+  parsed->fmt     = fmt;
+  parsed->text    = text;
+  parsed->textLen  = textLen;
+  parsed->compiled = compileFormat(std::string_view(text, textLen));
+
+  // entries live as long as the process, as the call sites they describe
+  if (!slot.compare_exchange_strong(
+          cached, parsed, std::memory_order_acq_rel)) {
+    delete[] text;
+    delete parsed;
+    return ((cached->fmt == fmt) && (0 == std::strcmp(cached->text, fmt)))
+               ? cached
+               : nullptr;
+  }
+
+  return parsed;
+}
+
+// Lays out sign/prefix, zero padding and digits according to width and flags
+void emitNumber(FormatBuffer& out, const FormatSpec& spec, const char* prefix,
+    const std::size_t prefixLen, const char* digits,
+    const std::size_t digitsLen, const std::size_t zeros,
+    const bool zeroPad) noexcept {
+  const std::size_t body = prefixLen + zeros + digitsLen;
+  const std::size_t pad  = (spec.width > 0 && static_cast<std::size_t>(
+                                                    spec.width) > body)
+                               ? spec.width - body
+                               : 0;
+
+  if (spec.flags & FormatSpec::Flag_Left) {
+    out.append(prefix, prefixLen);
+    out.fill('0', zeros);
+    out.append(digits, digitsLen);
+    out.fill(' ', pad);
+  } else if (zeroPad) {
+    out.append(prefix, prefixLen);
+    out.fill('0', zeros + pad);
+    out.append(digits, digitsLen);
+  } else {
+    out.fill(' ', pad);
+    out.append(prefix, prefixLen);
+    out.fill('0', zeros);
+    out.append(digits, digitsLen);
+  }
+}
+
+void formatInteger(FormatBuffer& out, const FormatSpec& spec,
+    const unsigned long long magnitude, const bool negative) noexcept {
+  char digits[24];
+  char prefix[2];
+  std::size_t prefixLen = 0;
+  std::size_t digitsLen = 0;
+
+  const bool isSigned = ('d' == spec.conv) || ('i' == spec.conv);
+  if (isSigned) {
+    if (negative) {
+      prefix[prefixLen++] = '-';
+    } else if (spec.flags & FormatSpec::Flag_Plus) {
+      prefix[prefixLen++] = '+';
+    } else if (spec.flags & FormatSpec::Flag_Space) {
+      prefix[prefixLen++] = ' ';
+    }
+  }
+
+  // "%.0d" of zero prints nothing
+  if ((0 != magnitude) || (0 != spec.precision)) {
+    int base = 10;
+    if (('x' == spec.conv) || ('X' == spec.conv)) {
+      base = 16;
+    } else if ('o' == spec.conv) {
+      base = 8;
+    }
+
+    const auto res =
+        std::to_chars(digits, digits + sizeof(digits), magnitude, base);
+    digitsLen      = static_cast<std::size_t>(res.ptr - digits);
+
+    if ('X' == spec.conv) {
+      for (std::size_t i = 0; i < digitsLen; ++i) {
+        if (digits[i] >= 'a') {
+          digits[i] = static_cast<char>(digits[i] - 'a' + 'A');
+        }
+      }
+    }
+  }
+
+  std::size_t zeros = 0;
+  if (spec.flags & FormatSpec::Flag_Alt) {
+    if ((0 != magnitude) && (('x' == spec.conv) || ('X' == spec.conv))) {
+      prefix[prefixLen++] = '0';
+      prefix[prefixLen++] = spec.conv;
+    } else if (('o' == spec.conv) &&
+               ((0 == digitsLen) || ('0' != digits[0])) &&
+               (spec.precision <= static_cast<int>(digitsLen))) {
+      zeros = 1;
+    }
+  }
+
+  if (spec.precision > static_cast<int>(digitsLen)) {
+    zeros = spec.precision - digitsLen;
+  }
+
+  // '0' is ignored when a precision is given
+  const bool zeroPad =
+      (spec.flags & FormatSpec::Flag_Zero) && (spec.precision < 0);
+  emitNumber(out, spec, prefix, prefixLen, digits, digitsLen, zeros, zeroPad);
+}
+
+}  // namespace
+
+void FormatBuffer::append(const char* s, const std::size_t n) noexcept {
+  const std::size_t room = static_cast<std::size_t>(end_ - pos_);
+  const std::size_t copy = (n < room) ? n : room;
+  std::memcpy(pos_, s, copy);
+  pos_ += copy;
+  total_ += n;
+}
+
+void FormatBuffer::fill(const char c, const std::size_t n) noexcept {
+  const std::size_t room = static_cast<std::size_t>(end_ - pos_);
+  const std::size_t copy = (n < room) ? n : room;
+  std::memset(pos_, c, copy);
+  pos_ += copy;
+  total_ += n;
+}
+
+int FormatBuffer::finish() noexcept {
+  // snprintf(buf, 0, ...) writes nothing, not even the terminator
+  if (terminate_) {
+    *pos_ = '\0';
+  }
+  return static_cast<int>(total_);
+}
+
+void formatSigned(
+    FormatBuffer& out, const FormatSpec& spec, const long long value) noexcept {
+  const bool negative = value < 0;
+  const unsigned long long magnitude =
+      negative ? 0ull - static_cast<unsigned long long>(value)
+               : static_cast<unsigned long long>(value);
+  formatInteger(out, spec, magnitude, negative);
+}
+
+void formatUnsigned(FormatBuffer& out, const FormatSpec& spec,
+    const unsigned long long value) noexcept {
+  formatInteger(out, spec, value, false);
+}
+
+void formatDouble(
+    FormatBuffer& out, const FormatSpec& spec, const double value) noexcept {
+  char digits[320 + MaxFloatPrecision + 16];
+  char prefix[1];
+  std::size_t prefixLen = 0;
+
+  const int precision = (spec.precision < 0) ? 6 : spec.precision;
+  const double magnitude = std::signbit(value) ? -value : value;
+
+  if (std::signbit(value)) {
+    prefix[prefixLen++] = '-';
+  } else if (spec.flags & FormatSpec::Flag_Plus) {
+    prefix[prefixLen++] = '+';
+  } else if (spec.flags & FormatSpec::Flag_Space) {
+    prefix[prefixLen++] = ' ';
+  }
+
+  std::chars_format format = std::chars_format::fixed;
+  if ('e' == spec.conv) {
+    format = std::chars_format::scientific;
+  } else if ('g' == spec.conv) {
+    format = std::chars_format::general;
+  }
+
+  // printf's %g treats precision 0 as 1
+  const int effective =
+      (std::chars_format::general == format && 0 == precision) ? 1 : precision;
+  const auto res = std::to_chars(
+      digits, digits + sizeof(digits), magnitude, format, effective);
+  std::size_t digitsLen = static_cast<std::size_t>(res.ptr - digits);
+
+  if ('F' == spec.conv) {
+    for (std::size_t i = 0; i < digitsLen; ++i) {
+      if (digits[i] >= 'a' && digits[i] <= 'z') {
+        digits[i] = static_cast<char>(digits[i] - 'a' + 'A');
+      }
+    }
+  }
+
+  // "%#.0f" keeps the decimal point
+  if ((spec.flags & FormatSpec::Flag_Alt) && (0 == precision) &&
+      std::isfinite(value) && ('f' == spec.conv || 'F' == spec.conv)) {
+    digits[digitsLen++] = '.';
+  }
+
+  const bool zeroPad =
+      (spec.flags & FormatSpec::Flag_Zero) && std::isfinite(value);
+  emitNumber(out, spec, prefix, prefixLen, digits, digitsLen, 0, zeroPad);
+}
+
+void formatString(FormatBuffer& out, const FormatSpec& spec, const char* value,
+    const std::size_t len) noexcept {
+  std::size_t n = len;
+  if ((spec.precision >= 0) && (static_cast<std::size_t>(spec.precision) < n)) {
+    n = spec.precision;
+  }
+
+  const std::size_t pad =
+      (spec.width > 0 && static_cast<std::size_t>(spec.width) > n)
+          ? spec.width - n
+          : 0;
+
+  if (spec.flags & FormatSpec::Flag_Left) {
+    out.append(value, n);
+    out.fill(' ', pad);
+  } else {
+    out.fill(' ', pad);
+    out.append(value, n);
+  }
+}
+
+void formatString(
+    FormatBuffer& out, const FormatSpec& spec, const char* value) noexcept {
+  if (!value) {
+    // glibc prints "(null)", unless the precision cuts it
+    if ((spec.precision >= 0) && (spec.precision < 6)) {
+      formatString(out, spec, "", 0);
+    } else {
+      formatString(out, spec, "(null)", 6);
+    }
+    return;
+  }
+
+  const std::size_t len = (spec.precision >= 0)
+                              ? ::strnlen(value, spec.precision)
+                              : std::strlen(value);
+  formatString(out, spec, value, len);
+}
+
+void formatPointer(
+    FormatBuffer& out, const FormatSpec& spec, const void* value) noexcept {
+  if (!value) {
+    FormatSpec nil = spec;
+    nil.precision  = -1;
+    formatString(out, nil, "(nil)", 5);
+    return;
+  }
+
+  char digits[2 + 16];
+  digits[0]      = '0';
+  digits[1]      = 'x';
+  const auto res = std::to_chars(digits + 2, digits + sizeof(digits),
+      reinterpret_cast<std::uintptr_t>(value), 16);
+
+  FormatSpec str = spec;
+  str.precision  = -1;
+  formatString(out, str, digits, static_cast<std::size_t>(res.ptr - digits));
+}
+
+void formatChar(
+    FormatBuffer& out, const FormatSpec& spec, const int value) noexcept {
+  const char c   = static_cast<char>(value);
+  FormatSpec str = spec;
+  str.precision  = -1;
+  formatString(out, str, &c, 1);
+}
+
+int formatLog(char* buf, const std::size_t len, const char* fmt,
+    va_list args) noexcept {
+  if (!fmt) {
+    return -1;
+  }
+
+  CompiledFormat local;
+  const CompiledFormat* compiled = nullptr;
+  const char* text               = fmt;
+
+  const ParsedFormat* parsed = lookupFormat(fmt);
+  if (parsed) {
+    compiled = &parsed->compiled;
+    text     = parsed->text;
+  } else {
+    // the cache slot belongs to another call site, parse on the stack
+    local    = compileFormat(fmt);
+    compiled = &local;
+  }
+
+  if (!compiled->supported) {
+    return std::vsnprintf(buf, len, fmt, args);
+  }
+
+  FormatBuffer out(buf, len);
+  for (std::size_t i = 0; i < compiled->count; ++i) {
+    const FormatSegment& seg = compiled->segments[i];
+    const FormatSpec& spec   = seg.spec;
+
+    out.append(text + seg.literalOffset, seg.literalLen);
+
+    switch (spec.conv) {
+      case '%': out.append("%", 1); break;
+      case 'd':
+      case 'i': {
+        long long value = 0;
+        switch (spec.length) {
+          case FormatSpec::Length_hh:
+            value = static_cast<signed char>(va_arg(args, int));
+            break;
+          case FormatSpec::Length_h:
+            value = static_cast<short>(va_arg(args, int));
+            break;
+          case FormatSpec::Length_l: value = va_arg(args, long); break;
+          case FormatSpec::Length_ll: value = va_arg(args, long long); break;
+          case FormatSpec::Length_z: value = va_arg(args, ssize_t); break;
+          case FormatSpec::Length_j: value = va_arg(args, intmax_t); break;
+          case FormatSpec::Length_t: value = va_arg(args, ptrdiff_t); break;
+          default: value = va_arg(args, int); break;
+        }
+        formatSigned(out, spec, value);
+        break;
+      }
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o': {
+        unsigned long long value = 0;
+        switch (spec.length) {
+          case FormatSpec::Length_hh:
+            value = static_cast<unsigned char>(va_arg(args, unsigned int));
+            break;
+          case FormatSpec::Length_h:
+            value = static_cast<unsigned short>(va_arg(args, unsigned int));
+            break;
+          case FormatSpec::Length_l: value = va_arg(args, unsigned long); break;
+          case FormatSpec::Length_ll:
+            value = va_arg(args, unsigned long long);
+            break;
+          case FormatSpec::Length_z: value = va_arg(args, size_t); break;
+          case FormatSpec::Length_j: value = va_arg(args, uintmax_t); break;
+          case FormatSpec::Length_t:
+            value = static_cast<std::size_t>(va_arg(args, ptrdiff_t));
+            break;
+          default: value = va_arg(args, unsigned int); break;
+        }
+        formatUnsigned(out, spec, value);
+        break;
+      }
+      case 'f':
+      case 'F':
+      case 'e':
+      case 'g': formatDouble(out, spec, va_arg(args, double)); break;
+      case 's': formatString(out, spec, va_arg(args, const char*)); break;
+      case 'p': formatPointer(out, spec, va_arg(args, void*)); break;
+      case 'c': formatChar(out, spec, va_arg(args, int)); break;
+      default: break;
+    }
+  }
+
+  out.append(text + compiled->tailOffset, compiled->tailLen);
+  return out.finish();
+}
+
+int formatTyped(char* buf, const std::size_t len,
+    const CompiledFormat& compiled, const char* text,
+    const TypedArg* args) noexcept {
+  FormatBuffer out(buf, len);
+  const TypedArg* arg = args;
+
+  for (std::size_t i = 0; i < compiled.count; ++i) {
+    const FormatSegment& seg = compiled.segments[i];
+    const FormatSpec& spec   = seg.spec;
+
+    out.append(text + seg.literalOffset, seg.literalLen);
+
+    if ('%' == spec.conv) {
+      out.append("%", 1);
+      continue;
+    }
+
+    const TypedArg& cur = *arg++;
+    switch (spec.conv) {
+      case 'd':
+      case 'i':
+        if (TypedArg::Kind_Signed == cur.kind) {
+          formatSigned(out, spec, cur.value.i);
+        } else {
+          formatUnsigned(out, spec, cur.value.u);
+        }
+        break;
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+        if (TypedArg::Kind_Signed == cur.kind) {
+          // as printf: the bits of the argument's own width
+          const unsigned long long mask =
+              (cur.size >= sizeof(unsigned long long))
+                  ? ~0ull
+                  : (1ull << (cur.size * 8)) - 1;
+          formatUnsigned(
+              out, spec, static_cast<unsigned long long>(cur.value.i) & mask);
+        } else {
+          formatUnsigned(out, spec, cur.value.u);
+        }
+        break;
+      case 'c':
+        formatChar(out, spec,
+            static_cast<int>((TypedArg::Kind_Signed == cur.kind)
+                                 ? cur.value.i
+                                 : static_cast<long long>(cur.value.u)));
+        break;
+      case 'f':
+      case 'F':
+      case 'e':
+      case 'g': formatDouble(out, spec, cur.value.d); break;
+      case 's':
+        if (TypedArg::Kind_String == cur.kind) {
+          formatString(out, spec, cur.value.s.data, cur.value.s.len);
+        } else {
+          formatString(out, spec, cur.value.s.data);
+        }
+        break;
+      case 'p':
+        formatPointer(out, spec,
+            (TypedArg::Kind_CString == cur.kind) ? cur.value.s.data
+                                                 : cur.value.p);
+        break;
+      default: break;
+    }
+  }
+
+  out.append(text + compiled.tailOffset, compiled.tailLen);
+  return out.finish();
+}
+
+int formatLogArgs(
+    char* buf, const std::size_t len, const char* fmt, ...) noexcept {
+  va_list args;
+  va_start(args, fmt);
+  const int n = formatLog(buf, len, fmt, args);
+  va_end(args);
+  return n;
+}
+
+}  // namespace detail
+
+}  // namespace mm
@@ -0,0 +1,508 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "LogMaintainer.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <set>
+#include <system_error>
+
+#include "LogBloom.hpp"
+#include "LogIndex.hpp"
+#include "LoggerStatus.hpp"
+#include "ThreadPriority.hpp"
+
+#ifdef MM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mm {
+
+namespace detail {
+
+namespace {
+
+// Lowest priority short of SCHED_IDLE, so a pass still ends on a busy host
+constexpr int MaintainerNice = 19;
+
+// Read and compressed at once, stop() is noticed between two chunks
+constexpr std::size_t CompressChunkSize = 256 * 1024;
+
+// Bloom filters start at a bit per two bytes of the segment, the most
+// tokens it can hold, and are halved until BloomMaxFill of their bits are
+// set, which leaves about 0.4% false positives
+constexpr std::uint64_t BloomMinBits = 1ull << 16;
+constexpr std::uint64_t BloomMaxBits = 1ull << 28;  // 32MB while building
+constexpr double BloomMaxFill        = 0.4;
+
+// Bytes of log per byte of a gzip segment, to size its filter
+constexpr std::uint64_t GzipRatio = 8;
+
+const char* const GzipSuffix = ".gz";
+const char* const TempSuffix = ".tmp";  // Left behind by an interrupted gzip
+
+bool endsWith(const std::string& name, const char* suffix) noexcept {
+  const std::size_t len = std::strlen(suffix);
+  return name.size() >= len &&
+         0 == name.compare(name.size() - len, len, suffix);
+}
+
+// Files that describe a segment rather than being one
+bool isSidecar(const std::string& name) noexcept {
+  return endsWith(name, TempSuffix) || endsWith(name, LogIndexSuffix) ||
+         endsWith(name, LogBloomSuffix);
+}
+
+#ifdef MM_HAVE_ZLIB
+// Segments are read through zlib, which passes plain files through as is
+using SegmentFile = gzFile;
+
+SegmentFile openSegment(const std::string& path) noexcept {
+  return ::gzopen(path.c_str(), "rb");
+}
+
+ssize_t readSegment(SegmentFile file, char* buf, const std::size_t len) {
+  return ::gzread(file, buf, static_cast<unsigned>(len));
+}
+
+void closeSegment(SegmentFile file) noexcept { (void)(::gzclose(file)); }
+#else
+using SegmentFile = FILE*;
+
+SegmentFile openSegment(const std::string& path) noexcept {
+  return endsWith(path, GzipSuffix) ? nullptr : std::fopen(path.c_str(), "rb");
+}
+
+ssize_t readSegment(SegmentFile file, char* buf, const std::size_t len) {
+  const std::size_t n = std::fread(buf, 1, len, file);
+  return 0 == n && std::ferror(file) ? -1 : static_cast<ssize_t>(n);
+}
+
+void closeSegment(SegmentFile file) noexcept { (void)(std::fclose(file)); }
+#endif
+
+void lowerPriority() noexcept {
+  (void)(pthread_setname_np(pthread_self(), "mmlog-maint"));
+  setThreadPriority("mmlog-maint", MaintainerNice, WorkerIoClass_Idle, 0);
+}
+
+}  // namespace
+
+LogMaintainer::LogMaintainer(const std::string& dir,
+    const std::vector<std::string>& prefixes,
+    const LogMaintainConfig& config) noexcept
+    : dir_(dir),
+      prefixes_(prefixes),
+      config_(config),
+      running_(false),
+      thread_() {
+  if (!dir_.empty() && dir_.back() != '/') {
+    dir_ += '/';
+  }
+}
+
+LogMaintainer::~LogMaintainer() { stop(); }
+
+int LogMaintainer::start() noexcept {
+  if (!config_.compress && !config_.bloom && 0 == config_.maxTotalMb &&
+      0 == config_.maxAgeHours) {
+    return MM_STATUS_OK;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) {
+    return MM_STATUS_OK;
+  }
+
+  running_ = true;
+  try {
+    thread_ = std::thread(&LogMaintainer::maintainerThread, this);
+  } catch (const std::system_error& e) {
+    std::fprintf(stderr, "Failed to start the log maintainer thread: %s\n",
+        e.what());
+    running_ = false;
+    return MM_STATUS_ERROR;
+  }
+
+  return MM_STATUS_OK;
+}
+
+void LogMaintainer::stop() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_one();
+
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool LogMaintainer::stopping() const noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !running_;
+}
+
+void LogMaintainer::maintainerThread() {
+  lowerPriority();
+
+#ifndef MM_HAVE_ZLIB
+  if (config_.compress) {
+    std::fprintf(stderr,
+        "Warning: Rotated log files are not compressed, built without "
+        "zlib\n");
+  }
+#endif
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
+    lock.unlock();
+    maintain();
+    lock.lock();
+
+    cv_.wait_for(lock, std::chrono::seconds(config_.intervalSec),
+        [this] { return !running_; });
+  }
+}
+
+void LogMaintainer::maintain() {
+  std::vector<LogFileEntry> files = listFiles();
+  const time_t now                = ::time(nullptr);
+  const time_t maxAge = static_cast<time_t>(config_.maxAgeHours) * 3600;
+
+  // Expired files first, they are not worth compressing
+  std::uint64_t total = 0;
+  for (auto it = files.begin(); it != files.end();) {
+    if (!it->active && maxAge > 0 && now - it->mtime > maxAge &&
+        (0 == ::unlink((dir_ + it->name).c_str()) || ENOENT == errno)) {
+      it = files.erase(it);
+    } else {
+      total += it->size;
+      ++it;
+    }
+  }
+
+  // Filters before compression, plain segments are cheaper to read
+  if (config_.bloom) {
+    std::set<std::string> names;
+    for (const auto& file : files) {
+      names.insert(file.name);
+    }
+
+    std::vector<LogFileEntry> blooms;
+    for (const auto& file : files) {
+      if (stopping()) {
+        return;
+      }
+      LogFileEntry bloom;
+      if (!file.active && !isSidecar(file.name) &&
+          0 == names.count(logBloomPath(file.name)) &&
+          buildBloom(file, bloom)) {
+        total += bloom.size;
+        blooms.push_back(bloom);
+      }
+    }
+    files.insert(files.end(), blooms.begin(), blooms.end());
+  }
+
+#ifdef MM_HAVE_ZLIB
+  if (config_.compress) {
+    for (auto& file : files) {
+      if (stopping()) {
+        return;
+      }
+      const std::uint64_t size = file.size;
+      if (!file.active && !endsWith(file.name, GzipSuffix) &&
+          !isSidecar(file.name) && compressFile(file)) {
+        total = total - size + file.size;
+      }
+    }
+  }
+#endif
+
+  const std::uint64_t budget =
+      static_cast<std::uint64_t>(config_.maxTotalMb) * 1024 * 1024;
+  if (0 == budget || total <= budget) {
+    return;
+  }
+
+  // Oldest first, compressed files kept the age of their original
+  std::sort(files.begin(), files.end(),
+      [](const LogFileEntry& a, const LogFileEntry& b) {
+        return a.mtime < b.mtime;
+      });
+  for (const auto& file : files) {
+    if (total <= budget) {
+      break;
+    }
+    if (!file.active &&
+        (0 == ::unlink((dir_ + file.name).c_str()) || ENOENT == errno)) {
+      total -= file.size;
+    }
+  }
+
+  if (total > budget) {
+    std::fprintf(stderr,
+        "Warning: Log files in %s take %lu MB, the active ones alone exceed "
+        "the %lu MB budget\n",
+        dir_.c_str(), static_cast<unsigned long>(total / (1024 * 1024)),
+        static_cast<unsigned long>(config_.maxTotalMb));
+  }
+}
+
+std::vector<LogMaintainer::LogFileEntry> LogMaintainer::listFiles() const {
+  std::vector<LogFileEntry> files;
+  std::set<std::string> linked;
+
+  DIR* dir = ::opendir(dir_.c_str());
+  if (!dir) {
+    return files;
+  }
+
+  const time_t now = ::time(nullptr);
+  while (const struct dirent* entry = ::readdir(dir)) {
+    const std::string name = entry->d_name;
+    struct stat st;
+    if (0 != ::fstatat(::dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW)) {
+      continue;
+    }
+
+    if (S_ISLNK(st.st_mode)) {
+      // the sinks point their symlinks at the segments they write, glog's
+      // are named after the app rather than the prefixes
+      char target[PATH_MAX];
+      const ssize_t len = ::readlinkat(
+          ::dirfd(dir), entry->d_name, target, sizeof(target) - 1);
+      if (len > 0) {
+        target[len]            = '\0';
+        const char* const base = std::strrchr(target, '/');
+        linked.insert(base ? base + 1 : target);
+      }
+    } else if (S_ISREG(st.st_mode) &&
+               std::any_of(prefixes_.begin(), prefixes_.end(),
+                   [&name](const std::string& prefix) {
+                     return 0 == name.compare(0, prefix.size(), prefix);
+                   })) {
+      // a file written within an interval may belong to another process
+      const bool recent =
+          now - st.st_mtime < static_cast<time_t>(config_.intervalSec);
+      files.push_back({name, static_cast<std::uint64_t>(st.st_size),
+          st.st_mtime, recent});
+    }
+  }
+  ::closedir(dir);
+
+  for (auto& file : files) {
+    file.active = file.active || linked.count(file.name) > 0;
+  }
+  return files;
+}
+
+bool LogMaintainer::buildBloom(
+    const LogFileEntry& entry, LogFileEntry& bloom) {
+  const std::string path = dir_ + entry.name;
+  bloom.name             = logBloomPath(entry.name);
+  const std::string temp = dir_ + bloom.name + TempSuffix;
+
+  SegmentFile in = openSegment(path);
+  if (!in) {
+    return false;
+  }
+
+  const std::uint64_t bytes =
+      entry.size * (endsWith(entry.name, GzipSuffix) ? GzipRatio : 1);
+  std::unique_ptr<LogBloomFilter> filter;
+  std::unique_ptr<char[]> chunk(new (std::nothrow) char[CompressChunkSize]);
+  try {
+    filter.reset(new LogBloomFilter(
+        std::min(BloomMaxBits, std::max(BloomMinBits, bytes / 2))));
+  } catch (const std::bad_alloc&) {
+    // retried on the next pass
+  }
+
+  // Lines cut by the end of a chunk are carried over to the next one
+  std::string carry;
+  std::uint64_t tokens = 0;
+  const auto addLine   = [&](const char* line, const std::size_t len) {
+    const std::size_t start = logTokenStart(line, len);
+    forEachLogToken(line + start, len - start,
+        [&](const char* token, const std::size_t tokenLen) {
+          filter->add(logTokenHash(token, tokenLen));
+          ++tokens;
+        });
+  };
+
+  bool ok = chunk && filter;
+  while (ok) {
+    if (stopping()) {
+      ok = false;
+      break;
+    }
+
+    const ssize_t n = readSegment(in, chunk.get(), CompressChunkSize);
+    if (0 >= n) {
+      ok = 0 == n;
+      break;
+    }
+
+    const char* data = chunk.get();
+    const char* end  = data + n;
+    while (data < end) {
+      const char* newline = static_cast<const char*>(
+          std::memchr(data, '\n', static_cast<std::size_t>(end - data)));
+      if (!newline) {
+        carry.append(data, static_cast<std::size_t>(end - data));
+        break;
+      }
+      if (carry.empty()) {
+        addLine(data, static_cast<std::size_t>(newline - data));
+      } else {
+        carry.append(data, static_cast<std::size_t>(newline - data));
+        addLine(carry.data(), carry.size());
+        carry.clear();
+      }
+      data = newline + 1;
+    }
+  }
+  closeSegment(in);
+
+  if (!ok) {
+    return false;
+  }
+  addLine(carry.data(), carry.size());
+  filter->shrink(BloomMaxFill);
+
+  LogBloomHeader header;
+  std::memcpy(header.magic, LogBloomMagic, sizeof(header.magic));
+  header.version = LogBloomVersion;
+  header.hashes  = LogBloomHashes;
+  header.bits    = filter->bits();
+  header.tokens  = tokens;
+
+  FILE* out = std::fopen(temp.c_str(), "wb");
+  if (!out) {
+    return false;
+  }
+  const std::vector<std::uint64_t>& words = filter->words();
+  ok = 1 == std::fwrite(&header, sizeof(header), 1, out) &&
+       words.size() == std::fwrite(words.data(), sizeof(words[0]),
+                           words.size(), out);
+  ok = 0 == std::fclose(out) && ok;
+
+  // same age as the segment, so the retention removes them together
+  const struct timespec times[2] = {{0, UTIME_OMIT}, {entry.mtime, 0}};
+  if (!ok || 0 != ::utimensat(AT_FDCWD, temp.c_str(), times, 0) ||
+      0 != ::rename(temp.c_str(), (dir_ + bloom.name).c_str())) {
+    ::unlink(temp.c_str());
+    return false;
+  }
+
+  bloom.size   = sizeof(header) + words.size() * sizeof(words[0]);
+  bloom.mtime  = entry.mtime;
+  bloom.active = false;
+  return true;
+}
+
+#ifdef MM_HAVE_ZLIB
+
+bool LogMaintainer::compressFile(LogFileEntry& entry) {
+  const std::string path   = dir_ + entry.name;
+  const std::string target = path + GzipSuffix;
+  const std::string temp   = target + TempSuffix;
+
+  const int in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (0 > in) {
+    return false;
+  }
+
+  gzFile out = ::gzopen(temp.c_str(), "wb6");
+  if (!out) {
+    ::close(in);
+    return false;
+  }
+
+  std::unique_ptr<char[]> chunk(new (std::nothrow) char[CompressChunkSize]);
+  bool ok = static_cast<bool>(chunk);
+  while (ok) {
+    if (stopping()) {
+      ok = false;
+      break;
+    }
+
+    const ssize_t n = ::read(in, chunk.get(), CompressChunkSize);
+    if (0 == n) {
+      break;
+    }
+    if (0 > n) {
+      ok = EINTR == errno;
+      continue;
+    }
+    ok = ::gzwrite(out, chunk.get(), static_cast<unsigned>(n)) == n;
+  }
+  ::close(in);
+  ok = Z_OK == ::gzclose(out) && ok;
+
+  struct stat st;
+  if (ok && 0 == ::stat(temp.c_str(), &st)) {
+    // keep the age of the original for the retention
+    const struct timespec times[2] = {{0, UTIME_OMIT}, {entry.mtime, 0}};
+    (void)(::utimensat(AT_FDCWD, temp.c_str(), times, 0));
+    ok = 0 == ::rename(temp.c_str(), target.c_str());
+  } else {
+    ok = false;
+  }
+
+  if (!ok) {
+    ::unlink(temp.c_str());
+    return false;
+  }
+
+  ::unlink(path.c_str());
+  // the offsets of its time index are those of the uncompressed segment
+  ::unlink((path + LogIndexSuffix).c_str());
+  entry.name += GzipSuffix;
+  entry.size = static_cast<std::uint64_t>(st.st_size);
+  return true;
+}
+
+#else  // MM_HAVE_ZLIB
+
+bool LogMaintainer::compressFile(LogFileEntry&) { return false; }
+
+#endif  // MM_HAVE_ZLIB
+
+}  // namespace detail
+
+}  // namespace mm
@@ -23,9 +23,11 @@
 
 #include "LoggerFactory.hpp"
 
+#include "AsyncFileLogger.hpp"
 #include "GlogLogger.hpp"
 #include "StdoutLogger.hpp"
 #include "OptimizedGlogLogger.hpp"
+#include "RouterLogger.hpp"
 
 namespace mm {
 
@@ -51,10 +53,44 @@ ILogger* LoggerFactory::createLogger(const LogConfig& config) {
       logger = new (std::nothrow) OptimizedGlogLogger(config.appId_,
           config.logLevelToStderr_, config.logLevelToFile_, config.logToFile_,
           config.logFilePath_, config.logDebugSwitch_, config.logToConsole_,
-          config.optimizationConfig_.batchSize,
-          config.optimizationConfig_.queueCapacity,
-          config.optimizationConfig_.numWorkers,
-          config.optimizationConfig_.poolSize);
+          config.optimizationConfig_, config.maintainConfig_);
+      break;
+    }
+    case detail::LogSinkType::LogSinkType_AsyncFile: {
+      logger = new (std::nothrow) AsyncFileLogger(config.appId_,
+          config.logFilePath_, config.fileConfig_, config.maintainConfig_);
+      break;
+    }
+    case detail::LogSinkType::LogSinkType_Router: {
+      RouterLogger* router = new (std::nothrow) RouterLogger();
+      if (!router) {
+        break;
+      }
+
+      // Each child is a regular sink built from a copy of the configuration,
+      // narrowed to its own sink type and level
+      for (const auto& route : config.routes_) {
+        LogConfig childConfig         = config;
+        childConfig.logSinkType_      = route.sinkType_;
+        childConfig.logLevelToStderr_ = route.level_;
+        childConfig.routes_.clear();
+        if (detail::LogSinkType::LogSinkType_Stdout == route.sinkType_) {
+          // a stdout route is an explicit request for console output
+          childConfig.logToConsole_ = true;
+        }
+
+        ILogger* child = createLogger(childConfig);
+        if (!child) {
+          delete router;
+          router = nullptr;
+          break;
+        }
+
+        router->addRoute(child, detail::convertLogLevelToCfg(route.level_),
+            detail::LogSinkType::LogSinkType_Stdout == route.sinkType_);
+      }
+
+      logger = router;
       break;
     }
     default: break;
@@ -24,11 +24,18 @@
 #include "LoggerManager.hpp"
 
 #include <unistd.h>
+#include <algorithm>
 #include <cstring>
 
+#include "AsyncFileLogger.hpp"
+#include "GlogLogger.hpp"
 #include "Log.hpp"
 #include "LoggerFactory.hpp"
 #include "LoggerStatus.hpp"
+#include "NumaTopology.hpp"
+#include "OptimizedGlogLogger.hpp"
+#include "RouterLogger.hpp"
+#include "StdoutLogger.hpp"
 
 namespace mm {
 
@@ -95,13 +102,49 @@ int LoggerManager::setup(int argc, char* argv[]) noexcept {
   return ec;
 }
 
+namespace {
+
+// Installs dispatchLog<Logger> when logger is a Logger
+template <typename Logger>
+bool selectDispatch(ILogger* logger, detail::LogCallback& cb,
+    void*& ctx) noexcept {
+  Logger* concrete = dynamic_cast<Logger*>(logger);
+  if (!concrete) {
+    return false;
+  }
+
+  cb  = &detail::dispatchLog<Logger>;
+  ctx = concrete;
+  return true;
+}
+
+}  // namespace
+
 int LoggerManager::setupLogger() noexcept {
   detail::LogLevelCfg logLvlConfig = convertLogLevel();
-  detail::LogCallback logCallback  = std::bind(&LoggerManager::outputLog, this,
-      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+  detail::LogCallback logCallback  = nullptr;
+  void* logContext                 = nullptr;
+
+  if (logger_ &&
+      !selectDispatch<StdoutLogger>(logger_, logCallback, logContext) &&
+      !selectDispatch<GlogLogger>(logger_, logCallback, logContext) &&
+      !selectDispatch<OptimizedGlogLogger>(logger_, logCallback, logContext) &&
+      !selectDispatch<AsyncFileLogger>(logger_, logCallback, logContext) &&
+      !selectDispatch<RouterLogger>(logger_, logCallback, logContext)) {
+    logCallback = &detail::dispatchLog<ILogger>;
+    logContext  = logger_;
+  }
+
+  // Only console output and our own files carry our own timestamp, glog
+  // stamps by itself. The per worker files of OptimizedGLog bypass glog.
+  const bool logTimestamp =
+      hasSinkType(detail::LogSinkType_Stdout) ||
+      hasSinkType(detail::LogSinkType_AsyncFile) ||
+      (hasSinkType(detail::LogSinkType_OptimizedGLog) &&
+          config_.optimizationConfig_.workerFiles);
 
-  detail::setupLogger(
-      std::move(logCallback), logLvlConfig, config_.logSinkType_);
+  detail::setupLogger(logCallback, logContext, logLvlConfig,
+      config_.logSinkType_, logTimestamp);
 
   return MM_STATUS_OK;
 }
@@ -110,6 +153,9 @@ int LoggerManager::teardown() noexcept {
   int ec = MM_STATUS_OK;
 
   if (logger_) {
+    // the front end holds a raw pointer to the logger
+    detail::teardownLogger();
+
     // Comment because deconstruct will call teardown()
     // logger_->teardown();
     delete logger_;
@@ -124,6 +170,14 @@ int LoggerManager::teardown() noexcept {
   return ec;
 }
 
+int LoggerManager::getStats(LoggerStats& stats) const noexcept {
+  if (!logger_) {
+    return MM_STATUS_ENOENT;
+  }
+
+  return logger_->getStats(stats);
+}
+
 // Update parseCmdLineFlags method in LoggerManager.cpp to support OptimizedGLog
 
 int LoggerManager::parseCmdLineFlags(int argc, char* argv[]) noexcept {
@@ -155,17 +209,15 @@ int LoggerManager::parseCmdLineFlags(int argc, char* argv[]) noexcept {
       }
 
       const char* sinktype = strchr(arg, '=') + 1;
-
-      if (strcmp(sinktype, "GLog") == 0) {
-        config_.logSinkType_ = detail::LogSinkType::LogSinkType_GLog;
-      } else if (strcmp(sinktype, "Stdout") == 0) {
-        config_.logSinkType_ = detail::LogSinkType::LogSinkType_Stdout;
-      } else if (strcmp(sinktype, "OptimizedGLog") == 0) {
-        config_.logSinkType_ = detail::LogSinkType::LogSinkType_OptimizedGLog;
-      } else {
-        fprintf(stderr, "sinktype value %s is invalid!\n", sinktype);
+      config_.logSinkType_ = transCmdSinkToSinkType(sinktype);
+    } else if (strstr(arg, "--routes=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--routes=\" requires a sink:level list\n");
         usage(1);
       }
+
+      const char* routes = strchr(arg, '=') + 1;
+      parseCmdRoutes(routes);
     } else if (strstr(arg, "--console=") == arg) {
       if (*(strchr(arg, '=') + 1) == '\0') {
         fprintf(stderr, "\"--console=\" requires a true/false value\n");
@@ -205,6 +257,38 @@ int LoggerManager::parseCmdLineFlags(int argc, char* argv[]) noexcept {
       const char* numWorkers = strchr(arg, '=') + 1;
       config_.optimizationConfig_.numWorkers =
           static_cast<size_t>(atoi(numWorkers));
+    } else if (strstr(arg, "--minWorkers=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--minWorkers=\" requires a number\n");
+        usage(1);
+      }
+      const char* minWorkers = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.minWorkers =
+          static_cast<size_t>(atoi(minWorkers));
+    } else if (strstr(arg, "--maxWorkers=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--maxWorkers=\" requires a number\n");
+        usage(1);
+      }
+      const char* maxWorkers = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.maxWorkers =
+          static_cast<size_t>(atoi(maxWorkers));
+    } else if (strstr(arg, "--scaleUpWaitMs=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--scaleUpWaitMs=\" requires a number\n");
+        usage(1);
+      }
+      const char* scaleUpWaitMs = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.scaleUpWaitMs =
+          static_cast<size_t>(atoi(scaleUpWaitMs));
+    } else if (strstr(arg, "--workerIdleMs=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--workerIdleMs=\" requires a number\n");
+        usage(1);
+      }
+      const char* workerIdleMs = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.workerIdleMs =
+          static_cast<size_t>(atoi(workerIdleMs));
     } else if (strstr(arg, "--poolSize=") == arg) {
       if (*(strchr(arg, '=') + 1) == '\0') {
         fprintf(stderr, "\"--poolSize=\" requires a number\n");
@@ -213,6 +297,352 @@ int LoggerManager::parseCmdLineFlags(int argc, char* argv[]) noexcept {
       const char* poolSize = strchr(arg, '=') + 1;
       config_.optimizationConfig_.poolSize =
           static_cast<size_t>(atoi(poolSize));
+    } else if (strstr(arg, "--dedupWindowMs=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--dedupWindowMs=\" requires a number\n");
+        usage(1);
+      }
+      const char* dedupWindowMs = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.dedupWindowMs =
+          static_cast<size_t>(atoi(dedupWindowMs));
+    } else if (strstr(arg, "--targetFlushLatencyMs=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--targetFlushLatencyMs=\" requires a number\n");
+        usage(1);
+      }
+      const char* targetFlushLatencyMs = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.targetFlushLatencyMs =
+          static_cast<size_t>(atoi(targetFlushLatencyMs));
+    } else if (strstr(arg, "--numaAware=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--numaAware=\" requires a true/false value\n");
+        usage(1);
+      }
+      const char* numaAware = strchr(arg, '=') + 1;
+      if ((strcmp(numaAware, "true") == 0) ||
+          (strcmp(numaAware, "TRUE") == 0)) {
+        config_.optimizationConfig_.numaAware = true;
+      } else if ((strcmp(numaAware, "false") == 0) ||
+                 (strcmp(numaAware, "FALSE") == 0)) {
+        config_.optimizationConfig_.numaAware = false;
+      } else {
+        fprintf(stderr, "numaAware value %s is invalid!\n", numaAware);
+        usage(1);
+      }
+    } else if (strstr(arg, "--waitStrategy=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--waitStrategy=\" requires block|spin|busy\n");
+        usage(1);
+      }
+      const char* waitStrategy = strchr(arg, '=') + 1;
+      if (strcmp(waitStrategy, "block") == 0) {
+        config_.optimizationConfig_.waitStrategy = detail::WaitStrategy_Block;
+      } else if (strcmp(waitStrategy, "spin") == 0) {
+        config_.optimizationConfig_.waitStrategy =
+            detail::WaitStrategy_SpinThenPark;
+      } else if (strcmp(waitStrategy, "busy") == 0) {
+        config_.optimizationConfig_.waitStrategy =
+            detail::WaitStrategy_BusySpin;
+      } else {
+        fprintf(stderr, "waitStrategy value %s is invalid!\n", waitStrategy);
+        usage(1);
+      }
+    } else if (strstr(arg, "--spinUs=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--spinUs=\" requires a number\n");
+        usage(1);
+      }
+      const char* spinUs = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.spinUs = static_cast<size_t>(atoi(spinUs));
+    } else if (strstr(arg, "--threadRings=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--threadRings=\" requires off|rr|merge\n");
+        usage(1);
+      }
+      const char* threadRings = strchr(arg, '=') + 1;
+      if (strcmp(threadRings, "off") == 0) {
+        config_.optimizationConfig_.threadRings = detail::ThreadRingMode_Off;
+      } else if (strcmp(threadRings, "rr") == 0) {
+        config_.optimizationConfig_.threadRings =
+            detail::ThreadRingMode_RoundRobin;
+      } else if (strcmp(threadRings, "merge") == 0) {
+        config_.optimizationConfig_.threadRings = detail::ThreadRingMode_Merge;
+      } else {
+        fprintf(stderr, "threadRings value %s is invalid!\n", threadRings);
+        usage(1);
+      }
+    } else if (strstr(arg, "--ringKb=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--ringKb=\" requires a number\n");
+        usage(1);
+      }
+      const char* ringKb = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.ringKb = static_cast<size_t>(atoi(ringKb));
+    } else if (strstr(arg, "--workerFiles=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--workerFiles=\" requires a true/false value\n");
+        usage(1);
+      }
+      const char* workerFiles = strchr(arg, '=') + 1;
+      if ((strcmp(workerFiles, "true") == 0) ||
+          (strcmp(workerFiles, "TRUE") == 0)) {
+        config_.optimizationConfig_.workerFiles = true;
+      } else if ((strcmp(workerFiles, "false") == 0) ||
+                 (strcmp(workerFiles, "FALSE") == 0)) {
+        config_.optimizationConfig_.workerFiles = false;
+      } else {
+        fprintf(stderr, "workerFiles value %s is invalid!\n", workerFiles);
+        usage(1);
+      }
+    } else if (strstr(arg, "--poolPrefault=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--poolPrefault=\" requires a true/false value\n");
+        usage(1);
+      }
+      const char* poolPrefault = strchr(arg, '=') + 1;
+      if ((strcmp(poolPrefault, "true") == 0) ||
+          (strcmp(poolPrefault, "TRUE") == 0)) {
+        config_.optimizationConfig_.poolMemory.prefault = true;
+      } else if ((strcmp(poolPrefault, "false") == 0) ||
+                 (strcmp(poolPrefault, "FALSE") == 0)) {
+        config_.optimizationConfig_.poolMemory.prefault = false;
+      } else {
+        fprintf(stderr, "poolPrefault value %s is invalid!\n", poolPrefault);
+        usage(1);
+      }
+    } else if (strstr(arg, "--poolLock=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--poolLock=\" requires a true/false value\n");
+        usage(1);
+      }
+      const char* poolLock = strchr(arg, '=') + 1;
+      if ((strcmp(poolLock, "true") == 0) || (strcmp(poolLock, "TRUE") == 0)) {
+        config_.optimizationConfig_.poolMemory.lock = true;
+      } else if ((strcmp(poolLock, "false") == 0) ||
+                 (strcmp(poolLock, "FALSE") == 0)) {
+        config_.optimizationConfig_.poolMemory.lock = false;
+      } else {
+        fprintf(stderr, "poolLock value %s is invalid!\n", poolLock);
+        usage(1);
+      }
+    } else if (strstr(arg, "--poolHugePages=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--poolHugePages=\" requires none|thp|explicit\n");
+        usage(1);
+      }
+      const char* poolHugePages = strchr(arg, '=') + 1;
+      if (strcmp(poolHugePages, "none") == 0) {
+        config_.optimizationConfig_.poolMemory.hugePages =
+            detail::PoolHugePages_None;
+      } else if (strcmp(poolHugePages, "thp") == 0) {
+        config_.optimizationConfig_.poolMemory.hugePages =
+            detail::PoolHugePages_Transparent;
+      } else if (strcmp(poolHugePages, "explicit") == 0) {
+        config_.optimizationConfig_.poolMemory.hugePages =
+            detail::PoolHugePages_Explicit;
+      } else {
+        fprintf(stderr, "poolHugePages value %s is invalid!\n", poolHugePages);
+        usage(1);
+      }
+    } else if (strstr(arg, "--workerCpus=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--workerCpus=\" requires a cpu list\n");
+        usage(1);
+      }
+      const char* workerCpus = strchr(arg, '=') + 1;
+      parseCmdCpus(workerCpus);
+    } else if (strstr(arg, "--workerName=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--workerName=\" requires a name\n");
+        usage(1);
+      }
+      const char* workerName = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.workerThread.name = workerName;
+    } else if (strstr(arg, "--workerSched=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--workerSched=\" requires a policy\n");
+        usage(1);
+      }
+      const char* workerSched = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.workerThread.schedPolicy =
+          transCmdSchedToSchedPolicy(workerSched);
+    } else if (strstr(arg, "--workerNice=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--workerNice=\" requires a number\n");
+        usage(1);
+      }
+      const char* workerNice = strchr(arg, '=') + 1;
+      config_.optimizationConfig_.workerThread.nice = atoi(workerNice);
+    } else if (strstr(arg, "--workerIoPrio=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--workerIoPrio=\" requires a class[:level]\n");
+        usage(1);
+      }
+      const char* workerIoPrio = strchr(arg, '=') + 1;
+      parseCmdIoPrio(workerIoPrio);
+    } else if (strstr(arg, "--fileBufferKb=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileBufferKb=\" requires a number\n");
+        usage(1);
+      }
+      const char* fileBufferKb = strchr(arg, '=') + 1;
+      config_.fileConfig_.bufferKb = static_cast<size_t>(atoi(fileBufferKb));
+    } else if (strstr(arg, "--fileFlushMs=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileFlushMs=\" requires a number\n");
+        usage(1);
+      }
+      const char* fileFlushMs = strchr(arg, '=') + 1;
+      config_.fileConfig_.flushIntervalMs =
+          static_cast<size_t>(atoi(fileFlushMs));
+    } else if (strstr(arg, "--fileMaxBuffers=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileMaxBuffers=\" requires a number\n");
+        usage(1);
+      }
+      const char* fileMaxBuffers = strchr(arg, '=') + 1;
+      config_.fileConfig_.maxBuffers =
+          static_cast<size_t>(atoi(fileMaxBuffers));
+    } else if (strstr(arg, "--fileRollMb=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileRollMb=\" requires a number\n");
+        usage(1);
+      }
+      const char* fileRollMb = strchr(arg, '=') + 1;
+      config_.fileConfig_.rollMb = static_cast<size_t>(atoi(fileRollMb));
+    } else if (strstr(arg, "--fileWriter=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileWriter=\" requires write|uring|mmap\n");
+        usage(1);
+      }
+      const char* fileWriter = strchr(arg, '=') + 1;
+      if (strcmp(fileWriter, "write") == 0) {
+        config_.fileConfig_.writer = detail::FileWriter_Write;
+      } else if (strcmp(fileWriter, "uring") == 0) {
+        config_.fileConfig_.writer = detail::FileWriter_Uring;
+      } else if (strcmp(fileWriter, "mmap") == 0) {
+        config_.fileConfig_.writer = detail::FileWriter_Mmap;
+      } else {
+        fprintf(stderr, "fileWriter value %s is invalid!\n", fileWriter);
+        usage(1);
+      }
+    } else if (strstr(arg, "--fileUringDepth=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileUringDepth=\" requires a number\n");
+        usage(1);
+      }
+      const char* fileUringDepth = strchr(arg, '=') + 1;
+      config_.fileConfig_.uringDepth =
+          static_cast<size_t>(atoi(fileUringDepth));
+    } else if (strstr(arg, "--fileMapMb=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileMapMb=\" requires a number\n");
+        usage(1);
+      }
+      const char* fileMapMb = strchr(arg, '=') + 1;
+      config_.fileConfig_.mapMb = static_cast<size_t>(atoi(fileMapMb));
+    } else if (strstr(arg, "--fileCompress=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileCompress=\" requires none|gzip\n");
+        usage(1);
+      }
+      const char* fileCompress = strchr(arg, '=') + 1;
+      if (strcmp(fileCompress, "none") == 0) {
+        config_.fileConfig_.compress = detail::FileCompress_None;
+      } else if (strcmp(fileCompress, "gzip") == 0) {
+        config_.fileConfig_.compress = detail::FileCompress_Gzip;
+      } else {
+        fprintf(stderr, "fileCompress value %s is invalid!\n", fileCompress);
+        usage(1);
+      }
+    } else if (strstr(arg, "--fileCompressLevel=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileCompressLevel=\" requires a number\n");
+        usage(1);
+      }
+      const char* fileCompressLevel = strchr(arg, '=') + 1;
+      config_.fileConfig_.compressLevel = atoi(fileCompressLevel);
+    } else if (strstr(arg, "--fileIndexKb=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileIndexKb=\" requires a number\n");
+        usage(1);
+      }
+      const char* fileIndexKb = strchr(arg, '=') + 1;
+      config_.fileConfig_.indexKb = static_cast<size_t>(atoi(fileIndexKb));
+    } else if (strstr(arg, "--logCompressRotated=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr,
+            "\"--logCompressRotated=\" requires a true/false value\n");
+        usage(1);
+      }
+      const char* compressRotated = strchr(arg, '=') + 1;
+      if ((strcmp(compressRotated, "true") == 0) ||
+          (strcmp(compressRotated, "TRUE") == 0)) {
+        config_.maintainConfig_.compress = true;
+      } else if ((strcmp(compressRotated, "false") == 0) ||
+                 (strcmp(compressRotated, "FALSE") == 0)) {
+        config_.maintainConfig_.compress = false;
+      } else {
+        fprintf(stderr, "logCompressRotated value %s is invalid!\n",
+            compressRotated);
+        usage(1);
+      }
+    } else if (strstr(arg, "--logBloomIndex=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--logBloomIndex=\" requires a true/false value\n");
+        usage(1);
+      }
+      const char* bloomIndex = strchr(arg, '=') + 1;
+      if ((strcmp(bloomIndex, "true") == 0) ||
+          (strcmp(bloomIndex, "TRUE") == 0)) {
+        config_.maintainConfig_.bloom = true;
+      } else if ((strcmp(bloomIndex, "false") == 0) ||
+                 (strcmp(bloomIndex, "FALSE") == 0)) {
+        config_.maintainConfig_.bloom = false;
+      } else {
+        fprintf(stderr, "logBloomIndex value %s is invalid!\n", bloomIndex);
+        usage(1);
+      }
+    } else if (strstr(arg, "--logMaxTotalMb=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--logMaxTotalMb=\" requires a number\n");
+        usage(1);
+      }
+      const char* logMaxTotalMb = strchr(arg, '=') + 1;
+      config_.maintainConfig_.maxTotalMb =
+          static_cast<size_t>(atoll(logMaxTotalMb));
+    } else if (strstr(arg, "--logMaxAgeHours=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--logMaxAgeHours=\" requires a number\n");
+        usage(1);
+      }
+      const char* logMaxAgeHours = strchr(arg, '=') + 1;
+      config_.maintainConfig_.maxAgeHours =
+          static_cast<size_t>(atoi(logMaxAgeHours));
+    } else if (strstr(arg, "--logMaintainSec=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--logMaintainSec=\" requires a number\n");
+        usage(1);
+      }
+      const char* logMaintainSec = strchr(arg, '=') + 1;
+      config_.maintainConfig_.intervalSec =
+          static_cast<size_t>(atoi(logMaintainSec));
+    } else if (strstr(arg, "--fileSync=") == arg) {
+      if (*(strchr(arg, '=') + 1) == '\0') {
+        fprintf(stderr, "\"--fileSync=\" requires none|async|sync\n");
+        usage(1);
+      }
+      const char* fileSync = strchr(arg, '=') + 1;
+      if (strcmp(fileSync, "none") == 0) {
+        config_.fileConfig_.sync = detail::FileSync_None;
+      } else if (strcmp(fileSync, "async") == 0) {
+        config_.fileConfig_.sync = detail::FileSync_Async;
+      } else if (strcmp(fileSync, "sync") == 0) {
+        config_.fileConfig_.sync = detail::FileSync_Sync;
+      } else {
+        fprintf(stderr, "fileSync value %s is invalid!\n", fileSync);
+        usage(1);
+      }
     } else if (strstr(arg, "--file=") == arg) {
       if (*(strchr(arg, '=') + 1) == '\0') {
         fprintf(stderr, "\"--file=\" requires an file val\n");
@@ -321,9 +751,17 @@ void LoggerManager::checkLogConfig() noexcept {
     case detail::LogSinkType_OptimizedGLog:
       fprintf(stderr, "OptimizedGLog\n");
       break;
+    case detail::LogSinkType_Router: fprintf(stderr, "Router\n"); break;
+    case detail::LogSinkType_AsyncFile: fprintf(stderr, "AsyncFile\n"); break;
     default: fprintf(stderr, "Unknown (%d)\n", config_.logSinkType_); break;
   }
 
+  // Print router children
+  for (const auto& route : config_.routes_) {
+    fprintf(stderr, "routes_: sinkType %d, level %d\n", route.sinkType_,
+        route.level_);
+  }
+
   // Print file logging configuration
   fprintf(stderr, "logToFile_: %s\n", config_.logToFile_ ? "true" : "false");
   fprintf(stderr, "logFilePath_: %s\n", config_.logFilePath_.c_str());
@@ -343,11 +781,123 @@ void LoggerManager::checkLogConfig() noexcept {
       config_.optimizationConfig_.queueCapacity);
   fprintf(stderr, "optimizationConfig_.numWorkers: %zu\n",
       config_.optimizationConfig_.numWorkers);
+  fprintf(stderr, "optimizationConfig_.minWorkers: %zu\n",
+      config_.optimizationConfig_.minWorkers);
+  fprintf(stderr, "optimizationConfig_.maxWorkers: %zu\n",
+      config_.optimizationConfig_.maxWorkers);
+  fprintf(stderr, "optimizationConfig_.scaleUpWaitMs: %zu\n",
+      config_.optimizationConfig_.scaleUpWaitMs);
+  fprintf(stderr, "optimizationConfig_.workerIdleMs: %zu\n",
+      config_.optimizationConfig_.workerIdleMs);
   fprintf(stderr, "optimizationConfig_.poolSize: %zu\n",
       config_.optimizationConfig_.poolSize);
+  fprintf(stderr, "optimizationConfig_.dedupWindowMs: %zu\n",
+      config_.optimizationConfig_.dedupWindowMs);
+  fprintf(stderr, "optimizationConfig_.targetFlushLatencyMs: %zu\n",
+      config_.optimizationConfig_.targetFlushLatencyMs);
+  fprintf(stderr, "optimizationConfig_.numaAware: %s\n",
+      config_.optimizationConfig_.numaAware ? "true" : "false");
+  fprintf(stderr, "optimizationConfig_.waitStrategy: %d\n",
+      config_.optimizationConfig_.waitStrategy);
+  fprintf(stderr, "optimizationConfig_.spinUs: %zu\n",
+      config_.optimizationConfig_.spinUs);
+  fprintf(stderr, "optimizationConfig_.threadRings: %d\n",
+      config_.optimizationConfig_.threadRings);
+  fprintf(stderr, "optimizationConfig_.ringKb: %zu\n",
+      config_.optimizationConfig_.ringKb);
+  fprintf(stderr, "optimizationConfig_.workerFiles: %s\n",
+      config_.optimizationConfig_.workerFiles ? "true" : "false");
+  fprintf(stderr, "optimizationConfig_.poolMemory.prefault: %s\n",
+      config_.optimizationConfig_.poolMemory.prefault ? "true" : "false");
+  fprintf(stderr, "optimizationConfig_.poolMemory.lock: %s\n",
+      config_.optimizationConfig_.poolMemory.lock ? "true" : "false");
+  fprintf(stderr, "optimizationConfig_.poolMemory.hugePages: %d\n",
+      config_.optimizationConfig_.poolMemory.hugePages);
+  fprintf(stderr, "optimizationConfig_.workerThread.cpus:");
+  for (const int cpu : config_.optimizationConfig_.workerThread.cpus) {
+    fprintf(stderr, " %d", cpu);
+  }
+  fprintf(stderr, "\n");
+  fprintf(stderr, "optimizationConfig_.workerThread.name: %s\n",
+      config_.optimizationConfig_.workerThread.name.c_str());
+  fprintf(stderr, "optimizationConfig_.workerThread.schedPolicy: %d\n",
+      config_.optimizationConfig_.workerThread.schedPolicy);
+  fprintf(stderr, "optimizationConfig_.workerThread.nice: %d\n",
+      config_.optimizationConfig_.workerThread.nice);
+  fprintf(stderr, "optimizationConfig_.workerThread.ioClass: %d\n",
+      config_.optimizationConfig_.workerThread.ioClass);
+  fprintf(stderr, "optimizationConfig_.workerThread.ioLevel: %d\n",
+      config_.optimizationConfig_.workerThread.ioLevel);
+
+  // Print AsyncFile-specific configuration
+  fprintf(stderr, "fileConfig_.bufferKb: %zu\n", config_.fileConfig_.bufferKb);
+  fprintf(stderr, "fileConfig_.flushIntervalMs: %zu\n",
+      config_.fileConfig_.flushIntervalMs);
+  fprintf(
+      stderr, "fileConfig_.maxBuffers: %zu\n", config_.fileConfig_.maxBuffers);
+  fprintf(stderr, "fileConfig_.rollMb: %zu\n", config_.fileConfig_.rollMb);
+  fprintf(stderr, "fileConfig_.writer: %d\n", config_.fileConfig_.writer);
+  fprintf(
+      stderr, "fileConfig_.uringDepth: %zu\n", config_.fileConfig_.uringDepth);
+  fprintf(stderr, "fileConfig_.mapMb: %zu\n", config_.fileConfig_.mapMb);
+  fprintf(stderr, "fileConfig_.sync: %d\n", config_.fileConfig_.sync);
+  fprintf(stderr, "fileConfig_.compress: %d\n", config_.fileConfig_.compress);
+  fprintf(stderr, "fileConfig_.compressLevel: %d\n",
+      config_.fileConfig_.compressLevel);
+  fprintf(stderr, "fileConfig_.indexKb: %zu\n", config_.fileConfig_.indexKb);
+  fprintf(stderr, "maintainConfig_.compress: %s\n",
+      config_.maintainConfig_.compress ? "true" : "false");
+  fprintf(stderr, "maintainConfig_.bloom: %s\n",
+      config_.maintainConfig_.bloom ? "true" : "false");
+  fprintf(stderr, "maintainConfig_.maxTotalMb: %zu\n",
+      config_.maintainConfig_.maxTotalMb);
+  fprintf(stderr, "maintainConfig_.maxAgeHours: %zu\n",
+      config_.maintainConfig_.maxAgeHours);
+  fprintf(stderr, "maintainConfig_.intervalSec: %zu\n",
+      config_.maintainConfig_.intervalSec);
   fprintf(stderr, "----------------------------------------\n");
 
-  if (detail::LogSinkType::LogSinkType_Stdout == config_.logSinkType_) {
+  if (detail::LogSinkType::LogSinkType_Router == config_.logSinkType_) {
+    if (config_.routes_.empty()) {
+      fprintf(stderr, "icrane: log sink type router requires [--routes]\n");
+      exit(1);
+    }
+
+    int glogRoutes = 0;
+    for (const auto& route : config_.routes_) {
+      if (detail::LogSinkType::LogSinkType_Router == route.sinkType_ ||
+          detail::LogSinkType::LogSinkType_None == route.sinkType_) {
+        fprintf(stderr, "icrane: route sink type %d is invalid\n",
+            route.sinkType_);
+        exit(1);
+      }
+
+      if (detail::LogSinkType::LogSinkType_GLog == route.sinkType_ ||
+          detail::LogSinkType::LogSinkType_OptimizedGLog == route.sinkType_) {
+        // glog keeps process-wide state, only one sink may drive it
+        if (++glogRoutes > 1) {
+          fprintf(stderr, "icrane: router supports only one glog based sink\n");
+          exit(1);
+        }
+
+        if (detail::LogLevel_Verbose == route.level_) {
+          fprintf(stderr,
+              "icrane: log sink type glog only support log level "
+              "debug|info|warn|error|fatal\n");
+          exit(1);
+        }
+      }
+    }
+  } else if (!config_.routes_.empty()) {
+    fprintf(stderr, "icrane: need to set [--sinktype=Router] for [--routes]\n");
+    exit(1);
+  }
+
+  if (detail::LogSinkType::LogSinkType_Stdout == config_.logSinkType_ ||
+      (detail::LogSinkType::LogSinkType_Router == config_.logSinkType_ &&
+          !hasSinkType(detail::LogSinkType::LogSinkType_GLog) &&
+          !hasSinkType(detail::LogSinkType::LogSinkType_OptimizedGLog) &&
+          !hasSinkType(detail::LogSinkType::LogSinkType_AsyncFile))) {
     if ((true == config_.logToFile_) ||
         (detail::LogLevel_NoLog != config_.logLevelToFile_) ||
         (!config_.logFilePath_.empty())) {
@@ -357,8 +907,8 @@ void LoggerManager::checkLogConfig() noexcept {
     }
   }
 
-  if (detail::LogSinkType::LogSinkType_GLog == config_.logSinkType_ ||
-      detail::LogSinkType::LogSinkType_OptimizedGLog == config_.logSinkType_) {
+  if (hasSinkType(detail::LogSinkType::LogSinkType_GLog) ||
+      hasSinkType(detail::LogSinkType::LogSinkType_OptimizedGLog)) {
     if ((detail::LogLevel_Verbose == config_.logLevelToStderr_) ||
         (detail::LogLevel_Verbose == config_.logLevelToFile_)) {
       fprintf(stderr,
@@ -377,7 +927,7 @@ void LoggerManager::checkLogConfig() noexcept {
   }
 
   // Special checks for OptimizedGLog
-  if (detail::LogSinkType::LogSinkType_OptimizedGLog == config_.logSinkType_) {
+  if (hasSinkType(detail::LogSinkType::LogSinkType_OptimizedGLog)) {
     // Ensure sane values for optimization parameters
     if (config_.optimizationConfig_.batchSize < 10) {
       fprintf(
@@ -398,6 +948,61 @@ void LoggerManager::checkLogConfig() noexcept {
       config_.optimizationConfig_.numWorkers = 1;
     }
 
+    if (config_.optimizationConfig_.minWorkers < 1) {
+      fprintf(stderr, "Warning: minWorkers must be at least 1\n");
+      config_.optimizationConfig_.minWorkers = 1;
+    }
+
+    if (config_.optimizationConfig_.minWorkers >
+        config_.optimizationConfig_.numWorkers) {
+      fprintf(stderr, "Warning: minWorkers exceeds numWorkers, lowering it\n");
+      config_.optimizationConfig_.minWorkers =
+          config_.optimizationConfig_.numWorkers;
+    }
+
+    if (config_.optimizationConfig_.maxWorkers <
+        config_.optimizationConfig_.numWorkers) {
+      fprintf(stderr, "Warning: maxWorkers below numWorkers, raising it\n");
+      config_.optimizationConfig_.maxWorkers =
+          config_.optimizationConfig_.numWorkers;
+    }
+
+    if (config_.optimizationConfig_.scaleUpWaitMs < 1) {
+      fprintf(stderr, "Warning: scaleUpWaitMs must be at least 1\n");
+      config_.optimizationConfig_.scaleUpWaitMs = 1;
+    }
+
+    if (config_.optimizationConfig_.workerIdleMs < 1) {
+      fprintf(stderr, "Warning: workerIdleMs must be at least 1\n");
+      config_.optimizationConfig_.workerIdleMs = 1;
+    }
+
+    if (detail::ThreadRingMode_Off != config_.optimizationConfig_.threadRings) {
+      // A ring holds at least two of the largest messages
+      if (config_.optimizationConfig_.ringKb < 16) {
+        fprintf(stderr, "Warning: ringKb too small, setting to 16\n");
+        config_.optimizationConfig_.ringKb = 16;
+      }
+
+      if (config_.optimizationConfig_.numaAware) {
+        fprintf(stderr,
+            "Warning: numaAware has no effect with threadRings, rings are "
+            "allocated by their producers\n");
+      }
+    }
+
+    LogWorkerThreadConfig& workerThread =
+        config_.optimizationConfig_.workerThread;
+    if (workerThread.nice < -20 || workerThread.nice > 19) {
+      fprintf(stderr, "Warning: workerNice must be within [-20, 19]\n");
+      workerThread.nice = std::min(std::max(workerThread.nice, -20), 19);
+    }
+
+    if (detail::WorkerSchedPolicy_Idle == workerThread.schedPolicy &&
+        0 != workerThread.nice) {
+      fprintf(stderr, "Warning: workerNice has no effect with SCHED_IDLE\n");
+    }
+
     if (config_.optimizationConfig_.poolSize <
         config_.optimizationConfig_.queueCapacity) {
       fprintf(stderr,
@@ -406,6 +1011,83 @@ void LoggerManager::checkLogConfig() noexcept {
           config_.optimizationConfig_.queueCapacity;
     }
   }
+
+  // Special checks for AsyncFile
+  if (hasSinkType(detail::LogSinkType::LogSinkType_AsyncFile)) {
+    // A buffer has to hold the largest message
+    if (config_.fileConfig_.bufferKb < 4) {
+      fprintf(stderr, "Warning: fileBufferKb too small, setting to 4\n");
+      config_.fileConfig_.bufferKb = 4;
+    }
+
+    if (config_.fileConfig_.flushIntervalMs < 1) {
+      fprintf(stderr, "Warning: fileFlushMs must be at least 1\n");
+      config_.fileConfig_.flushIntervalMs = 1;
+    }
+
+    if (config_.fileConfig_.maxBuffers < 1) {
+      fprintf(stderr, "Warning: fileMaxBuffers must be at least 1\n");
+      config_.fileConfig_.maxBuffers = 1;
+    }
+
+    if (config_.fileConfig_.rollMb < 1) {
+      fprintf(stderr, "Warning: fileRollMb must be at least 1\n");
+      config_.fileConfig_.rollMb = 1;
+    }
+
+    // every write in flight holds a registered buffer of fileBufferKb
+    if (config_.fileConfig_.uringDepth < 1 ||
+        config_.fileConfig_.uringDepth > 64) {
+      fprintf(stderr, "Warning: fileUringDepth must be between 1 and 64\n");
+      config_.fileConfig_.uringDepth =
+          std::min<size_t>(std::max<size_t>(config_.fileConfig_.uringDepth, 1),
+              64);
+    }
+
+    if (config_.fileConfig_.mapMb < 1) {
+      fprintf(stderr, "Warning: fileMapMb must be at least 1\n");
+      config_.fileConfig_.mapMb = 1;
+    }
+
+    if (config_.fileConfig_.compressLevel < 1 ||
+        config_.fileConfig_.compressLevel > 9) {
+      fprintf(stderr, "Warning: fileCompressLevel must be between 1 and 9\n");
+      config_.fileConfig_.compressLevel =
+          std::min(std::max(config_.fileConfig_.compressLevel, 1), 9);
+    }
+
+#ifndef MM_HAVE_ZLIB
+    if (detail::FileCompress_None != config_.fileConfig_.compress) {
+      fprintf(stderr,
+          "Warning: fileCompress needs zlib, which this build lacks, log "
+          "files are not compressed\n");
+      config_.fileConfig_.compress = detail::FileCompress_None;
+    }
+#endif
+
+    if (detail::FileCompress_None != config_.fileConfig_.compress &&
+        detail::FileWriter_Uring == config_.fileConfig_.writer) {
+      fprintf(stderr,
+          "Warning: fileWriter=uring has no effect with fileCompress, "
+          "compressed batches are written with write(2)\n");
+    }
+  }
+
+  // Checks for the maintainer of the rotated files
+  if (config_.maintainConfig_.intervalSec < 1) {
+    fprintf(stderr, "Warning: logMaintainSec must be at least 1\n");
+    config_.maintainConfig_.intervalSec = 1;
+  }
+
+  if (!hasSinkType(detail::LogSinkType::LogSinkType_OptimizedGLog) &&
+      !hasSinkType(detail::LogSinkType::LogSinkType_AsyncFile) &&
+      (config_.maintainConfig_.compress || config_.maintainConfig_.bloom ||
+          config_.maintainConfig_.maxTotalMb > 0 ||
+          config_.maintainConfig_.maxAgeHours > 0)) {
+    fprintf(stderr,
+        "Warning: Rotated files are only maintained for the OptimizedGLog "
+        "and AsyncFile sinks\n");
+  }
 }
 
 detail::LogLevel LoggerManager::transCmdLevelToLogLevel(
@@ -438,53 +1120,152 @@ detail::LogLevel LoggerManager::transCmdLevelToLogLevel(
   return ret;
 }
 
-detail::LogLevelCfg LoggerManager::convertLogLevel() noexcept {
-  detail::LogLevelCfg ret = detail::LogLevel_NoLog;
+detail::LogSinkType LoggerManager::transCmdSinkToSinkType(
+    const char* cmdSink) noexcept {
+  detail::LogSinkType ret = detail::LogSinkType::LogSinkType_Stdout;
 
-  switch (config_.logLevelToStderr_) {
-    case detail::LogLevel_Verbose: {
-      ret = detail::LogLevelCfg_Verbose;
-      break;
-    }
-    case detail::LogLevel_Debug: {
-      ret = detail::LogLevelCfg_Debug;
-      break;
-    }
-    case detail::LogLevel_Info: {
-      ret = detail::LogLevelCfg_Info;
-      break;
-    }
-    case detail::LogLevel_Warn: {
-      ret = detail::LogLevelCfg_Warn;
-      break;
+  if (strcmp(cmdSink, "GLog") == 0) {
+    ret = detail::LogSinkType::LogSinkType_GLog;
+  } else if (strcmp(cmdSink, "Stdout") == 0) {
+    ret = detail::LogSinkType::LogSinkType_Stdout;
+  } else if (strcmp(cmdSink, "OptimizedGLog") == 0) {
+    ret = detail::LogSinkType::LogSinkType_OptimizedGLog;
+  } else if (strcmp(cmdSink, "Router") == 0) {
+    ret = detail::LogSinkType::LogSinkType_Router;
+  } else if (strcmp(cmdSink, "AsyncFile") == 0) {
+    ret = detail::LogSinkType::LogSinkType_AsyncFile;
+  } else {
+    fprintf(stderr, "sinktype value %s is invalid!\n", cmdSink);
+    usage(1);
+  }
+
+  return ret;
+}
+
+void LoggerManager::parseCmdRoutes(const char* cmdRoutes) noexcept {
+  // i.e. "Stdout:warn,OptimizedGLog:info"
+  config_.routes_.clear();
+
+  const std::string routes = cmdRoutes;
+  std::size_t begin        = 0;
+  while (begin <= routes.size()) {
+    std::size_t end = routes.find(',', begin);
+    if (std::string::npos == end) {
+      end = routes.size();
     }
-    case detail::LogLevel_Error: {
-      ret = detail::LogLevelCfg_Error;
-      break;
+
+    const std::string route = routes.substr(begin, end - begin);
+    const std::size_t colon = route.find(':');
+    if ((std::string::npos == colon) || (0 == colon) ||
+        (route.size() - 1 == colon)) {
+      fprintf(stderr, "route value %s is invalid!\n", route.c_str());
+      usage(1);
     }
-    case detail::LogLevel_Fatal: {
-      ret = detail::LogLevelCfg_Fatal;
-      break;
+
+    const std::string sink  = route.substr(0, colon);
+    const std::string level = route.substr(colon + 1);
+    config_.routes_.emplace_back(transCmdSinkToSinkType(sink.c_str()),
+        transCmdLevelToLogLevel(level.c_str()));
+
+    begin = end + 1;
+  }
+}
+
+void LoggerManager::parseCmdCpus(const char* cmdCpus) noexcept {
+  // i.e. "0-3,6"
+  if (!detail::parseCpuList(
+          cmdCpus, config_.optimizationConfig_.workerThread.cpus)) {
+    fprintf(stderr, "cpu list %s is invalid!\n", cmdCpus);
+    usage(1);
+  }
+}
+
+detail::WorkerSchedPolicy LoggerManager::transCmdSchedToSchedPolicy(
+    const char* cmdSched) noexcept {
+  detail::WorkerSchedPolicy ret = detail::WorkerSchedPolicy_Normal;
+
+  if ((strcmp(cmdSched, "normal") == 0) || (strcmp(cmdSched, "NORMAL") == 0)) {
+    ret = detail::WorkerSchedPolicy_Normal;
+  } else if ((strcmp(cmdSched, "batch") == 0) ||
+             (strcmp(cmdSched, "BATCH") == 0)) {
+    ret = detail::WorkerSchedPolicy_Batch;
+  } else if ((strcmp(cmdSched, "idle") == 0) ||
+             (strcmp(cmdSched, "IDLE") == 0)) {
+    ret = detail::WorkerSchedPolicy_Idle;
+  } else {
+    fprintf(stderr, "workerSched value %s is invalid!\n", cmdSched);
+    usage(1);
+  }
+
+  return ret;
+}
+
+void LoggerManager::parseCmdIoPrio(const char* cmdIoPrio) noexcept {
+  // i.e. "be:7", "idle"
+  LogWorkerThreadConfig& workerThread =
+      config_.optimizationConfig_.workerThread;
+
+  const std::string ioPrio  = cmdIoPrio;
+  const std::size_t colon   = ioPrio.find(':');
+  const std::string ioClass = ioPrio.substr(0, colon);
+  if (ioClass == "none") {
+    workerThread.ioClass = detail::WorkerIoClass_None;
+  } else if (ioClass == "rt") {
+    workerThread.ioClass = detail::WorkerIoClass_RealTime;
+  } else if (ioClass == "be") {
+    workerThread.ioClass = detail::WorkerIoClass_BestEffort;
+  } else if (ioClass == "idle") {
+    workerThread.ioClass = detail::WorkerIoClass_Idle;
+  } else {
+    fprintf(stderr, "workerIoPrio class %s is invalid!\n", ioClass.c_str());
+    usage(1);
+  }
+
+  if (std::string::npos != colon) {
+    const std::string level = ioPrio.substr(colon + 1);
+    if (level.size() != 1 || level[0] < '0' || level[0] > '7') {
+      fprintf(stderr, "workerIoPrio level %s is invalid!\n", level.c_str());
+      usage(1);
     }
-    default: {
-      break;
+    workerThread.ioLevel = level[0] - '0';
+  }
+}
+
+bool LoggerManager::hasSinkType(const detail::LogSinkType stype) const
+    noexcept {
+  if (stype == config_.logSinkType_) {
+    return true;
+  }
+
+  if (detail::LogSinkType::LogSinkType_Router == config_.logSinkType_) {
+    for (const auto& route : config_.routes_) {
+      if (stype == route.sinkType_) {
+        return true;
+      }
     }
   }
 
-  return ret;
+  return false;
 }
 
-void LoggerManager::outputLog(const detail::LogLevel lvl, const char* const msg,
-    const std::size_t len) noexcept {
-  switch (lvl) {
-    case detail::LogLevel_Verbose: logVerbose(msg, len); break;
-    case detail::LogLevel_Debug: logDebug(msg, len); break;
-    case detail::LogLevel_Info: logInfo(msg, len); break;
-    case detail::LogLevel_Warn: logWarn(msg, len); break;
-    case detail::LogLevel_Error: logError(msg, len); break;
-    case detail::LogLevel_Fatal: logFatal(msg, len); break;
-    default: break;
+detail::LogLevelCfg LoggerManager::convertLogLevel() noexcept {
+  detail::LogLevelCfg ret = detail::LogLevel_NoLog;
+
+  if (detail::LogSinkType::LogSinkType_Router == config_.logSinkType_) {
+    // Union of the children, so nothing is formatted that no child accepts
+    for (const auto& route : config_.routes_) {
+      ret |= detail::convertLogLevelToCfg(route.level_);
+    }
+  } else if (detail::LogSinkType::LogSinkType_AsyncFile ==
+                 config_.logSinkType_ &&
+             detail::LogLevel_NoLog != config_.logLevelToFile_) {
+    // A file only sink follows the file level when one is given
+    ret = detail::convertLogLevelToCfg(config_.logLevelToFile_);
+  } else {
+    ret = detail::convertLogLevelToCfg(config_.logLevelToStderr_);
   }
+
+  return ret;
 }
 
 }  // namespace mm
@@ -0,0 +1,145 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "NumaTopology.hpp"
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+
+#include "LoggerStatus.hpp"
+
+namespace mm {
+
+namespace detail {
+
+namespace {
+
+const char* const NodeSysfsDir = "/sys/devices/system/node/";
+
+// Parses a non negative decimal number at str, advancing str past it
+bool parseCpuNumber(const char*& str, int& value) noexcept {
+  char* end         = nullptr;
+  const long parsed = strtol(str, &end, 10);
+  if (end == str || parsed < 0 || parsed > 0xffff) {
+    return false;
+  }
+
+  str   = end;
+  value = static_cast<int>(parsed);
+  return true;
+}
+
+bool readSysfsLine(const std::string& path, std::string& line) noexcept {
+  try {
+    std::ifstream file(path);
+    return static_cast<bool>(std::getline(file, line));
+  } catch (...) {
+    return false;
+  }
+}
+
+}  // namespace
+
+bool parseCpuList(const std::string& list, std::vector<int>& cpus) noexcept {
+  cpus.clear();
+
+  const char* str = list.c_str();
+  while ('\0' != *str) {
+    int first = 0;
+    int last  = 0;
+    if (!parseCpuNumber(str, first)) {
+      return false;
+    }
+
+    last = first;
+    if ('-' == *str) {
+      ++str;
+      if (!parseCpuNumber(str, last) || last < first) {
+        return false;
+      }
+    }
+
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+
+    if (',' == *str) {
+      ++str;
+      if ('\0' == *str) {
+        return false;
+      }
+    } else if ('\0' != *str) {
+      return false;
+    }
+  }
+
+  return !cpus.empty();
+}
+
+std::vector<NumaNode> detectNumaNodes() noexcept {
+  std::vector<NumaNode> nodes;
+
+  std::string line;
+  std::vector<int> ids;
+  if (!readSysfsLine(std::string(NodeSysfsDir) + "online", line) ||
+      !parseCpuList(line, ids)) {
+    return nodes;
+  }
+
+  for (const int id : ids) {
+    const std::string path =
+        std::string(NodeSysfsDir) + "node" + std::to_string(id) + "/cpulist";
+
+    // Memory only nodes have an empty cpu list, no worker can run there
+    NumaNode node{id, {}};
+    if (readSysfsLine(path, line) && parseCpuList(line, node.cpus)) {
+      nodes.push_back(std::move(node));
+    }
+  }
+
+  return nodes;
+}
+
+int bindMemoryToNode(
+    void* addr, const std::size_t len, const int node) noexcept {
+  constexpr std::size_t BitsPerMask = 8 * sizeof(unsigned long);
+  if (node < 0 || static_cast<std::size_t>(node) >= BitsPerMask) {
+    return MM_STATUS_ERROR;
+  }
+
+  // Preferred rather than bound, a full node falls back instead of failing
+  const unsigned long nodeMask = 1ul << node;
+  if (0 != syscall(SYS_mbind, addr, len, MPOL_PREFERRED, &nodeMask,
+               BitsPerMask, 0)) {
+    return MM_STATUS_ERROR;
+  }
+
+  return MM_STATUS_OK;
+}
+
+}  // namespace detail
+
+}  // namespace mm
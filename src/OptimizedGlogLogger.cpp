@@ -6,42 +6,203 @@
 #include "OptimizedGlogLogger.hpp"
 #include "Log.hpp"
 #include "LoggerStatus.hpp"
+#include "LogShard.hpp"
+#include "ThreadPriority.hpp"
 
+#include <cerrno>
 #include <cstring>
 #include <algorithm>
+#include <functional>
+#include <new>
+#include <system_error>
+#include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
-#include <sys/syscall.h>
+#include <sys/mman.h>
 
 namespace mm {
 
-OptimizedGlogLogger::LogMessagePool::LogMessagePool(
-    size_t poolSize, size_t msgBufferSize)
-    : freeList_(nullptr), msgBufferSize_(msgBufferSize) {
-  messages_.reserve(poolSize);
-  buffers_.reserve(poolSize);
+namespace {
 
-  for (size_t i = 0; i < poolSize; ++i) {
-    char* buffer = new char[msgBufferSize];
-    buffers_.push_back(buffer);
+inline int64_t steadyNowNs() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Negative spans can only come from a clock glitch, count them as zero
+inline uint64_t spanNs(const int64_t from, const int64_t to) noexcept {
+  return (to > from) ? static_cast<uint64_t>(to - from) : 0;
+}
+
+// A backlog of this share of the queue capacity adds a worker
+constexpr size_t ScaleUpQueueDepthDivisor = 4;
+
+// Shortest period over which tuneBatching() measures, below it a period
+// holds too few batches to judge the latency
+constexpr int64_t MinTunePeriodNs = 10 * 1000000;
+
+// pthread_setname_np() accepts at most 15 characters
+constexpr size_t MaxThreadNameLen = 15;
+
+// Pause between polls of a spinning worker
+inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Explicit huge pages are 2MB, the default size on x86-64 and arm64
+constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+// Numbers the loggers, so the rings a thread kept for a destroyed logger are
+// never taken for those of a new logger at the same address
+std::atomic<uint64_t> nextLoggerId(1);
+
+// A ring the calling thread produces into
+struct ThreadRingEntry {
+  uint64_t loggerId;
+  std::shared_ptr<detail::SpscLogRing> ring;
+};
+
+// The calling thread's rings, closed when it exits so that the workers
+// drop them once drained
+struct ThreadRingEntries {
+  ~ThreadRingEntries() {
+    for (ThreadRingEntry& entry : entries) {
+      entry.ring->close();
+    }
+  }
+
+  std::vector<ThreadRingEntry> entries;
+};
+
+thread_local ThreadRingEntries threadRingEntries;
+
+// A worker writes its file once per batch, or once this much is buffered
+constexpr size_t WorkerFileFlushSize = 64 * 1024;
+
+// Nodes to shard over, none unless NUMA aware on a host with several nodes
+std::vector<detail::NumaNode> shardNodes(const bool numaAware) noexcept {
+  std::vector<detail::NumaNode> nodes;
+  if (numaAware) {
+    nodes = detail::detectNumaNodes();
+    if (nodes.size() < 2) {
+      nodes.clear();
+    }
+  }
+
+  return nodes;
+}
+
+}  // namespace
+
+thread_local OptimizedGlogLogger::WorkerFile*
+    OptimizedGlogLogger::currentWorkerFile_ = nullptr;
+thread_local bool OptimizedGlogLogger::inWorker_ = false;
+
+OptimizedGlogLogger::LogMessagePool::LogMessagePool(size_t poolSize,
+    size_t msgBufferSize, int node, const LogPoolMemoryConfig& memory)
+    : freeList_(nullptr),
+      region_(nullptr),
+      regionSize_(0),
+      buffers_(nullptr),
+      poolSize_(0),
+      msgBufferSize_(msgBufferSize) {
+  // Messages first, buffers from the next cache line on
+  const size_t messagesSize =
+      (poolSize * sizeof(LogMessage) + detail::CacheLineSize - 1) &
+      ~(detail::CacheLineSize - 1);
+  regionSize_ = messagesSize + poolSize * msgBufferSize;
+  if (0 == regionSize_) {
+    return;
+  }
+
+  // MAP_POPULATE would fault the pages in before mbind() or madvise() could
+  // place them
+  const bool populate = memory.prefault && node < 0 &&
+                        detail::PoolHugePages_Transparent != memory.hugePages;
+  const int flags =
+      MAP_PRIVATE | MAP_ANONYMOUS | (populate ? MAP_POPULATE : 0);
+
+  void* region = MAP_FAILED;
+  if (detail::PoolHugePages_Explicit == memory.hugePages) {
+    const size_t hugeSize =
+        (regionSize_ + HugePageSize - 1) & ~(HugePageSize - 1);
+    region = mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE,
+        flags | MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED != region) {
+      regionSize_ = hugeSize;
+    } else {
+      std::fprintf(stderr,
+          "Warning: No huge pages for the message pool, using normal pages: "
+          "%s\n",
+          std::strerror(errno));
+    }
+  }
+
+  if (MAP_FAILED == region) {
+    region = mmap(nullptr, regionSize_, PROT_READ | PROT_WRITE, flags, -1, 0);
+  }
+  if (MAP_FAILED == region) {
+    std::fprintf(stderr, "Error: Failed to map a %zu bytes message pool: %s\n",
+        regionSize_, std::strerror(errno));
+    regionSize_ = 0;
+    return;
+  }
+
+  // Before the first touch, so every page lands on the node
+  if (node >= 0 &&
+      MM_STATUS_OK != detail::bindMemoryToNode(region, regionSize_, node)) {
+    std::fprintf(stderr,
+        "Warning: Failed to place the message pool on node %d: %s\n", node,
+        std::strerror(errno));
+  }
+
+  // Before the first touch as well, later faults would map small pages
+  if (detail::PoolHugePages_Transparent == memory.hugePages &&
+      0 != madvise(region, regionSize_, MADV_HUGEPAGE)) {
+    std::fprintf(stderr,
+        "Warning: Failed to enable transparent huge pages for the message "
+        "pool: %s\n",
+        std::strerror(errno));
+  }
+
+  // Take the page faults now rather than on the producers of the first burst
+  if (memory.prefault && !populate) {
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    volatile char* pages  = static_cast<volatile char*>(region);
+    for (size_t offset = 0; offset < regionSize_; offset += pageSize) {
+      pages[offset] = 0;
+    }
+  }
+
+  // Locking faults the pages in as well
+  if (memory.lock && 0 != mlock(region, regionSize_)) {
+    std::fprintf(stderr,
+        "Warning: Failed to lock the %zu bytes message pool: %s\n",
+        regionSize_, std::strerror(errno));
+  }
+
+  region_   = region;
+  poolSize_ = poolSize;
+  buffers_  = static_cast<char*>(region) + messagesSize;
 
-    LogMessage* msg  = new LogMessage{};
+  LogMessage* messages = static_cast<LogMessage*>(region);
+  for (size_t i = 0; i < poolSize; ++i) {
+    LogMessage* msg  = new (&messages[i]) LogMessage{};
     msg->bufferIndex = i;
     msg->next        = freeList_;
     freeList_        = msg;
-    messages_.push_back(msg);
   }
 }
 
 OptimizedGlogLogger::LogMessagePool::~LogMessagePool() {
-  for (auto msg : messages_) {
-    delete msg;
-  }
-  messages_.clear();
-
-  for (auto buffer : buffers_) {
-    delete[] buffer;
+  if (nullptr != region_) {
+    munmap(region_, regionSize_);
   }
-  buffers_.clear();
 }
 
 // 修改获取消息的方法
@@ -59,13 +220,13 @@ OptimizedGlogLogger::LogMessagePool::acquireLogMessage(
 
   size_t bufferIndex = logMsg->bufferIndex;
 
-  if (bufferIndex >= buffers_.size()) {
+  if (bufferIndex >= poolSize_) {
     logMsg->next = freeList_;
     freeList_    = logMsg;
     return nullptr;
   }
 
-  char* buffer = buffers_[bufferIndex];
+  char* buffer = buffers_ + bufferIndex * msgBufferSize_;
 
   size_t copyLen = std::min(len, msgBufferSize_ - 1);
   std::memcpy(buffer, msg, copyLen);
@@ -88,13 +249,28 @@ void OptimizedGlogLogger::LogMessagePool::releaseLogMessage(
   freeList_    = logMsg;
 }
 
+OptimizedGlogLogger::QueueShard::QueueShard(const int node,
+    const std::vector<int>& cpus, size_t poolSize, size_t msgBufferSize,
+    const LogPoolMemoryConfig& memory)
+    : node(node),
+      cpus(cpus),
+      pool(poolSize, msgBufferSize, node, memory),
+      queue(),
+      depth(0),
+      mutex(),
+      cv(),
+      sleepers(0),
+      activeWorkers(0),
+      lastScaleUpNs(0) {}
+
 // Implementation of OptimizedGlogLogger
 OptimizedGlogLogger::OptimizedGlogLogger(const std::string& appId,
     const detail::LogLevel logLevelToStderr,
     const detail::LogLevel logLevelToFile, const LogToFile logToFile,
     const LogFilePath logFilePath, const LogDebugSwitch logDebugSwitch,
-    const bool logToConsole, size_t batchSize, size_t queueCapacity,
-    size_t numWorkers, size_t poolSize) noexcept
+    const bool logToConsole,
+    const LoggerOptimizationConfig& optimizationConfig,
+    const LogMaintainConfig& maintainConfig) noexcept
     : appId_(appId),
       logLevelToStderr_(logLevelToStderr),
       logLevelToFile_(logLevelToFile),
@@ -102,14 +278,47 @@ OptimizedGlogLogger::OptimizedGlogLogger(const std::string& appId,
       logFilePath_(logFilePath),
       logDebugSwitch_(logDebugSwitch),
       logToConsole_(logToConsole),
-      batchSize_(batchSize),
-      queueCapacity_(queueCapacity),
-      numWorkers_(numWorkers),
+      numaNodes_(shardNodes(optimizationConfig.numaAware &&
+                            detail::ThreadRingMode_Off ==
+                                optimizationConfig.threadRings)),
+      batchSize_(optimizationConfig.batchSize),
+      queueCapacity_(optimizationConfig.queueCapacity /
+                     std::max<size_t>(numaNodes_.size(), 1)),
+      numWorkers_(optimizationConfig.numWorkers),
+      minWorkers_(optimizationConfig.minWorkers),
+      maxWorkers_(optimizationConfig.maxWorkers),
+      scaleUpWaitNs_(
+          static_cast<int64_t>(optimizationConfig.scaleUpWaitMs) * 1000000),
+      workerIdle_(optimizationConfig.workerIdleMs),
+      targetFlushLatencyNs_(
+          static_cast<int64_t>(optimizationConfig.targetFlushLatencyMs) *
+          1000000),
+      workerThreadConfig_(optimizationConfig.workerThread),
+      waitStrategy_(optimizationConfig.waitStrategy),
+      spinTime_(optimizationConfig.spinUs),
+      threadRingMode_(optimizationConfig.threadRings),
+      ringSize_(optimizationConfig.ringKb * 1024),
+      workerFiles_(optimizationConfig.workerFiles),
+      nextWorkerId_(0),
+      workerFileDir_(),
+      drainFileMutex_(),
+      drainFile_(),
+      effectiveBatchSize_(optimizationConfig.batchSize),
+      wakeThreshold_(optimizationConfig.batchSize),
+      lastTuneNs_(0),
+      lastTuneEnqueued_(0),
+      maxFlushLatencyNs_(0),
+      loggerId_(nextLoggerId.fetch_add(1)),
+      rings_(),
+      ringsVersion_(0),
+      ringSleepers_(0),
+      ringParkedDepth_(0),
+      ringWakeups_(0),
       shutdown_(false),
-      enqueuedCount_(0),
-      processedCount_(0),
-      droppedCount_(0),
-      overflowCount_(0) {
+      dedupWindow_(optimizationConfig.dedupWindowMs),
+      maintainer_(),
+      maintainConfig_(maintainConfig),
+      counters_() {
   // Initialize path for logs
   if (logToFile_) {
     if (logFilePath_.empty()) {
@@ -121,8 +330,32 @@ OptimizedGlogLogger::OptimizedGlogLogger(const std::string& appId,
     }
   }
 
-  // Create message pool
-  messagePool_ = std::make_unique<LogMessagePool>(poolSize, msgBufferSize_);
+  // Create the message pools, one per NUMA node when NUMA aware, messages
+  // are copied into the thread rings instead when they are on
+  if (numaNodes_.empty()) {
+    const size_t poolSize =
+        (detail::ThreadRingMode_Off == threadRingMode_)
+            ? optimizationConfig.poolSize
+            : 0;
+    shards_.push_back(std::make_unique<QueueShard>(-1, std::vector<int>(),
+        poolSize, msgBufferSize_, optimizationConfig.poolMemory));
+  } else {
+    const size_t poolSize = optimizationConfig.poolSize / numaNodes_.size();
+    for (const detail::NumaNode& node : numaNodes_) {
+      for (const int cpu : node.cpus) {
+        if (cpuShards_.size() <= static_cast<size_t>(cpu)) {
+          cpuShards_.resize(cpu + 1, 0);
+        }
+        cpuShards_[cpu] = shards_.size();
+      }
+      shards_.push_back(std::make_unique<QueueShard>(node.id, node.cpus,
+          poolSize, msgBufferSize_, optimizationConfig.poolMemory));
+    }
+  }
+
+  if (dedupWindow_.count() > 0) {
+    deduplicator_ = std::make_unique<LogDeduplicator>(dedupWindow_);
+  }
 }
 
 OptimizedGlogLogger::~OptimizedGlogLogger() { teardown(); }
@@ -219,6 +452,27 @@ int OptimizedGlogLogger::setup() {
         google::SetLogSymlink(google::GLOG_WARNING, appId_.c_str());
         google::SetLogSymlink(google::GLOG_ERROR, appId_.c_str());
         google::SetLogSymlink(google::GLOG_FATAL, appId_.c_str());
+
+        std::vector<std::string> prefixes = {
+            "INFO.", "WARNING.", "ERROR.", "FATAL."};
+
+        // The workers write all but the fatal messages to their own files,
+        // see LogShard.hpp
+        if (workerFiles_) {
+          workerFileDir_ = dirPath;
+          prefixes.push_back(appId_ + ".w");
+          if (logToConsole_) {
+            std::fprintf(stderr,
+                "Warning: Only fatal messages reach the console with "
+                "worker files\n");
+          }
+        }
+
+        // glog only removes files past GLOG_OVERDUE_DAY, the maintainer
+        // also keeps the directory within its budget
+        maintainer_ = std::make_unique<detail::LogMaintainer>(
+            dirPath, prefixes, maintainConfig_);
+        (void)(maintainer_->start());
       }
     } else {
       // If file logging is not enabled, explicitly disable all file output
@@ -229,8 +483,16 @@ int OptimizedGlogLogger::setup() {
     }
     // Start worker threads for async processing
     shutdown_ = false;
-    for (size_t i = 0; i < numWorkers_; ++i) {
-      workers_.emplace_back(&OptimizedGlogLogger::workerThread, this);
+    lastTuneNs_.store(steadyNowNs());
+    {
+      std::lock_guard<std::mutex> lock(workersMutex_);
+      for (auto& shard : shards_) {
+        for (size_t i = 0; i < numWorkers_; ++i) {
+          workers_.emplace_back(&OptimizedGlogLogger::workerThread, this,
+              nextWorkerId_++, shard.get());
+          ++shard->activeWorkers;
+        }
+      }
     }
 
     return ec;
@@ -245,116 +507,783 @@ int OptimizedGlogLogger::setup() {
 }
 
 int OptimizedGlogLogger::teardown() {
+  if (maintainer_) {
+    maintainer_->stop();
+  }
+
   // Signal shutdown to worker threads
+  for (auto& shard : shards_) {
+    {
+      std::lock_guard<std::mutex> lock(shard->mutex);
+      shutdown_ = true;
+    }
+    shard->cv.notify_all();
+  }
   {
-    std::lock_guard<std::mutex> lock(queueMutex_);
-    shutdown_ = true;
+    std::lock_guard<std::mutex> lock(ringWaitMutex_);
   }
-  queueCV_.notify_all();
+  ringCv_.notify_all();
 
-  // Wait for worker threads to complete
-  for (auto& worker : workers_) {
+  // Wait for worker threads to complete, a worker can still add another
+  // one until it sees the shutdown flag under workersMutex_
+  std::vector<std::thread> workers;
+  {
+    std::lock_guard<std::mutex> lock(workersMutex_);
+    workers.swap(workers_);
+  }
+  for (auto& worker : workers) {
     if (worker.joinable()) {
       worker.join();
     }
   }
-  workers_.clear();
+  {
+    std::lock_guard<std::mutex> lock(workersMutex_);
+    retiredWorkers_.clear();
+  }
+
+  for (auto& shard : shards_) {
+    shard->activeWorkers = 0;
+
+    // Process any remaining messages in the queue
+    processLogBatch(*shard);
+  }
+
+  // Drain the thread rings, the front end is detached by now
+  if (detail::ThreadRingMode_Off != threadRingMode_) {
+    RingCursor cursor;
+    size_t processed = 0;
+    do {
+      processRingBatch(cursor, processed);
+    } while (processed > 0);
+
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    rings_.clear();
+    ++ringsVersion_;
+  }
 
-  // Process any remaining messages in the queue
-  processLogBatch();
+  // Report the repeats still pending in open windows
+  flushDedupSummaries(true);
 
-  // Clean up message queue
   {
-    std::lock_guard<std::mutex> lock(queueMutex_);
-    while (!messageQueue_.empty()) {
-      LogMessage* msg = messageQueue_.front();
-      messageQueue_.pop();
-      messagePool_->releaseLogMessage(msg);
+    std::lock_guard<std::mutex> lock(drainFileMutex_);
+    if (drainFile_) {
+      flushWorkerFile(*drainFile_);
+      drainFile_.reset();
+    }
+  }
+
+  // Clean up message queues
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    while (!shard->queue.empty()) {
+      LogMessage* msg = shard->queue.front();
+      shard->queue.pop();
+      shard->pool.releaseLogMessage(msg);
     }
+    shard->depth = 0;
   }
 
   // Shutdown glog
   google::ShutdownGoogleLogging();
 
   // Log performance metrics
+  LoggerStats stats;
+  getStats(stats);
   std::fprintf(stderr,
       "OptimizedGlogLogger stats - Enqueued: %lu, Processed: %lu, Dropped: "
-      "%lu, Overflow: %lu\n",
-      static_cast<unsigned long>(enqueuedCount_.load()),
-      static_cast<unsigned long>(processedCount_.load()),
-      static_cast<unsigned long>(droppedCount_.load()),
-      static_cast<unsigned long>(overflowCount_.load()));
+      "%lu, Overflow: %lu, Deduplicated: %lu, Worker scale up/down: "
+      "%lu/%lu\n",
+      static_cast<unsigned long>(stats.enqueued),
+      static_cast<unsigned long>(stats.processed),
+      static_cast<unsigned long>(stats.dropped),
+      static_cast<unsigned long>(stats.overflow),
+      static_cast<unsigned long>(stats.deduplicated),
+      static_cast<unsigned long>(stats.workerScaleUps),
+      static_cast<unsigned long>(stats.workerScaleDowns));
+  std::fprintf(stderr,
+      "OptimizedGlogLogger latency us (p50/p99/p99.9/max) - Queue wait: "
+      "%.1f/%.1f/%.1f/%.1f, Write: %.1f/%.1f/%.1f/%.1f, End to end: "
+      "%.1f/%.1f/%.1f/%.1f\n",
+      stats.queueWait.percentile(50) / 1e3,
+      stats.queueWait.percentile(99) / 1e3,
+      stats.queueWait.percentile(99.9) / 1e3, stats.queueWait.max() / 1e3,
+      stats.write.percentile(50) / 1e3, stats.write.percentile(99) / 1e3,
+      stats.write.percentile(99.9) / 1e3, stats.write.max() / 1e3,
+      stats.endToEnd.percentile(50) / 1e3,
+      stats.endToEnd.percentile(99) / 1e3,
+      stats.endToEnd.percentile(99.9) / 1e3, stats.endToEnd.max() / 1e3);
   return MM_STATUS_OK;
 }
 
-void OptimizedGlogLogger::workerThread() {
+int OptimizedGlogLogger::getStats(LoggerStats& stats) const {
+  stats.enqueued += counters_.load(Counter_Enqueued);
+  stats.processed += counters_.load(Counter_Processed);
+  stats.dropped += counters_.load(Counter_Dropped);
+  stats.overflow += counters_.load(Counter_Overflow);
+  if (deduplicator_) {
+    stats.deduplicated += deduplicator_->suppressedCount();
+  }
+  stats.notifications += counters_.load(Counter_Notify);
+  for (const auto& shard : shards_) {
+    stats.workers += shard->activeWorkers.load(std::memory_order_relaxed);
+  }
+  stats.workerScaleUps += counters_.load(Counter_WorkerScaleUp);
+  stats.workerScaleDowns += counters_.load(Counter_WorkerScaleDown);
+  stats.batchSize += effectiveBatchSize_.load(std::memory_order_relaxed);
+  stats.wakeThreshold += wakeThreshold_.load(std::memory_order_relaxed);
+
+  queueWaitLatency_.addTo(stats.queueWait);
+  writeLatency_.addTo(stats.write);
+  endToEndLatency_.addTo(stats.endToEnd);
+
+  return MM_STATUS_OK;
+}
+
+void OptimizedGlogLogger::workerThread(const size_t id, QueueShard* shard) {
+  configureWorkerThread(id, *shard);
+
+  // Wake up at least once per dedup window to report pending repeats, once
+  // per idle period to see whether this worker is still needed, and twice
+  // per latency target to flush batches that are still filling up
+  std::chrono::milliseconds timeout =
+      deduplicator_ ? std::min(dedupWindow_, workerIdle_) : workerIdle_;
+  if (targetFlushLatencyNs_ > 0) {
+    timeout = std::min(timeout,
+        std::chrono::milliseconds(
+            std::max<int64_t>(targetFlushLatencyNs_ / 2000000, 1)));
+  }
+  auto busySince = std::chrono::steady_clock::now();
+
+  const bool rings = detail::ThreadRingMode_Off != threadRingMode_;
+  RingCursor cursor;
+
+  std::unique_ptr<WorkerFile> file;
+  if (!workerFileDir_.empty()) {
+    file               = openWorkerFile(id);
+    currentWorkerFile_ = file.get();
+    inWorker_          = true;
+  }
+
   while (true) {
+    bool idle = false;
+
     // Wait for work or shutdown signal
-    {
-      std::unique_lock<std::mutex> lock(queueMutex_);
-      queueCV_.wait(lock, [this] {
-        return shutdown_ || messageQueue_.size() >= batchSize_ ||
-               (!messageQueue_.empty() &&
-                   messageQueue_.size() >= queueCapacity_ / 2);
-      });
-
-      // Exit if shutdown and no more messages
-      if (shutdown_ && messageQueue_.empty()) {
-        break;
+    const bool woken =
+        rings ? waitForRingWork(cursor, timeout) : waitForWork(*shard, timeout);
+    const size_t depth = rings ? ringDepth(cursor)
+                               : shard->depth.load(std::memory_order_relaxed);
+
+    // Exit if shutdown and no more messages
+    if (shutdown_ && 0 == depth) {
+      break;
+    }
+
+    idle = !woken && 0 == depth;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (!idle) {
+      busySince = now;
+    } else if (now - busySince >= workerIdle_ && retireWorker(*shard)) {
+      break;
+    }
+
+    flushDedupSummaries(false);
+
+    // Process a batch of messages, ask for help if it was not enough
+    size_t processed = 0;
+    const bool behind = rings ? processRingBatch(cursor, processed)
+                              : processLogBatch(*shard);
+    if (file) {
+      flushWorkerFile(*file);
+    }
+    if (behind) {
+      addWorker(*shard);
+    }
+
+    if (targetFlushLatencyNs_ > 0) {
+      tuneBatching(cursor);
+    }
+  }
+
+  if (file) {
+    flushWorkerFile(*file);
+  }
+  currentWorkerFile_ = nullptr;
+  inWorker_          = false;
+}
+
+bool OptimizedGlogLogger::waitForWork(
+    QueueShard& shard, const std::chrono::milliseconds timeout) {
+  auto ready = [this, &shard] {
+    return shutdown_ ||
+           isWakeDepth(shard.depth.load(std::memory_order_relaxed));
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  if (detail::WaitStrategy_Block != waitStrategy_) {
+    // Spin on the lock free depth, producers do not notify spinning workers
+    const std::chrono::microseconds spin =
+        (detail::WaitStrategy_BusySpin == waitStrategy_)
+            ? std::chrono::duration_cast<std::chrono::microseconds>(timeout)
+            : std::min<std::chrono::microseconds>(spinTime_, timeout);
+    while (!ready() && std::chrono::steady_clock::now() - start < spin) {
+      cpuRelax();
+    }
+
+    if (ready()) {
+      return true;
+    }
+
+    if (detail::WaitStrategy_BusySpin == waitStrategy_) {
+      return false;
+    }
+  }
+
+  // Park, a producer notifies when the depth crosses a wake threshold
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  ++shard.sleepers;
+  const bool woken = shard.cv.wait_until(lock, start + timeout, ready);
+  --shard.sleepers;
+
+  return woken;
+}
+
+bool OptimizedGlogLogger::isWakeDepth(const size_t depth) const noexcept {
+  return depth >= wakeThreshold_.load(std::memory_order_relaxed) ||
+         (0 != depth && depth >= queueCapacity_ / 2);
+}
+
+void OptimizedGlogLogger::configureWorkerThread(
+    const size_t id, const QueueShard& shard) {
+  const LogWorkerThreadConfig& cfg = workerThreadConfig_;
+
+  std::string name = cfg.name + "-" + std::to_string(id);
+  name.resize(std::min(name.size(), MaxThreadNameLen));
+  int ec = pthread_setname_np(pthread_self(), name.c_str());
+  if (0 != ec) {
+    std::fprintf(stderr, "Warning: %s: failed to set the thread name: %s\n",
+        name.c_str(), std::strerror(ec));
+  }
+
+  // A shard's workers stay on its node, within --workerCpus when the two
+  // overlap
+  std::vector<int> allowed = cfg.cpus;
+  if (!shard.cpus.empty()) {
+    allowed.clear();
+    for (const int cpu : shard.cpus) {
+      if (cfg.cpus.empty() ||
+          cfg.cpus.end() != std::find(cfg.cpus.begin(), cfg.cpus.end(), cpu)) {
+        allowed.push_back(cpu);
+      }
+    }
+    if (allowed.empty()) {
+      allowed = shard.cpus;
+    }
+  }
+
+  if (!allowed.empty()) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (const int cpu : allowed) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpus);
       }
     }
+    ec = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (0 != ec) {
+      std::fprintf(stderr, "Warning: %s: failed to set the CPU affinity: %s\n",
+          name.c_str(), std::strerror(ec));
+    }
+  }
 
-    // Process a batch of messages
-    processLogBatch();
+  if (detail::WorkerSchedPolicy_Normal != cfg.schedPolicy) {
+    const int policy = (detail::WorkerSchedPolicy_Idle == cfg.schedPolicy)
+                           ? SCHED_IDLE
+                           : SCHED_BATCH;
+    sched_param param{};
+    ec = pthread_setschedparam(pthread_self(), policy, &param);
+    if (0 != ec) {
+      std::fprintf(stderr,
+          "Warning: %s: failed to set the scheduling policy: %s\n",
+          name.c_str(), std::strerror(ec));
+    }
   }
+
+  // glog writes from the calling thread, so the I/O priority covers the
+  // file writes
+  detail::setThreadPriority(name.c_str(), cfg.nice, cfg.ioClass, cfg.ioLevel);
 }
 
-void OptimizedGlogLogger::processLogBatch() {
+void OptimizedGlogLogger::addWorker(QueueShard& shard) {
+  if (shard.activeWorkers.load(std::memory_order_relaxed) >= maxWorkers_) {
+    return;
+  }
+
+  // Give the last worker added the time to show its effect
+  const int64_t now = steadyNowNs();
+  int64_t last      = shard.lastScaleUpNs.load(std::memory_order_relaxed);
+  if (now - last < scaleUpWaitNs_ ||
+      !shard.lastScaleUpNs.compare_exchange_strong(last, now)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(workersMutex_);
+  if (shutdown_ || shard.activeWorkers.load() >= maxWorkers_) {
+    return;
+  }
+
+  joinRetiredWorkers();
+
+  try {
+    workers_.emplace_back(
+        &OptimizedGlogLogger::workerThread, this, nextWorkerId_, &shard);
+  } catch (const std::system_error& e) {
+    std::fprintf(stderr, "Failed to add a log worker: %s\n", e.what());
+    return;
+  }
+  ++nextWorkerId_;
+  ++shard.activeWorkers;
+  counters_.add(Counter_WorkerScaleUp);
+}
+
+bool OptimizedGlogLogger::retireWorker(QueueShard& shard) {
+  size_t active = shard.activeWorkers.load();
+  while (active > minWorkers_) {
+    if (shard.activeWorkers.compare_exchange_weak(active, active - 1)) {
+      std::lock_guard<std::mutex> lock(workersMutex_);
+      retiredWorkers_.push_back(std::this_thread::get_id());
+      counters_.add(Counter_WorkerScaleDown);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void OptimizedGlogLogger::joinRetiredWorkers() {
+  for (const std::thread::id& id : retiredWorkers_) {
+    auto it = std::find_if(workers_.begin(), workers_.end(),
+        [&id](const std::thread& worker) { return worker.get_id() == id; });
+    if (it != workers_.end()) {
+      it->join();
+      workers_.erase(it);
+    }
+  }
+  retiredWorkers_.clear();
+}
+
+void OptimizedGlogLogger::tuneBatching(RingCursor& cursor) {
+  // One worker per period runs the controller
+  const int64_t now    = steadyNowNs();
+  int64_t last         = lastTuneNs_.load(std::memory_order_relaxed);
+  const int64_t period = std::max(targetFlushLatencyNs_, MinTunePeriodNs);
+  if (now - last < period ||
+      !lastTuneNs_.compare_exchange_strong(last, now)) {
+    return;
+  }
+
+  const uint64_t latency  = maxFlushLatencyNs_.exchange(0);
+  const uint64_t enqueued = counters_.load(Counter_Enqueued);
+  const uint64_t arrived  = enqueued - lastTuneEnqueued_.exchange(enqueued);
+  size_t depth            = 0;
+  if (detail::ThreadRingMode_Off != threadRingMode_) {
+    depth = ringDepth(cursor);
+  }
+  for (const auto& shard : shards_) {
+    depth = std::max(depth, shard->depth.load(std::memory_order_relaxed));
+  }
+
+  // AIMD: halve the batch when the target is missed, grow it slowly while
+  // the latency leaves room and the queue holds enough to fill it
+  const uint64_t target = static_cast<uint64_t>(targetFlushLatencyNs_);
+  size_t batchSize      = effectiveBatchSize_.load(std::memory_order_relaxed);
+  if (latency > target) {
+    batchSize = std::max<size_t>(batchSize / 2, 1);
+  } else if (latency < target / 2 && depth >= batchSize) {
+    batchSize = std::min(batchSize + std::max<size_t>(batchSize_ / 8, 1),
+        batchSize_);
+  }
+
+  // Wake a worker once half a target worth of messages has arrived in its
+  // shard, so the oldest of them is written well within the target
+  const double rate = static_cast<double>(arrived) /
+                      static_cast<double>(now - last) /
+                      static_cast<double>(shards_.size());
+  const double expected = rate * static_cast<double>(target / 2);
+  const size_t wakeThreshold =
+      std::min(std::max<size_t>(static_cast<size_t>(expected), 1), batchSize);
+
+  effectiveBatchSize_.store(batchSize, std::memory_order_relaxed);
+  wakeThreshold_.store(wakeThreshold, std::memory_order_relaxed);
+}
+
+bool OptimizedGlogLogger::processLogBatch(QueueShard& shard) {
   std::vector<LogMessage*> batch;
   batch.reserve(batchSize_);
+  const size_t batchSize = effectiveBatchSize_.load(std::memory_order_relaxed);
+  size_t backlog         = 0;
+  bool wakeNext          = false;
 
   // Get a batch of messages from the queue with minimum lock time
   {
-    std::lock_guard<std::mutex> lock(queueMutex_);
-    size_t count = std::min(messageQueue_.size(), batchSize_);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    size_t count = std::min(shard.queue.size(), batchSize);
     for (size_t i = 0; i < count; ++i) {
-      batch.push_back(messageQueue_.front());
-      messageQueue_.pop();
+      batch.push_back(shard.queue.front());
+      shard.queue.pop();
     }
+    backlog = shard.queue.size();
+    shard.depth.store(backlog, std::memory_order_relaxed);
+
+    // Producers only notify when the depth crosses a threshold, so hand
+    // a backlog that is still above it on to the next parked worker
+    wakeNext = 0 != shard.sleepers && isWakeDepth(backlog);
+  }
+
+  if (wakeNext) {
+    shard.cv.notify_one();
   }
 
-  // Process each message in the batch
+  if (batch.empty()) {
+    return false;
+  }
+
+  // Process each message in the batch, the end of one write is the start
+  // of the next, so a message costs a single clock read
+  int64_t writeStartNs = steadyNowNs();
+
+  // A partial batch means the workers keep up, however long it waited
+  const bool behind =
+      batch.size() == batchSize &&
+      (backlog >= queueCapacity_ / ScaleUpQueueDepthDivisor ||
+          static_cast<int64_t>(spanNs(batch.front()->enqueueNs,
+              writeStartNs)) >= scaleUpWaitNs_);
+
+  uint64_t maxEndToEndNs = 0;
   for (LogMessage* msg : batch) {
-    switch (msg->level) {
-      case detail::LogLevel_Debug:
-        if (logDebugSwitch_) {
-          VLOG(1) << msg->msg;  // Use VLOG for debug messages for better
-                                // performance
-        }
-        break;
-      case detail::LogLevel_Info: LOG(INFO) << msg->msg; break;
-      case detail::LogLevel_Warn: LOG(WARNING) << msg->msg; break;
-      case detail::LogLevel_Error: LOG(ERROR) << msg->msg; break;
-      case detail::LogLevel_Fatal: LOG(FATAL) << msg->msg; break;
-      default:
-        // Ignore other levels
+    writeStartNs = writeQueuedMessage(
+        msg->level, msg->msg, msg->enqueueNs, writeStartNs, maxEndToEndNs);
+
+    // Return the message to the pool
+    shard.pool.releaseLogMessage(msg);
+  }
+
+  recordFlushLatency(maxEndToEndNs);
+
+  return behind;
+}
+
+bool OptimizedGlogLogger::waitForRingWork(
+    RingCursor& cursor, const std::chrono::milliseconds timeout) {
+  const auto start = std::chrono::steady_clock::now();
+  if (detail::WaitStrategy_Block != waitStrategy_) {
+    // Polls the counters of the rings in the worker's copy, producers do
+    // not notify spinning workers
+    const std::chrono::microseconds spin =
+        (detail::WaitStrategy_BusySpin == waitStrategy_)
+            ? std::chrono::duration_cast<std::chrono::microseconds>(timeout)
+            : std::min<std::chrono::microseconds>(spinTime_, timeout);
+    while (!shutdown_ && !isWakeDepth(ringDepth(cursor))) {
+      if (std::chrono::steady_clock::now() - start >= spin) {
         break;
+      }
+      cpuRelax();
     }
 
-    // Return the message to the pool
-    messagePool_->releaseLogMessage(msg);
-    processedCount_++;
+    if (shutdown_ || isWakeDepth(ringDepth(cursor))) {
+      return true;
+    }
+
+    if (detail::WaitStrategy_BusySpin == waitStrategy_) {
+      return false;
+    }
+  }
+
+  // Park, a producer reads ringSleepers_ after its push and this worker
+  // reads the rings after announcing itself, so one of them sees the other.
+  // The producers count what is pushed from then on, on top of the depth
+  // the worker saw
+  std::unique_lock<std::mutex> lock(ringWaitMutex_);
+  if (0 == ringSleepers_.load(std::memory_order_relaxed)) {
+    ringParkedDepth_.store(0, std::memory_order_relaxed);
+  }
+  ringSleepers_.fetch_add(1);
+  const size_t depth = ringDepth(cursor);
+  bool woken         = 0 != ringWakeups_ || isWakeDepth(depth);
+  if (!woken) {
+    ringParkedDepth_.fetch_add(depth, std::memory_order_relaxed);
+    woken = ringCv_.wait_until(lock, start + timeout,
+        [this] { return shutdown_ || 0 != ringWakeups_; });
+  }
+  ringSleepers_.fetch_sub(1);
+  if (0 != ringWakeups_) {
+    --ringWakeups_;
+  }
+
+  return woken;
+}
+
+bool OptimizedGlogLogger::processRingBatch(
+    RingCursor& cursor, size_t& processed) {
+  processed = 0;
+  refreshRings(cursor);
+
+  const size_t count = cursor.rings.size();
+  if (0 == count) {
+    return false;
+  }
+
+  const size_t batchSize = effectiveBatchSize_.load(std::memory_order_relaxed);
+  int64_t writeStartNs   = steadyNowNs();
+  int64_t oldestNs       = writeStartNs;
+  uint64_t maxEndToEndNs = 0;
+  bool abandoned         = false;  // A ring of an exited thread ran empty
+
+  detail::SpscLogRing::Record record{};
+  if (detail::ThreadRingMode_Merge == threadRingMode_) {
+    // Merge the rings this worker could claim by enqueue time
+    std::vector<detail::SpscLogRing*> claimed;
+    std::vector<std::pair<int64_t, size_t>> heads;
+    for (const auto& ring : cursor.rings) {
+      if (!ring->tryAcquire()) {
+        continue;
+      }
+      if (ring->peek(record)) {
+        heads.emplace_back(record.enqueueNs, claimed.size());
+      } else {
+        abandoned = abandoned || ring->closed();
+      }
+      claimed.push_back(ring.get());
+    }
+
+    const auto later = std::greater<std::pair<int64_t, size_t>>();
+    std::make_heap(heads.begin(), heads.end(), later);
+    if (!heads.empty()) {
+      oldestNs = heads.front().first;
+    }
+
+    while (processed < batchSize && !heads.empty()) {
+      std::pop_heap(heads.begin(), heads.end(), later);
+      detail::SpscLogRing* ring = claimed[heads.back().second];
+      ring->peek(record);
+      writeStartNs = writeQueuedMessage(record.level, record.msg,
+          record.enqueueNs, writeStartNs, maxEndToEndNs);
+      ring->pop(record);
+      ++processed;
+
+      if (ring->peek(record)) {
+        heads.back().first = record.enqueueNs;
+        std::push_heap(heads.begin(), heads.end(), later);
+      } else {
+        heads.pop_back();
+      }
+    }
+
+    for (detail::SpscLogRing* ring : claimed) {
+      ring->release();
+    }
+  } else {
+    // Round robin, each batch starts at the ring after the last batch's
+    const size_t first = cursor.next % count;
+    cursor.next        = first + 1;
+    for (size_t i = 0; i < count && processed < batchSize; ++i) {
+      detail::SpscLogRing* ring = cursor.rings[(first + i) % count].get();
+      if (!ring->tryAcquire()) {
+        continue;
+      }
+
+      while (processed < batchSize && ring->peek(record)) {
+        if (0 == processed) {
+          oldestNs = record.enqueueNs;
+        }
+        writeStartNs = writeQueuedMessage(record.level, record.msg,
+            record.enqueueNs, writeStartNs, maxEndToEndNs);
+        ring->pop(record);
+        ++processed;
+      }
+
+      abandoned = abandoned || (ring->closed() && 0 == ring->size());
+      ring->release();
+    }
+  }
+
+  recordFlushLatency(maxEndToEndNs);
+
+  // Drop the drained rings of exited threads, a producer closes its ring
+  // only after its last push, so one that is closed and empty stays empty
+  if (abandoned) {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    const auto end = std::remove_if(rings_.begin(), rings_.end(),
+        [](const std::shared_ptr<detail::SpscLogRing>& ring) {
+          return ring->closed() && 0 == ring->size();
+        });
+    if (end != rings_.end()) {
+      rings_.erase(end, rings_.end());
+      ++ringsVersion_;
+    }
+  }
+
+  return processed == batchSize &&
+         static_cast<int64_t>(spanNs(oldestNs, steadyNowNs())) >=
+             scaleUpWaitNs_;
+}
+
+void OptimizedGlogLogger::refreshRings(RingCursor& cursor) {
+  if (cursor.version != ringsVersion_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    cursor.rings   = rings_;
+    cursor.version = ringsVersion_.load(std::memory_order_relaxed);
+  }
+}
+
+size_t OptimizedGlogLogger::ringDepth(RingCursor& cursor) {
+  refreshRings(cursor);
+
+  size_t depth = 0;
+  for (const auto& ring : cursor.rings) {
+    depth += ring->size();
+  }
+
+  return depth;
+}
+
+int64_t OptimizedGlogLogger::writeQueuedMessage(detail::LogLevel level,
+    const char* msg, const int64_t enqueueNs, const int64_t writeStartNs,
+    uint64_t& maxEndToEndNs) {
+  writeLogMessage(level, msg, enqueueNs);
+  const int64_t writeEndNs = steadyNowNs();
+  const uint64_t endToEnd  = spanNs(enqueueNs, writeEndNs);
+
+  queueWaitLatency_.record(spanNs(enqueueNs, writeStartNs));
+  writeLatency_.record(spanNs(writeStartNs, writeEndNs));
+  endToEndLatency_.record(endToEnd);
+  maxEndToEndNs = std::max(maxEndToEndNs, endToEnd);
+  counters_.add(Counter_Processed);
+
+  return writeEndNs;
+}
+
+void OptimizedGlogLogger::recordFlushLatency(const uint64_t maxEndToEndNs) {
+  if (targetFlushLatencyNs_ <= 0) {
+    return;
+  }
+
+  uint64_t seen = maxFlushLatencyNs_.load(std::memory_order_relaxed);
+  while (maxEndToEndNs > seen &&
+         !maxFlushLatencyNs_.compare_exchange_weak(seen, maxEndToEndNs)) {
+  }
+}
+
+void OptimizedGlogLogger::writeLogMessage(
+    detail::LogLevel level, const char* msg, const int64_t enqueueNs) {
+  if (!workerFileDir_.empty()) {
+    // Filtered like glog's files, which take the levels from their own up
+    if (level < logLevelToFile_ ||
+        (detail::LogLevel_Debug == level && !logDebugSwitch_) ||
+        writeWorkerRecord(msg, enqueueNs)) {
+      return;
+    }
   }
+
+  switch (level) {
+    case detail::LogLevel_Debug:
+      if (logDebugSwitch_) {
+        VLOG(1) << msg;  // Use VLOG for debug messages for better
+                         // performance
+      }
+      break;
+    case detail::LogLevel_Info: LOG(INFO) << msg; break;
+    case detail::LogLevel_Warn: LOG(WARNING) << msg; break;
+    case detail::LogLevel_Error: LOG(ERROR) << msg; break;
+    case detail::LogLevel_Fatal: LOG(FATAL) << msg; break;
+    default:
+      // Ignore other levels
+      break;
+  }
+}
+
+void OptimizedGlogLogger::flushDedupSummaries(const bool force) {
+  if (!deduplicator_) {
+    return;
+  }
+
+  deduplicator_->flushExpired(
+      [this](detail::LogLevel level, const char* msg, std::size_t len) {
+        (void)(len);
+        writeLogMessage(level, msg, steadyNowNs());
+      },
+      force);
+}
+
+std::unique_ptr<OptimizedGlogLogger::WorkerFile>
+OptimizedGlogLogger::openWorkerFile(const size_t id) {
+  auto file = std::make_unique<WorkerFile>(
+      workerFileDir_, appId_ + ".w" + std::to_string(id));
+  if (MM_STATUS_OK != file->file.open()) {
+    std::fprintf(stderr,
+        "Warning: Failed to open the file of worker %zu, it writes to glog\n",
+        id);
+    return nullptr;
+  }
+
+  return file;
+}
+
+bool OptimizedGlogLogger::writeWorkerRecord(
+    const char* msg, const int64_t enqueueNs) {
+  WorkerFile* file = currentWorkerFile_;
+  std::unique_lock<std::mutex> lock(drainFileMutex_, std::defer_lock);
+  if (!file && inWorker_) {
+    // its file failed to open, glog takes the worker's messages
+    return false;
+  } else if (!file) {
+    // Outside of the workers, i.e. teardown() and logFatal()
+    lock.lock();
+    if (!drainFile_) {
+      size_t id = 0;
+      {
+        std::lock_guard<std::mutex> workersLock(workersMutex_);
+        id = nextWorkerId_++;
+      }
+      drainFile_ = openWorkerFile(id);
+      if (!drainFile_) {
+        return false;
+      }
+    }
+    file = drainFile_.get();
+  }
+
+  char key[detail::LogShardKeyLen];
+  detail::formatLogShardKey(key, static_cast<uint64_t>(enqueueNs));
+  file->records.append(key, sizeof(key));
+  file->records.append(msg);
+  file->records.push_back('\n');
+  if (file->records.size() >= WorkerFileFlushSize) {
+    flushWorkerFile(*file);
+  }
+
+  return true;
 }
 
-bool OptimizedGlogLogger::shouldDropMessage(detail::LogLevel level) const {
+void OptimizedGlogLogger::flushWorkerFile(WorkerFile& file) {
+  if (file.records.empty()) {
+    return;
+  }
+
+  // Like glog's stop_logging_if_full_disk, what can not be written is lost
+  (void)(file.file.append(file.records.data(), file.records.size()));
+  file.records.clear();
+}
+
+bool OptimizedGlogLogger::shouldDropMessage(
+    detail::LogLevel level, const QueueShard& shard) const {
   // Always process fatal logs
   if (level == detail::LogLevel_Fatal) {
     return false;
   }
 
   // Check queue capacity - apply back pressure when queue gets full
-  size_t currentQueueSize = messageQueue_.size();
+  size_t currentQueueSize = shard.depth.load(std::memory_order_relaxed);
 
   if (currentQueueSize >= queueCapacity_) {
     // Queue is full, drop based on priority
@@ -376,36 +1305,189 @@ bool OptimizedGlogLogger::shouldDropMessage(detail::LogLevel level) const {
 
 bool OptimizedGlogLogger::enqueueLogMessage(
     detail::LogLevel level, const char* msg, std::size_t len) {
+  // Collapse repeats before they take queue space from other messages
+  if (deduplicator_) {
+    LogDeduplicator::Summary summary;
+    bool hasSummary = false;
+    bool suppressed =
+        deduplicator_->suppress(level, msg, len, summary, hasSummary);
+
+    if (hasSummary) {
+      enqueueRawLogMessage(summary.level, summary.msg, summary.len);
+    }
+
+    if (suppressed) {
+      return false;
+    }
+  }
+
+  return enqueueRawLogMessage(level, msg, len);
+}
+
+bool OptimizedGlogLogger::enqueueRawLogMessage(
+    detail::LogLevel level, const char* msg, std::size_t len) {
+  if (detail::ThreadRingMode_Off != threadRingMode_) {
+    return enqueueToRing(level, msg, len);
+  }
+
+  QueueShard& shard = currentShard();
+
   // Check if message should be dropped based on level and queue state
-  if (shouldDropMessage(level)) {
-    droppedCount_++;
+  if (shouldDropMessage(level, shard)) {
+    counters_.add(Counter_Dropped);
     return false;
   }
 
   // Get a log message from the pool
-  LogMessage* logMsg = messagePool_->acquireLogMessage(msg, len);
+  LogMessage* logMsg = shard.pool.acquireLogMessage(msg, len);
   if (!logMsg) {
-    overflowCount_++;
+    counters_.add(Counter_Overflow);
     return false;
   }
 
   // Set the log level
-  logMsg->level = level;
+  logMsg->level     = level;
+  logMsg->enqueueNs = steadyNowNs();
 
-  // Add to queue with minimal lock time
+  // Add to queue with minimal lock time, a parked worker is only notified
+  // when this message takes the depth across a wake threshold, the depth
+  // grows one message at a time so no crossing is skipped
+  bool notify = false;
   {
-    std::lock_guard<std::mutex> lock(queueMutex_);
-    messageQueue_.push(logMsg);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.queue.push(logMsg);
+    const size_t depth = shard.queue.size();
+    shard.depth.store(depth, std::memory_order_relaxed);
+    notify = 0 != shard.sleepers && isWakeDepth(depth) &&
+             !isWakeDepth(depth - 1);
   }
 
-  enqueuedCount_++;
+  counters_.add(Counter_Enqueued);
 
-  // Notify a worker thread
-  queueCV_.notify_one();
+  if (notify) {
+    shard.cv.notify_one();
+    counters_.add(Counter_Notify);
+  }
 
   return true;
 }
 
+bool OptimizedGlogLogger::enqueueToRing(
+    detail::LogLevel level, const char* msg, std::size_t len) {
+  ThreadRingEntry* entry = nullptr;
+  for (ThreadRingEntry& candidate : threadRingEntries.entries) {
+    if (loggerId_ == candidate.loggerId) {
+      entry = &candidate;
+      break;
+    }
+  }
+
+  if (!entry) {
+    std::vector<ThreadRingEntry>& entries = threadRingEntries.entries;
+
+    // Forget the rings of destroyed loggers, only this thread holds them
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                      [](const ThreadRingEntry& stale) {
+                        return 1 == stale.ring.use_count();
+                      }),
+        entries.end());
+
+    std::shared_ptr<detail::SpscLogRing> ring;
+    try {
+      ring = std::make_shared<detail::SpscLogRing>(ringSize_);
+      entries.push_back(ThreadRingEntry{loggerId_, ring});
+    } catch (const std::bad_alloc&) {
+      ring.reset();
+    }
+    if (!ring || !ring->valid()) {
+      if (ring) {
+        entries.pop_back();
+      }
+      return writeRingOverflow(level, msg, len);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(ringsMutex_);
+      rings_.push_back(ring);
+      ++ringsVersion_;
+    }
+    entry = &entries.back();
+  }
+
+  // Messages longer than a pool buffer are cut as in the shared queue
+  detail::SpscLogRing& ring = *entry->ring;
+  const bool pushed =
+      ring.push(level, msg, std::min(len, msgBufferSize_ - 1), steadyNowNs());
+  bool written = false;
+  if (pushed) {
+    counters_.add(Counter_Enqueued);
+  } else {
+    written = writeRingOverflow(level, msg, len);
+  }
+
+  // Parked workers are woken by the depth of all the rings, so that many
+  // light producers wake them as one heavy producer would. Producers only
+  // write the shared count while a worker is parked, busy workers find the
+  // messages themselves. The fence pairs with the announcement in
+  // waitForRingWork()
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (0 == ringSleepers_.load(std::memory_order_relaxed)) {
+    return pushed || written;
+  }
+
+  if (pushed &&
+      !isWakeDepth(
+          ringParkedDepth_.fetch_add(1, std::memory_order_relaxed) + 1)) {
+    return true;
+  }
+
+  bool notify = false;
+  {
+    // at most one pending wakeup per parked worker, another one takes the
+    // next wake threshold of messages
+    std::lock_guard<std::mutex> lock(ringWaitMutex_);
+    notify = ringWakeups_ < ringSleepers_.load(std::memory_order_relaxed);
+    ringWakeups_ += notify ? 1 : 0;
+    ringParkedDepth_.store(0, std::memory_order_relaxed);
+  }
+  if (notify) {
+    ringCv_.notify_one();
+    counters_.add(Counter_Notify);
+  }
+
+  return pushed || written;
+}
+
+bool OptimizedGlogLogger::writeRingOverflow(
+    detail::LogLevel level, const char* msg, std::size_t len) {
+  // Like shouldDropMessage() at its worst, everything below Error goes.
+  // Errors and fatals are written ahead of what the ring still holds,
+  // blocking the producer on glog for as long as its ring stays full
+  if (level < detail::LogLevel_Error) {
+    counters_.add(Counter_Overflow);
+    return false;
+  }
+
+  const std::string text(msg, std::min(len, msgBufferSize_ - 1));
+  writeLogMessage(level, text.c_str(), steadyNowNs());
+  counters_.add(Counter_Enqueued);
+  counters_.add(Counter_Processed);
+  return true;
+}
+
+OptimizedGlogLogger::QueueShard& OptimizedGlogLogger::currentShard() noexcept {
+  if (1 == shards_.size()) {
+    return *shards_[0];
+  }
+
+  const int cpu = sched_getcpu();
+  if (cpu < 0 || static_cast<size_t>(cpu) >= cpuShards_.size()) {
+    return *shards_[0];
+  }
+
+  return *shards_[cpuShards_[cpu]];
+}
+
 int OptimizedGlogLogger::convertLogLevel(detail::LogLevel level) noexcept {
   switch (level) {
     case detail::LogLevel_Debug: return google::GLOG_INFO;
@@ -451,7 +1533,12 @@ void OptimizedGlogLogger::logError(const char* msg, const std::size_t len) {
 }
 
 void OptimizedGlogLogger::logFatal(const char* msg, const std::size_t len) {
-  // Fatal logs bypass the queue and are logged immediately
+  // Fatal logs bypass the queue and are logged immediately, into the worker
+  // files as well so that the merged stream ends with them
+  if (!workerFileDir_.empty() && writeWorkerRecord(msg, steadyNowNs())) {
+    std::lock_guard<std::mutex> lock(drainFileMutex_);
+    flushWorkerFile(currentWorkerFile_ ? *currentWorkerFile_ : *drainFile_);
+  }
   LOG(FATAL) << msg;
 }
 
@@ -0,0 +1,141 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "RouterLogger.hpp"
+#include "LoggerStatus.hpp"
+
+namespace mm {
+
+RouterLogger::~RouterLogger() {
+  for (auto& route : routes_) {
+    delete route.logger;
+  }
+  routes_.clear();
+}
+
+void RouterLogger::addRoute(ILogger* logger, const detail::LogLevelCfg mask,
+    const bool timestamp) {
+  if (logger) {
+    routes_.push_back({logger, mask, timestamp});
+    timestamp_ = timestamp_ || timestamp;
+  }
+}
+
+int RouterLogger::setup() {
+  int ec = MM_STATUS_OK;
+
+  for (auto& route : routes_) {
+    ec = route.logger->setup();
+    if (MM_STATUS_OK != ec) {
+      break;
+    }
+  }
+
+  return ec;
+}
+
+int RouterLogger::teardown() {
+  int ec = MM_STATUS_OK;
+
+  for (auto& route : routes_) {
+    int rc = route.logger->teardown();
+    if (MM_STATUS_OK != rc) {
+      ec = rc;
+    }
+  }
+
+  return ec;
+}
+
+int RouterLogger::getStats(LoggerStats& stats) const {
+  int ec = MM_STATUS_ENOENT;
+
+  for (const auto& route : routes_) {
+    if (MM_STATUS_OK == route.logger->getStats(stats)) {
+      ec = MM_STATUS_OK;
+    }
+  }
+
+  return ec;
+}
+
+void RouterLogger::logVerbose(const char* msg, const std::size_t len) {
+  dispatch(detail::LogLevel_Verbose, &ILogger::logVerbose, msg, len);
+}
+
+void RouterLogger::logDebug(const char* msg, const std::size_t len) {
+  dispatch(detail::LogLevel_Debug, &ILogger::logDebug, msg, len);
+}
+
+void RouterLogger::logInfo(const char* msg, const std::size_t len) {
+  dispatch(detail::LogLevel_Info, &ILogger::logInfo, msg, len);
+}
+
+void RouterLogger::logWarn(const char* msg, const std::size_t len) {
+  dispatch(detail::LogLevel_Warn, &ILogger::logWarn, msg, len);
+}
+
+void RouterLogger::logError(const char* msg, const std::size_t len) {
+  dispatch(detail::LogLevel_Error, &ILogger::logError, msg, len);
+}
+
+void RouterLogger::logFatal(const char* msg, const std::size_t len) {
+  dispatch(detail::LogLevel_Fatal, &ILogger::logFatal, msg, len);
+}
+
+void RouterLogger::dispatch(const detail::LogLevel lvl, LogFunc func,
+    const char* msg, const std::size_t len) {
+  // the same buffer goes to every child, untimestamped children just start
+  // reading it further in
+  const std::size_t skip = timestampLength(msg, len);
+
+  for (auto& route : routes_) {
+    if (route.mask & lvl) {
+      if (route.timestamp || (0 == skip)) {
+        (route.logger->*func)(msg, len);
+      } else {
+        (route.logger->*func)(msg + skip, len - skip);
+      }
+    }
+  }
+}
+
+std::size_t RouterLogger::timestampLength(
+    const char* msg, const std::size_t len) const noexcept {
+  // "YYYY-mm-dd HH:MM:SS.mmm tid", the tid runs up to the next space
+  const std::size_t tidOffset = 24;
+
+  if (!timestamp_ || (len <= tidOffset)) {
+    return 0;
+  }
+
+  for (std::size_t i = tidOffset; i < len; ++i) {
+    if (' ' == msg[i]) {
+      return i;
+    }
+  }
+
+  return 0;
+}
+
+}  // namespace mm
@@ -31,44 +31,38 @@ int StdoutLogger::setup() { return MM_STATUS_OK; }
 int StdoutLogger::teardown() { return MM_STATUS_OK; }
 
 void StdoutLogger::logVerbose(const char* msg, const std::size_t len) {
-  (void)(len);
   if (logToConsole_) {
-    printf("%s\n", msg);
+    detail::writeStdoutLine(msg, len);
   }
 }
 
 void StdoutLogger::logDebug(const char* msg, const std::size_t len) {
-  (void)(len);
   if (logToConsole_) {
-    printf("%s\n", msg);
+    detail::writeStdoutLine(msg, len);
   }
 }
 
 void StdoutLogger::logInfo(const char* msg, const std::size_t len) {
-  (void)(len);
   if (logToConsole_) {
-    printf("%s\n", msg);
+    detail::writeStdoutLine(msg, len);
   }
 }
 
 void StdoutLogger::logWarn(const char* msg, const std::size_t len) {
-  (void)(len);
   if (logToConsole_) {
-    printf("%s\n", msg);
+    detail::writeStdoutLine(msg, len);
   }
 }
 
 void StdoutLogger::logError(const char* msg, const std::size_t len) {
-  (void)(len);
   if (logToConsole_) {
-    printf("%s\n", msg);
+    detail::writeStdoutLine(msg, len);
   }
 }
 
 void StdoutLogger::logFatal(const char* msg, const std::size_t len) {
-  (void)(len);
   if (logToConsole_) {
-    printf("%s\n", msg);
+    detail::writeStdoutLine(msg, len);
   }
 }
 
@@ -0,0 +1,69 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "ThreadPriority.hpp"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace mm {
+
+namespace detail {
+
+namespace {
+
+// From linux/ioprio.h, which glibc does not wrap
+constexpr int IoprioWhoProcess = 1;
+constexpr int IoprioClassShift = 13;
+
+}  // namespace
+
+void setThreadPriority(const char* name, const int nice,
+    const WorkerIoClass ioClass, const int ioLevel) noexcept {
+  // Nice levels are per thread on Linux, addressed by the thread id
+  if (0 != nice) {
+    const id_t tid = static_cast<id_t>(syscall(SYS_gettid));
+    if (0 != setpriority(PRIO_PROCESS, tid, nice)) {
+      std::fprintf(stderr, "Warning: %s: failed to set the nice level: %s\n",
+          name, std::strerror(errno));
+    }
+  }
+
+  // Who 0 with IOPRIO_WHO_PROCESS is the calling thread
+  if (WorkerIoClass_None != ioClass) {
+    const int level  = (WorkerIoClass_Idle == ioClass) ? 0 : ioLevel;
+    const int ioprio = (ioClass << IoprioClassShift) | level;
+    if (0 != syscall(SYS_ioprio_set, IoprioWhoProcess, 0, ioprio)) {
+      std::fprintf(stderr, "Warning: %s: failed to set the I/O priority: %s\n",
+          name, std::strerror(errno));
+    }
+  }
+}
+
+}  // namespace detail
+
+}  // namespace mm
@@ -0,0 +1,307 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "UringFileWriter.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "LoggerStatus.hpp"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define MM_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace mm {
+
+namespace detail {
+
+#ifdef MM_HAVE_IO_URING
+
+namespace {
+
+inline int uringSetup(const unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+inline int uringEnter(const int fd, const unsigned toSubmit,
+    const unsigned minComplete, const unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit,
+      minComplete, flags, nullptr, 0));
+}
+
+inline int uringRegister(const int fd, const unsigned opcode, const void* arg,
+    const unsigned nrArgs) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+inline unsigned* ringField(void* ring, const unsigned offset) {
+  return reinterpret_cast<unsigned*>(static_cast<char*>(ring) + offset);
+}
+
+}  // namespace
+
+#endif  // MM_HAVE_IO_URING
+
+UringFileWriter::UringFileWriter() noexcept
+    : ringFd_(-1),
+      entries_(0),
+      inFlight_(0),
+      toSubmit_(0),
+      fixedBuffers_(false),
+      sqRing_(MAP_FAILED),
+      sqRingSize_(0),
+      cqRing_(MAP_FAILED),
+      cqRingSize_(0),
+      sqes_(MAP_FAILED),
+      sqesSize_(0),
+      sqHead_(nullptr),
+      sqTail_(nullptr),
+      sqMask_(0),
+      sqArray_(nullptr),
+      cqHead_(nullptr),
+      cqTail_(nullptr),
+      cqMask_(0),
+      cqes_(nullptr) {}
+
+UringFileWriter::~UringFileWriter() { close(); }
+
+#ifdef MM_HAVE_IO_URING
+
+int UringFileWriter::setup(const unsigned entries, const int fd) noexcept {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ringFd_ = uringSetup(entries, &params);
+  if (0 > ringFd_) {
+    // ENOSYS on old kernels, EPERM when disabled by sysctl or seccomp
+    return MM_STATUS_ERROR;
+  }
+
+  sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+  }
+
+  sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+  if (MAP_FAILED == sqRing_) {
+    close();
+    return MM_STATUS_ERROR;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cqRing_ = sqRing_;
+  } else {
+    cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+    if (MAP_FAILED == cqRing_) {
+      close();
+      return MM_STATUS_ERROR;
+    }
+  }
+
+  sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_     = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+  if (MAP_FAILED == sqes_) {
+    close();
+    return MM_STATUS_ERROR;
+  }
+
+  sqHead_  = ringField(sqRing_, params.sq_off.head);
+  sqTail_  = ringField(sqRing_, params.sq_off.tail);
+  sqMask_  = *ringField(sqRing_, params.sq_off.ring_mask);
+  sqArray_ = ringField(sqRing_, params.sq_off.array);
+  cqHead_  = ringField(cqRing_, params.cq_off.head);
+  cqTail_  = ringField(cqRing_, params.cq_off.tail);
+  cqMask_  = *ringField(cqRing_, params.cq_off.ring_mask);
+  cqes_    = static_cast<char*>(cqRing_) + params.cq_off.cqes;
+  entries_ = params.sq_entries;
+
+  if (0 > uringRegister(ringFd_, IORING_REGISTER_FILES, &fd, 1)) {
+    close();
+    return MM_STATUS_ERROR;
+  }
+
+  return MM_STATUS_OK;
+}
+
+int UringFileWriter::registerBuffers(
+    const struct iovec* iovecs, const unsigned count) noexcept {
+  if (0 > ringFd_ ||
+      0 > uringRegister(ringFd_, IORING_REGISTER_BUFFERS, iovecs, count)) {
+    // pinned pages count against RLIMIT_MEMLOCK
+    fixedBuffers_ = false;
+    return MM_STATUS_ERROR;
+  }
+
+  fixedBuffers_ = true;
+  return MM_STATUS_OK;
+}
+
+int UringFileWriter::updateFile(const int fd) noexcept {
+  io_uring_files_update update;
+  std::memset(&update, 0, sizeof(update));
+  update.offset = 0;
+  update.fds    = reinterpret_cast<std::uint64_t>(&fd);
+
+  if (0 > ringFd_ ||
+      0 > uringRegister(ringFd_, IORING_REGISTER_FILES_UPDATE, &update, 1)) {
+    return MM_STATUS_ERROR;
+  }
+  return MM_STATUS_OK;
+}
+
+bool UringFileWriter::prepareWrite(const char* data, const std::size_t len,
+    const off_t offset, const int bufIndex,
+    const std::uint64_t userData) noexcept {
+  if (0 > ringFd_ || inFlight_ >= entries_) {
+    return false;
+  }
+
+  // only this thread moves the tail, the kernel moves the head
+  const unsigned tail  = *sqTail_;
+  const unsigned index = tail & sqMask_;
+  io_uring_sqe* sqe    = static_cast<io_uring_sqe*>(sqes_) + index;
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->fd        = 0;  // fixed file 0
+  sqe->flags     = IOSQE_FIXED_FILE;
+  sqe->off       = static_cast<std::uint64_t>(offset);
+  sqe->addr      = reinterpret_cast<std::uint64_t>(data);
+  sqe->len       = static_cast<std::uint32_t>(len);
+  sqe->user_data = userData;
+  if (fixedBuffers_ && 0 <= bufIndex) {
+    sqe->opcode    = IORING_OP_WRITE_FIXED;
+    sqe->buf_index = static_cast<std::uint16_t>(bufIndex);
+  } else {
+    sqe->opcode = IORING_OP_WRITE;
+  }
+
+  sqArray_[index] = index;
+  __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+  ++inFlight_;
+  ++toSubmit_;
+  return true;
+}
+
+int UringFileWriter::submit(const unsigned waitFor) noexcept {
+  if (0 > ringFd_) {
+    return MM_STATUS_ERROR;
+  }
+  if (0 == toSubmit_ && 0 == waitFor) {
+    return MM_STATUS_OK;
+  }
+
+  const unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+  for (;;) {
+    const int n = uringEnter(ringFd_, toSubmit_, waitFor, flags);
+    if (0 <= n) {
+      toSubmit_ -= std::min(toSubmit_, static_cast<unsigned>(n));
+      return MM_STATUS_OK;
+    }
+    if (EINTR != errno) {
+      return MM_STATUS_ERROR;
+    }
+  }
+}
+
+bool UringFileWriter::nextCompletion(
+    std::uint64_t& userData, std::int32_t& result) noexcept {
+  if (0 > ringFd_) {
+    return false;
+  }
+
+  const unsigned head = *cqHead_;
+  if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+
+  const io_uring_cqe* cqe =
+      static_cast<const io_uring_cqe*>(cqes_) + (head & cqMask_);
+  userData = cqe->user_data;
+  result   = cqe->res;
+  __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+  --inFlight_;
+  return true;
+}
+
+#else  // MM_HAVE_IO_URING
+
+int UringFileWriter::setup(const unsigned, const int) noexcept {
+  return MM_STATUS_ERROR;
+}
+
+int UringFileWriter::registerBuffers(
+    const struct iovec*, const unsigned) noexcept {
+  return MM_STATUS_ERROR;
+}
+
+int UringFileWriter::updateFile(const int) noexcept { return MM_STATUS_ERROR; }
+
+bool UringFileWriter::prepareWrite(const char*, const std::size_t, const off_t,
+    const int, const std::uint64_t) noexcept {
+  return false;
+}
+
+int UringFileWriter::submit(const unsigned) noexcept { return MM_STATUS_ERROR; }
+
+bool UringFileWriter::nextCompletion(std::uint64_t&, std::int32_t&) noexcept {
+  return false;
+}
+
+#endif  // MM_HAVE_IO_URING
+
+void UringFileWriter::close() noexcept {
+  if (MAP_FAILED != sqes_) {
+    ::munmap(sqes_, sqesSize_);
+    sqes_ = MAP_FAILED;
+  }
+  if (MAP_FAILED != cqRing_ && cqRing_ != sqRing_) {
+    ::munmap(cqRing_, cqRingSize_);
+  }
+  cqRing_ = MAP_FAILED;
+  if (MAP_FAILED != sqRing_) {
+    ::munmap(sqRing_, sqRingSize_);
+    sqRing_ = MAP_FAILED;
+  }
+  if (0 <= ringFd_) {
+    // unregisters the file and the buffers
+    ::close(ringFd_);
+    ringFd_ = -1;
+  }
+  inFlight_ = 0;
+  toSubmit_ = 0;
+}
+
+}  // namespace detail
+
+}  // namespace mm
@@ -0,0 +1,158 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+// Checks that BasicLogger delivers every message through SyncQueue and
+// AsyncQueue, and that teardown() never runs the sink's teardown while
+// another thread is still writing to it.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "BasicLogger.hpp"
+
+namespace {
+
+constexpr int Threads  = 4;
+constexpr int Messages = 20000;
+
+int failures = 0;
+
+// Counts the writes, and the ones that overlap or follow its teardown
+class CountingSink {
+ public:
+  int setup() noexcept {
+    down_.store(false);
+    return MM_STATUS_OK;
+  }
+
+  int teardown() noexcept {
+    down_.store(true);
+    // a write still in progress would be seen finishing here
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (0 != inside_.load()) {
+      late_.fetch_add(1);
+    }
+    return MM_STATUS_OK;
+  }
+
+  void write(const mm::detail::LogLevel lvl, const char* msg,
+      const std::size_t len) noexcept {
+    (void)lvl;
+    (void)msg;
+    (void)len;
+    inside_.fetch_add(1);
+    if (down_.load()) {
+      late_.fetch_add(1);
+    }
+    written_.fetch_add(1);
+    inside_.fetch_sub(1);
+  }
+
+  int written() const noexcept { return written_.load(); }
+  int late() const noexcept { return late_.load(); }
+
+ private:
+  std::atomic<bool> down_{false};
+  std::atomic<int> inside_{0};
+  std::atomic<int> written_{0};
+  std::atomic<int> late_{0};
+};
+
+template <typename Logger>
+void logFrom(Logger& logger, const int threads) {
+  std::vector<std::thread> producers;
+  for (int t = 0; t < threads; ++t) {
+    producers.emplace_back([&logger, t] {
+      for (int i = 0; i < Messages; ++i) {
+        MM_BASIC_LOG(logger, Info, "thread %d message %d", t, i);
+      }
+    });
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+}
+
+template <typename Logger>
+void checkDelivery(const char* name) {
+  Logger logger(mm::detail::LogLevelCfg_Info);
+  if (MM_STATUS_OK != logger.setup()) {
+    std::fprintf(stderr, "FAIL %s: setup\n", name);
+    ++failures;
+    return;
+  }
+
+  logFrom(logger, Threads);
+  logger.teardown();
+  MM_BASIC_LOG(logger, Info, "after teardown %d", 0);
+
+  const int expected = Threads * Messages;
+  if (logger.sink().written() != expected) {
+    std::fprintf(stderr, "FAIL %s: %d of %d messages written\n", name,
+        logger.sink().written(), expected);
+    ++failures;
+  }
+}
+
+// Tears down while the producers are still logging
+template <typename Logger>
+void checkTeardown(const char* name) {
+  Logger logger(mm::detail::LogLevelCfg_Info);
+  (void)(logger.setup());
+
+  std::thread producers([&logger] { logFrom(logger, Threads); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  logger.teardown();
+  producers.join();
+
+  if (0 != logger.sink().late()) {
+    std::fprintf(stderr, "FAIL %s: %d writes during or after teardown\n",
+        name, logger.sink().late());
+    ++failures;
+  }
+}
+
+using SyncLogger =
+    mm::BasicLogger<mm::PlainFormatter, mm::SyncQueue, CountingSink>;
+// A ring holding every message, none is dropped
+using AsyncLogger = mm::BasicLogger<mm::PlainFormatter,
+    mm::AsyncQueue<128 * 1024, 64>, CountingSink>;
+
+}  // namespace
+
+int main() {
+  checkDelivery<SyncLogger>("SyncQueue");
+  checkTeardown<SyncLogger>("SyncQueue");
+  checkDelivery<AsyncLogger>("AsyncQueue");
+  checkTeardown<AsyncLogger>("AsyncQueue");
+
+  if (0 != failures) {
+    std::fprintf(stderr, "%d BasicLogger checks failed\n", failures);
+    return 1;
+  }
+  std::printf("BasicLogger delivered and tore down cleanly\n");
+  return 0;
+}
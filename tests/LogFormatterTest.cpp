@@ -0,0 +1,219 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+// Checks that formatLog() prints what vsnprintf() prints, byte for byte,
+// including the would-be length and the truncation of short buffers.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "LogFormatter.hpp"
+
+namespace {
+
+// Short buffers check truncation, 0 checks that nothing is written
+const std::size_t BufferSizes[] = {0, 1, 4, 256};
+
+int failures = 0;
+
+template <typename... Args>
+void check(const char* fmt, Args... args) {
+  for (const std::size_t size : BufferSizes) {
+    char expected[256];
+    char actual[256];
+    std::memset(expected, 'x', sizeof(expected));
+    std::memset(actual, 'x', sizeof(actual));
+
+    const int expectedLen = std::snprintf(expected, size, fmt, args...);
+    const int actualLen =
+        mm::detail::formatLogArgs(actual, size, fmt, args...);
+    if (expectedLen != actualLen ||
+        0 != std::memcmp(expected, actual, sizeof(expected))) {
+      std::fprintf(stderr,
+          "FAIL \"%s\" size %zu: vsnprintf %d \"%.*s\", formatLog %d "
+          "\"%.*s\"\n",
+          fmt, size, expectedLen, static_cast<int>(size), expected,
+          actualLen, static_cast<int>(size), actual);
+      ++failures;
+    }
+  }
+}
+
+struct IntCase {
+  const char* fmt;
+  int value;
+};
+
+struct LongLongCase {
+  const char* fmt;
+  long long value;
+};
+
+struct DoubleCase {
+  const char* fmt;
+  double value;
+};
+
+struct StringCase {
+  const char* fmt;
+  const char* value;
+};
+
+const IntCase IntCases[] = {
+    {"%d", 0},
+    {"%d", -42},
+    {"%i", 2147483647},
+    {"%d", -2147483647 - 1},
+    {"%5d|", 42},
+    {"%-5d|", 42},
+    {"%05d", -42},
+    {"%+d", 42},
+    {"% d", 42},
+    {"%.3d", 7},
+    {"%.0d", 0},
+    {"%08.3d", 7},
+    {"%x", 255},
+    {"%X", 255},
+    {"%#x", 255},
+    {"%#x", 0},
+    {"%#o", 8},
+    {"%#o", 0},
+    {"%#.3o", 8},
+    {"%u", -1},
+    {"%hhd", 300},
+    {"%hd", 70000},
+    {"%c", 'a'},
+    {"%3c|", 'a'},
+    {"%-3c|", 'a'},
+    {"100%% %d", 1},
+};
+
+const LongLongCase LongLongCases[] = {
+    {"%lld", -9223372036854775807ll - 1},
+    {"%llx", -1},
+    {"%llu", -1},
+    {"%20lld|", 1234567890123ll},
+    {"%-+20lld|", 1234567890123ll},
+};
+
+const DoubleCase DoubleCases[] = {
+    {"%f", 0.0},
+    {"%f", -0.0},
+    {"%f", 3.14159265358979},
+    {"%.2f", 2.675},
+    {"%.0f", 0.5},
+    {"%.0f", 1.5},
+    {"%#.0f", 1.0},
+    {"%10.3f|", -3.14159},
+    {"%-10.3f|", 3.14159},
+    {"%010.3f", -3.14159},
+    {"%+f", 1.0},
+    {"% f", 1.0},
+    {"%F", 1e300},
+    {"%f", 1e-300},
+    {"%e", 0.0},
+    {"%e", 123456.789},
+    {"%.0e", 1.0},
+    {"%.3e", -0.000123456},
+    {"%g", 0.0},
+    {"%g", 100000.0},
+    {"%g", 1000000.0},
+    {"%g", 0.0001},
+    {"%g", 0.00001},
+    {"%.0g", 123.0},
+    {"%.3g", 1.0},
+    {"%10g|", 1.5},
+    {"%lf", 2.5},
+    {"%#g", 1.0},
+    {"%#.3g", 1.0},
+    {"%#.0e", 1.0},
+    {"%#e", 1.0},
+    {"%f", 1.0 / 0.0},
+    {"%5f|", -1.0 / 0.0},
+    {"%e", 0.0 / 0.0},
+    {"%08f", 1.0 / 0.0},
+};
+
+const StringCase StringCases[] = {
+    {"%s", "hello"},
+    {"%s", ""},
+    {"%10s|", "hello"},
+    {"%-10s|", "hello"},
+    {"%.3s", "hello"},
+    {"%.10s", "hello"},
+    {"%8.2s|", "hello"},
+    {"%s", nullptr},
+    {"%.3s", nullptr},
+    {"%10s|", nullptr},
+    {"%p", nullptr},
+    {"%20p|", nullptr},
+};
+
+}  // namespace
+
+int main() {
+  for (const IntCase& c : IntCases) {
+    check(c.fmt, c.value);
+  }
+  for (const LongLongCase& c : LongLongCases) {
+    check(c.fmt, c.value);
+  }
+  for (const DoubleCase& c : DoubleCases) {
+    check(c.fmt, c.value);
+  }
+  for (const StringCase& c : StringCases) {
+    if (std::strstr(c.fmt, "%p")) {
+      check(c.fmt, static_cast<const void*>(c.value));
+    } else {
+      check(c.fmt, c.value);
+    }
+  }
+
+  int local = 0;
+  check("%p", static_cast<void*>(&local));
+  check("%-24p|", static_cast<void*>(&local));
+  check("%#p", static_cast<void*>(&local));
+  check("%024p|", static_cast<void*>(&local));
+  check("%+p", static_cast<void*>(&local));
+  check("% p", static_cast<void*>(&local));
+  check("%.20p", static_cast<void*>(&local));
+  check("%012p", reinterpret_cast<void*>(0x1234));
+  check("%+p", reinterpret_cast<void*>(0x1234));
+  check("%+p", static_cast<void*>(nullptr));
+  check("%zu %zd %jd %td", std::size_t{42}, static_cast<ssize_t>(-42),
+      static_cast<intmax_t>(-7), static_cast<ptrdiff_t>(9));
+  check("%s=%d %s=%.2f %s", "a", 1, "b", 2.5, "end");
+  check("[%d] call site %s:%04d", 1, "file.cpp", 12);
+
+  // a long literal, truncated by every short buffer
+  const std::string text(200, 'y');
+  check("%s%d", text.c_str(), 5);
+
+  if (0 != failures) {
+    std::fprintf(stderr, "%d formatLog() mismatches\n", failures);
+    return 1;
+  }
+  std::printf("formatLog() matches vsnprintf()\n");
+  return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+// Checks that the log tools find the time, level and tokens of the records
+// of every writer: outputLog(), glog and the per worker files of OptimizedGLog.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "LogBloom.hpp"
+#include "LogRecord.hpp"
+
+namespace {
+
+struct RecordCase {
+  const char* name;
+  std::string line;
+  const char* key;    // Expected lineKey(), null if none
+  char level;         // Expected lineLevel()
+  const char* token;  // Expected start of the text at logTokenStart()
+};
+
+std::string callSite(const char level) {
+  char site[64];
+  std::snprintf(site, sizeof(site), " %40.40s %04d %c: ", "app::run()", 12,
+      level);
+  return site;
+}
+
+const char* const Stamp = "2026-10-18 17:20:39.878";
+const char* const Shard = "0000064b064cabf2 ";
+
+int failures = 0;
+
+void check(const RecordCase& c) {
+  const char* line      = c.line.c_str();
+  const std::size_t len = c.line.size();
+
+  char key[mm::tools::TimeKeyLen];
+  const bool hasKey = mm::tools::lineKey(line, len, key);
+  if (hasKey != (nullptr != c.key) ||
+      (hasKey && 0 != std::memcmp(key, c.key, sizeof(key)))) {
+    std::fprintf(stderr, "FAIL %s: lineKey \"%.*s\"\n", c.name,
+        hasKey ? static_cast<int>(sizeof(key)) : 0, key);
+    ++failures;
+  }
+
+  const char level = mm::tools::lineLevel(line, len);
+  if (level != c.level) {
+    std::fprintf(stderr, "FAIL %s: lineLevel '%c'\n", c.name,
+        level ? level : '0');
+    ++failures;
+  }
+
+  const std::size_t start = mm::detail::logTokenStart(line, len);
+  if (0 != std::strncmp(line + start, c.token, std::strlen(c.token))) {
+    std::fprintf(stderr, "FAIL %s: logTokenStart \"%s\"\n", c.name,
+        line + start);
+    ++failures;
+  }
+}
+
+}  // namespace
+
+int main() {
+  const std::string record =
+      std::string(Stamp) + " 04359" + callSite('E') + "disk full";
+  const std::string bare = callSite('W') + "no timestamp";
+
+  const RecordCase cases[] = {
+      {"outputLog", record, Stamp, 'E', "app::run()"},
+      {"outputLog without timestamp", bare, nullptr, 'W', bare.c_str()},
+      {"glog", "I20261018 17:20:39.878123  4359 app.cpp:12] started",
+          Stamp, 'I', "app.cpp"},
+      {"worker file", Shard + record, Stamp, 'E', "app::run()"},
+      {"worker file without timestamp", Shard + bare, nullptr, 'W',
+          bare.c_str()},
+      {"continuation", "  at frame 3", nullptr, '\0', "  at frame 3"},
+  };
+
+  for (const RecordCase& c : cases) {
+    check(c);
+  }
+
+  if (0 != failures) {
+    std::fprintf(stderr, "%d record checks failed\n", failures);
+    return 1;
+  }
+  std::printf("records of every layout parsed\n");
+  return 0;
+}
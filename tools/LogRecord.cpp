@@ -0,0 +1,360 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#include "LogRecord.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+
+#include "LogShard.hpp"
+
+#ifdef MM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mm {
+
+namespace tools {
+
+namespace {
+
+// Width of the "%40.40s" call site field of outputLog()
+constexpr std::size_t CallSiteWidth = 40;
+
+constexpr const char* LevelLetters = "VDIWEF";
+
+bool isTimeKey(const char* line, const std::size_t len) noexcept {
+  return len >= TimeKeyLen && '-' == line[4] && '-' == line[7] &&
+         ' ' == line[10] && ':' == line[13] && ':' == line[16] &&
+         '.' == line[19];
+}
+
+bool isGlogKey(const char* line, const std::size_t len) noexcept {
+  return len >= 22 && nullptr != std::strchr("IWEF", line[0]) &&
+         '\0' != line[0] && ' ' == line[9] && ':' == line[12] &&
+         ':' == line[15] && '.' == line[18];
+}
+
+// Skips the key of the per worker files of OptimizedGLog, see LogShard.hpp
+void skipShardKey(const char*& line, std::size_t& len) noexcept {
+  std::uint64_t key = 0;
+  if (detail::parseLogShardKey(line, len, key)) {
+    line += detail::LogShardKeyLen;
+    len -= detail::LogShardKeyLen;
+  }
+}
+
+std::size_t skipDigits(
+    const char* line, const std::size_t len, std::size_t pos) noexcept {
+  while (pos < len && std::isdigit(static_cast<unsigned char>(line[pos]))) {
+    ++pos;
+  }
+  return pos;
+}
+
+}  // namespace
+
+bool parseTime(const char* text, std::int64_t& ns) noexcept {
+  struct tm tm;
+  std::memset(&tm, 0, sizeof(tm));
+  const char* rest = ::strptime(text, "%Y-%m-%d %H:%M:%S", &tm);
+  if (!rest) {
+    return false;
+  }
+
+  std::int64_t ms = 0;
+  if ('.' == *rest) {
+    char* end = nullptr;
+    ms        = std::strtol(rest + 1, &end, 10);
+    if (end != rest + 4) {
+      return false;
+    }
+    rest = end;
+  }
+  if ('\0' != *rest) {
+    return false;
+  }
+
+  tm.tm_isdst       = -1;
+  const time_t secs = ::mktime(&tm);
+  ns = (static_cast<std::int64_t>(secs) * 1000 + ms) * 1000000;
+  return true;
+}
+
+std::string timeKey(const std::int64_t ns) {
+  const time_t secs = static_cast<time_t>(ns / 1000000000);
+  struct tm tm;
+  ::localtime_r(&secs, &tm);
+
+  char key[TimeKeyLen + 1];
+  const std::size_t len =
+      std::strftime(key, sizeof(key), "%Y-%m-%d %H:%M:%S", &tm);
+  std::snprintf(key + len, sizeof(key) - len, ".%03d",
+      static_cast<int>(ns / 1000000 % 1000));
+  return std::string(key, TimeKeyLen);
+}
+
+bool lineKey(const char* line, std::size_t len, char* key) noexcept {
+  skipShardKey(line, len);
+  if (isTimeKey(line, len)) {
+    std::memcpy(key, line, TimeKeyLen);
+    return true;
+  }
+
+  if (isGlogKey(line, len)) {
+    // glog lines carry no date separators, rebuild the key around them
+    std::memcpy(key, line + 1, 4);
+    key[4] = '-';
+    std::memcpy(key + 5, line + 5, 2);
+    key[7] = '-';
+    std::memcpy(key + 8, line + 7, 2);
+    std::memcpy(key + 10, line + 9, 13);  // " hh:mm:ss.mmm"
+    return true;
+  }
+
+  return false;
+}
+
+char lineLevel(const char* line, std::size_t len) noexcept {
+  skipShardKey(line, len);
+  std::size_t pos = 0;
+  if (isTimeKey(line, len)) {
+    // " tid" follows the time
+    pos = skipDigits(line, len, TimeKeyLen + 1);
+  } else if (isGlogKey(line, len)) {
+    return line[0];
+  } else if (0 == len || ' ' != line[0]) {
+    return '\0';
+  }
+
+  // " %40.40s %04d %c: "
+  pos = skipDigits(line, len, pos + CallSiteWidth + 2);
+  if (pos + 2 < len && ' ' == line[pos] && ':' == line[pos + 2] &&
+      '\0' != line[pos + 1] && std::strchr(LevelLetters, line[pos + 1])) {
+    return line[pos + 1];
+  }
+  return '\0';
+}
+
+int levelRank(const char level) noexcept {
+  const char* found =
+      '\0' != level ? std::strchr(LevelLetters, level) : nullptr;
+  return found ? static_cast<int>(found - LevelLetters) : -1;
+}
+
+bool endsWith(const std::string& name, const char* suffix) noexcept {
+  const std::size_t len = std::strlen(suffix);
+  return name.size() >= len &&
+         0 == name.compare(name.size() - len, len, suffix);
+}
+
+std::vector<detail::LogIndexEntry> readIndex(const std::string& path) {
+  std::vector<detail::LogIndexEntry> entries;
+  FILE* file = std::fopen(path.c_str(), "rb");
+  if (!file) {
+    return entries;
+  }
+
+  detail::LogIndexHeader header;
+  if (1 == std::fread(&header, sizeof(header), 1, file) &&
+      0 == std::memcmp(
+               header.magic, detail::LogIndexMagic, sizeof(header.magic)) &&
+      detail::LogIndexVersion == header.version) {
+    detail::LogIndexEntry entry;
+    while (1 == std::fread(&entry, sizeof(entry), 1, file)) {
+      entries.push_back(entry);
+    }
+  } else {
+    std::fprintf(stderr, "Warning: ignoring invalid index %s\n", path.c_str());
+  }
+  std::fclose(file);
+  return entries;
+}
+
+void indexRange(const std::vector<detail::LogIndexEntry>& index,
+    const std::int64_t fromNs, const std::int64_t toNs, std::uint64_t& start,
+    std::uint64_t& end) noexcept {
+  const auto later = [](const std::int64_t ns,
+                         const detail::LogIndexEntry& entry) {
+    return ns < entry.wallNs;
+  };
+
+  start      = 0;
+  end        = std::numeric_limits<std::uint64_t>::max();
+  auto first = std::upper_bound(index.begin(), index.end(), fromNs, later);
+  if (first != index.begin()) {
+    start = std::prev(first)->offset;
+  }
+  auto last =
+      std::upper_bound(index.begin(), index.end(), toNs + RangeSlackNs, later);
+  if (last != index.end()) {
+    end = last->offset;
+  }
+}
+
+LogFileReader::LogFileReader() noexcept
+    : path_(),
+      fd_(-1),
+      offset_(0),
+      end_(0),
+      compressed_(false),
+      stream_(nullptr),
+      raw_(),
+      data_() {}
+
+LogFileReader::~LogFileReader() { close(); }
+
+bool LogFileReader::open(const std::string& path, const std::uint64_t start,
+    const std::uint64_t end) {
+  close();
+  path_       = path;
+  offset_     = start;
+  end_        = end;
+  compressed_ = endsWith(path, ".gz");
+
+#ifndef MM_HAVE_ZLIB
+  if (compressed_) {
+    std::fprintf(
+        stderr, "Error: built without zlib, can not read %s\n", path.c_str());
+    return false;
+  }
+#endif
+
+  fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (0 > fd_ || 0 > ::lseek(fd_, static_cast<off_t>(start), SEEK_SET)) {
+    std::fprintf(stderr, "Error: can not read %s: %s\n", path.c_str(),
+        std::strerror(errno));
+    close();
+    return false;
+  }
+
+  raw_.reset(new char[ChunkSize]);
+#ifdef MM_HAVE_ZLIB
+  if (compressed_) {
+    z_stream* stream = new z_stream;
+    std::memset(stream, 0, sizeof(*stream));
+    // 15 + 32: detect the gzip header of every member
+    if (Z_OK != inflateInit2(stream, 15 + 32)) {
+      delete stream;
+      close();
+      return false;
+    }
+    stream_ = stream;
+    data_.reset(new char[ChunkSize]);
+  }
+#endif
+  return true;
+}
+
+ssize_t LogFileReader::readRaw(char* buf, const std::size_t len) {
+  if (offset_ >= end_) {
+    return 0;
+  }
+
+  const std::size_t want =
+      static_cast<std::size_t>(std::min<std::uint64_t>(len, end_ - offset_));
+  ssize_t n;
+  do {
+    n = ::read(fd_, buf, want);
+  } while (0 > n && EINTR == errno);
+
+  if (0 > n) {
+    std::fprintf(stderr, "Error: can not read %s: %s\n", path_.c_str(),
+        std::strerror(errno));
+    return -1;
+  }
+  offset_ += static_cast<std::uint64_t>(n);
+  return n;
+}
+
+ssize_t LogFileReader::read(const char*& data) {
+  if (0 > fd_) {
+    return -1;
+  }
+
+  if (!compressed_) {
+    data = raw_.get();
+    return readRaw(raw_.get(), ChunkSize);
+  }
+
+#ifdef MM_HAVE_ZLIB
+  z_stream* stream = static_cast<z_stream*>(stream_);
+  for (;;) {
+    if (0 == stream->avail_in) {
+      const ssize_t n = readRaw(raw_.get(), ChunkSize);
+      if (0 >= n) {
+        return n;
+      }
+      stream->next_in  = reinterpret_cast<Bytef*>(raw_.get());
+      stream->avail_in = static_cast<uInt>(n);
+    }
+
+    stream->next_out  = reinterpret_cast<Bytef*>(data_.get());
+    stream->avail_out = static_cast<uInt>(ChunkSize);
+    const int ec      = inflate(stream, Z_NO_FLUSH);
+    if (Z_STREAM_END == ec) {
+      // the next batch starts a new member
+      (void)(inflateReset(stream));
+    } else if (Z_OK != ec && Z_BUF_ERROR != ec) {
+      std::fprintf(stderr, "Error: %s is corrupt, %s\n", path_.c_str(),
+          stream->msg ? stream->msg : "inflate failed");
+      return -1;
+    }
+
+    const std::size_t n = ChunkSize - stream->avail_out;
+    if (n > 0) {
+      data = data_.get();
+      return static_cast<ssize_t>(n);
+    }
+  }
+#else
+  return -1;
+#endif
+}
+
+void LogFileReader::close() noexcept {
+#ifdef MM_HAVE_ZLIB
+  if (stream_) {
+    z_stream* stream = static_cast<z_stream*>(stream_);
+    (void)(inflateEnd(stream));
+    delete stream;
+  }
+#endif
+  stream_ = nullptr;
+  if (0 <= fd_) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+}  // namespace tools
+
+}  // namespace mm
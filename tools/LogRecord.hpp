@@ -0,0 +1,150 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+#ifndef TOOLS_LOGRECORD_HPP_
+#define TOOLS_LOGRECORD_HPP_
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DisallowCopy.hpp"
+#include "LogIndex.hpp"
+
+namespace mm {
+
+namespace tools {
+
+// A record may be stamped by its thread this long before it is appended,
+// so time ranges are read this far past their end
+constexpr std::int64_t RangeSlackNs = 1000000000;
+
+// "YYYY-mm-dd HH:MM:SS.mmm", the start of the records outputLog() formats
+constexpr std::size_t TimeKeyLen = 23;
+
+/**
+ * @brief Parses "YYYY-mm-dd HH:MM:SS[.mmm]" in local time
+ */
+bool parseTime(const char* text, std::int64_t& ns) noexcept;
+
+/**
+ * @brief Time as a key comparable with lineKey()
+ */
+std::string timeKey(const std::int64_t ns);
+
+/**
+ * @brief Time of a line as a key comparable with timeKey()
+ *
+ * Takes the "YYYY-mm-dd HH:MM:SS.mmm" prefix of outputLog() and glog's
+ * "Lyyyymmdd hh:mm:ss.uuuuuu" one, behind the key of a per worker file
+ * record.
+ *
+ * @return false for a line without either, e.g. a continuation line
+ */
+bool lineKey(const char* line, const std::size_t len, char* key) noexcept;
+
+/**
+ * @brief Level letter of a line, one of "VDIWEF"
+ *
+ * Follows the "date time.ms tid" prefix and the " %40.40s %04d %c: " call
+ * site of outputLog(), with or without the timestamp, or is the first
+ * letter of a glog line. The key of a per worker file record is skipped.
+ *
+ * @return '\0' for a line without a level
+ */
+char lineLevel(const char* line, const std::size_t len) noexcept;
+
+/**
+ * @brief Rank of a level letter, -1 if it is none
+ */
+int levelRank(const char level) noexcept;
+
+bool endsWith(const std::string& name, const char* suffix) noexcept;
+
+/**
+ * @brief Entries of the time index of a segment, empty if it has none
+ */
+std::vector<detail::LogIndexEntry> readIndex(const std::string& path);
+
+/**
+ * @brief Bytes of a segment covering [fromNs, toNs] by its time index
+ *
+ * From the last entry not after fromNs to the first one past toNs plus
+ * RangeSlackNs. Without entries, the whole file.
+ */
+void indexRange(const std::vector<detail::LogIndexEntry>& index,
+    const std::int64_t fromNs, const std::int64_t toNs, std::uint64_t& start,
+    std::uint64_t& end) noexcept;
+
+/**
+ * @brief Streams a part of a log file, inflating gzip segments
+ *
+ * A .gz file is read from start as concatenated gzip members, so start must
+ * be 0 or a member boundary such as an index offset.
+ */
+class LogFileReader {
+ public:
+  static constexpr std::size_t ChunkSize = 1 << 20;
+
+  LogFileReader() noexcept;
+  ~LogFileReader();
+
+  /**
+   * @return false if the file can not be read, the reason is printed
+   */
+  bool open(const std::string& path, const std::uint64_t start = 0,
+      const std::uint64_t end = std::numeric_limits<std::uint64_t>::max());
+
+  /**
+   * @brief Next chunk of the file data, valid until the next call
+   *
+   * @return its length, 0 at the end or -1 on error
+   */
+  ssize_t read(const char*& data);
+
+  void close() noexcept;
+
+ private:
+  ssize_t readRaw(char* buf, const std::size_t len);
+
+  std::string path_;
+  int fd_;
+  std::uint64_t offset_;
+  std::uint64_t end_;
+  bool compressed_;
+  void* stream_;  // z_stream of a .gz file
+  std::unique_ptr<char[]> raw_;
+  std::unique_ptr<char[]> data_;
+
+  MM_DISALLOW_COPY_AND_MOVE(LogFileReader)
+};
+
+}  // namespace tools
+
+}  // namespace mm
+
+#endif  // TOOLS_LOGRECORD_HPP_
@@ -0,0 +1,292 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+// mmlog-find: lists the log files that mention all the given words, e.g.
+// a request id. The token Bloom filters the maintainer writes next to the
+// rotated segments (--logBloomIndex) rule out most segments without reading
+// them, so a lookup reads the segments that match rather than the whole
+// retention. Segments without a filter, such as the active ones, are read.
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "LogBloom.hpp"
+#include "LogRecord.hpp"
+
+namespace {
+
+using namespace mm::tools;
+
+struct Token {
+  std::string text;
+  std::uint64_t hash;
+};
+
+struct FindStats {
+  std::size_t files    = 0;
+  std::size_t filtered = 0;  // Ruled out by their Bloom filter
+  std::size_t read     = 0;
+  std::size_t matched  = 0;
+};
+
+void usage(const char* prog, const int ecode) {
+  std::fprintf(stderr,
+      "%s --word=<word>... [options] <file|dir>...\n"
+      "  Lists the log files with lines holding all the tokens of the words,\n"
+      "  a token being a run of letters, digits and '_'. Directories are\n"
+      "  searched for segments, their .bloom filters are used when present.\n"
+      "  [--lines]: print the matching lines instead\n"
+      "  [--verbose]: print how many files the filters ruled out\n",
+      prog);
+  std::exit(ecode);
+}
+
+/**
+ * @return false if the filter rules out one of the tokens, true if it
+ * holds them all or can not be read
+ */
+bool bloomMayContain(
+    const std::string& path, const std::vector<Token>& tokens) {
+  FILE* file = std::fopen(mm::detail::logBloomPath(path).c_str(), "rb");
+  if (!file) {
+    return true;
+  }
+
+  mm::detail::LogBloomHeader header;
+  bool ok = 1 == std::fread(&header, sizeof(header), 1, file) &&
+            0 == std::memcmp(header.magic, mm::detail::LogBloomMagic,
+                     sizeof(header.magic)) &&
+            mm::detail::LogBloomVersion == header.version &&
+            mm::detail::LogBloomHashes == header.hashes && header.bits >= 64 &&
+            0 == (header.bits & (header.bits - 1));
+
+  mm::detail::LogBloomFilter filter(ok ? header.bits : 64);
+  std::vector<std::uint64_t>& words = filter.words();
+  ok = ok && words.size() == std::fread(words.data(), sizeof(words[0]),
+                                 words.size(), file);
+  std::fclose(file);
+  if (!ok) {
+    std::fprintf(stderr, "Warning: ignoring invalid filter of %s\n",
+        path.c_str());
+    return true;
+  }
+
+  return std::all_of(tokens.begin(), tokens.end(),
+      [&filter](const Token& token) { return filter.contains(token.hash); });
+}
+
+/**
+ * @brief Whether the line holds all the tokens, taken the way the filters
+ * take them
+ */
+bool lineMatches(
+    const char* line, const std::size_t len, const std::vector<Token>& tokens) {
+  std::vector<bool> found(tokens.size(), false);
+  std::size_t missing     = tokens.size();
+  const std::size_t start = mm::detail::logTokenStart(line, len);
+  mm::detail::forEachLogToken(line + start, len - start,
+      [&](const char* token, const std::size_t tokenLen) {
+        for (std::size_t i = 0; i < tokens.size(); ++i) {
+          if (!found[i] && tokens[i].text.size() == tokenLen &&
+              0 == std::memcmp(tokens[i].text.data(), token, tokenLen)) {
+            found[i] = true;
+            --missing;
+          }
+        }
+      });
+  return 0 == missing;
+}
+
+/**
+ * @brief Reads a file for lines holding the tokens
+ *
+ * @return false if the file can not be read
+ */
+bool scanFile(const std::string& path, const std::vector<Token>& tokens,
+    const bool lines, bool& matched) {
+  LogFileReader reader;
+  if (!reader.open(path)) {
+    return false;
+  }
+
+  // the longest token is the rarest, look for it before splitting lines
+  const std::string& rare =
+      std::max_element(tokens.begin(), tokens.end(),
+          [](const Token& a, const Token& b) {
+            return a.text.size() < b.text.size();
+          })->text;
+
+  std::string pending;
+  const char* data = nullptr;
+  ssize_t n        = 0;
+  matched          = false;
+  while ((lines || !matched) && 0 < (n = reader.read(data))) {
+    pending.append(data, static_cast<std::size_t>(n));
+    const std::size_t complete = pending.rfind('\n') + 1;
+    const char* begin          = pending.data();
+    const char* end            = begin + complete;
+
+    for (const char* pos = begin; pos < end;) {
+      const char* hit = static_cast<const char*>(::memmem(pos,
+          static_cast<std::size_t>(end - pos), rare.data(), rare.size()));
+      if (!hit) {
+        break;
+      }
+      const char* newline = static_cast<const char*>(
+          ::memrchr(pos, '\n', static_cast<std::size_t>(hit - pos)));
+      const char* line    = newline ? newline + 1 : pos;
+      // complete lines only, a newline follows the hit
+      const std::size_t rest = static_cast<std::size_t>(end - hit);
+      const char* next =
+          static_cast<const char*>(std::memchr(hit, '\n', rest)) + 1;
+
+      if (lineMatches(line, static_cast<std::size_t>(next - line), tokens)) {
+        matched = true;
+        if (!lines) {
+          break;
+        }
+        std::fwrite(path.data(), 1, path.size(), stdout);
+        std::fputc(':', stdout);
+        std::fwrite(line, 1, static_cast<std::size_t>(next - line), stdout);
+      }
+      pos = next;
+    }
+    pending.erase(0, complete);
+  }
+
+  if (!pending.empty() && (lines || !matched) &&
+      lineMatches(pending.data(), pending.size(), tokens)) {
+    matched = true;
+    if (lines) {
+      std::printf("%s:%s\n", path.c_str(), pending.c_str());
+    }
+  }
+  return 0 <= n;
+}
+
+void listDir(const std::string& dir, std::vector<std::string>& files) {
+  DIR* handle = ::opendir(dir.c_str());
+  if (!handle) {
+    std::fprintf(stderr, "Error: can not list %s\n", dir.c_str());
+    return;
+  }
+
+  const std::string prefix = dir.back() == '/' ? dir : dir + '/';
+  std::vector<std::string> names;
+  while (const struct dirent* entry = ::readdir(handle)) {
+    const std::string name = entry->d_name;
+    struct stat st;
+    // segments only, not their sidecars or the symlinks to the active ones
+    if (0 == ::lstat((prefix + name).c_str(), &st) && S_ISREG(st.st_mode) &&
+        !endsWith(name, mm::detail::LogBloomSuffix) &&
+        !endsWith(name, mm::detail::LogIndexSuffix) &&
+        !endsWith(name, ".tmp")) {
+      names.push_back(prefix + name);
+    }
+  }
+  ::closedir(handle);
+
+  std::sort(names.begin(), names.end());
+  files.insert(files.end(), names.begin(), names.end());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<Token> tokens;
+  bool lines   = false;
+  bool verbose = false;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (std::strstr(arg, "--word=") == arg) {
+      const char* word = std::strchr(arg, '=') + 1;
+      mm::detail::forEachLogToken(word, std::strlen(word),
+          [&tokens](const char* token, const std::size_t len) {
+            tokens.push_back({std::string(token, len),
+                mm::detail::logTokenHash(token, len)});
+          });
+    } else if (std::strcmp(arg, "--lines") == 0) {
+      lines = true;
+    } else if (std::strcmp(arg, "--verbose") == 0) {
+      verbose = true;
+    } else if (std::strcmp(arg, "--help") == 0) {
+      usage(argv[0], 0);
+    } else if ('-' == arg[0]) {
+      std::fprintf(stderr, "Unknown option: %s\n", arg);
+      usage(argv[0], 1);
+    } else {
+      struct stat st;
+      if (0 == ::stat(arg, &st) && S_ISDIR(st.st_mode)) {
+        listDir(arg, files);
+      } else {
+        files.push_back(arg);
+      }
+    }
+  }
+
+  if (tokens.empty()) {
+    std::fprintf(stderr, "No token of at least %zu characters to find\n",
+        mm::detail::LogBloomMinToken);
+    usage(argv[0], 1);
+  }
+  if (files.empty()) {
+    usage(argv[0], 1);
+  }
+
+  int ecode = 0;
+  FindStats stats;
+  for (const auto& file : files) {
+    ++stats.files;
+    if (!bloomMayContain(file, tokens)) {
+      ++stats.filtered;
+      continue;
+    }
+
+    ++stats.read;
+    bool matched = false;
+    if (!scanFile(file, tokens, lines, matched)) {
+      ecode = 2;
+    } else if (matched) {
+      ++stats.matched;
+      if (!lines) {
+        std::printf("%s\n", file.c_str());
+      }
+    }
+  }
+  std::fflush(stdout);
+
+  if (verbose) {
+    std::fprintf(stderr,
+        "%zu files: %zu ruled out by their filter, %zu read, %zu matched\n",
+        stats.files, stats.filtered, stats.read, stats.matched);
+  }
+  return ecode;
+}
@@ -0,0 +1,624 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+// mmlog-grep: prints the records of log files that contain a literal and
+// match level and time predicates. Plain files are memory mapped and split
+// into chunks searched by all cores with AVX2 or SSE4.2 when the CPU has
+// them. The record layout of outputLog() is used to check levels at a fixed
+// spot, to binary search time ranges instead of reading the whole file, and
+// to take time ranges from the index of --fileIndexKb. Compressed segments
+// are inflated and searched on one thread.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MM_HAVE_X86_SIMD
+#endif
+
+#include "LogRecord.hpp"
+
+namespace {
+
+using namespace mm::tools;
+
+// Bytes of a plain file searched by a thread at a time
+constexpr std::size_t ChunkSize = 32 << 20;
+
+// How far to look for a record at the start of a file before giving up on
+// binary searching its times
+constexpr std::size_t ProbeSize = 4096;
+
+using FindFunc = const char* (*)(const char* hay, const char* end,
+    const char* needle, const std::size_t len);
+
+struct Predicate {
+  std::string text;  // Literal to find, empty for any
+  int minRank  = -1;  // levelRank() of the lowest level, -1 for any
+  bool hasFrom = false;
+  bool hasTo   = false;
+  std::int64_t fromNs = std::numeric_limits<std::int64_t>::min();
+  std::int64_t toNs = std::numeric_limits<std::int64_t>::max() - RangeSlackNs;
+  std::string fromKey;  // Records below are skipped
+  std::string toKey;    // Records above are skipped
+};
+
+void usage(const char* prog, const int ecode) {
+  std::fprintf(stderr,
+      "%s [options] <file>...\n"
+      "  Prints the lines of the files that match all given predicates.\n"
+      "  [--text=<literal>]: contain the literal, case sensitive\n"
+      "  [--level=<V|D|I|W|E|F>]: at or above the level\n"
+      "  [--from=<time>]: stamped at or after YYYY-mm-dd HH:MM:SS[.mmm]\n"
+      "  [--to=<time>]: stamped at or before YYYY-mm-dd HH:MM:SS[.mmm]\n"
+      "  [--count]: print the number of matching lines instead\n"
+      "  [--threads=<n>]: search threads, default one per core\n"
+      "  [--simd=<auto|avx2|sse4.2|scalar>]: substring search, default auto\n",
+      prog);
+  std::exit(ecode);
+}
+
+const char* findScalar(const char* hay, const char* end, const char* needle,
+    const std::size_t len) {
+  return static_cast<const char*>(
+      ::memmem(hay, static_cast<std::size_t>(end - hay), needle, len));
+}
+
+#ifdef MM_HAVE_X86_SIMD
+/*
+ * The vector searches compare the first and the last byte of the needle
+ * against a block of candidate positions at once and only memcmp() the
+ * candidates whose both ends match, which in log text are few. The tail
+ * shorter than a block is left to memmem().
+ */
+__attribute__((target("avx2"))) const char* findAvx2(const char* hay,
+    const char* end, const char* needle, const std::size_t len) {
+  if (1 == len) {
+    return static_cast<const char*>(
+        std::memchr(hay, needle[0], static_cast<std::size_t>(end - hay)));
+  }
+
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last  = _mm256_set1_epi8(needle[len - 1]);
+  const char* pos     = hay;
+  for (; end - pos >= static_cast<std::ptrdiff_t>(len - 1 + 32); pos += 32) {
+    const __m256i head =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+    const __m256i tail =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos + len - 1));
+    std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, head),
+            _mm256_cmpeq_epi8(last, tail))));
+    while (mask) {
+      const int bit = __builtin_ctz(mask);
+      if (0 == std::memcmp(pos + bit + 1, needle + 1, len - 2)) {
+        return pos + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return findScalar(pos, end, needle, len);
+}
+
+__attribute__((target("sse4.2"))) const char* findSse42(const char* hay,
+    const char* end, const char* needle, const std::size_t len) {
+  if (1 == len) {
+    return static_cast<const char*>(
+        std::memchr(hay, needle[0], static_cast<std::size_t>(end - hay)));
+  }
+
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last  = _mm_set1_epi8(needle[len - 1]);
+  const char* pos     = hay;
+  for (; end - pos >= static_cast<std::ptrdiff_t>(len - 1 + 16); pos += 16) {
+    const __m128i head =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+    const __m128i tail =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos + len - 1));
+    std::uint32_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(first, head),
+            _mm_cmpeq_epi8(last, tail))));
+    while (mask) {
+      const int bit = __builtin_ctz(mask);
+      if (0 == std::memcmp(pos + bit + 1, needle + 1, len - 2)) {
+        return pos + bit;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return findScalar(pos, end, needle, len);
+}
+#endif
+
+/**
+ * @return nullptr if the CPU lacks the requested instructions
+ */
+FindFunc selectFind(const std::string& simd) {
+#ifdef MM_HAVE_X86_SIMD
+  __builtin_cpu_init();
+  const bool avx2  = __builtin_cpu_supports("avx2");
+  const bool sse42 = __builtin_cpu_supports("sse4.2");
+  if ("avx2" == simd) {
+    return avx2 ? findAvx2 : nullptr;
+  }
+  if ("sse4.2" == simd) {
+    return sse42 ? findSse42 : nullptr;
+  }
+  if ("auto" == simd) {
+    return avx2 ? findAvx2 : (sse42 ? findSse42 : findScalar);
+  }
+#else
+  if ("auto" == simd) {
+    return findScalar;
+  }
+#endif
+  return "scalar" == simd ? findScalar : nullptr;
+}
+
+/**
+ * @brief Searches blocks of complete lines for the records matching a
+ * Predicate
+ */
+class Matcher {
+ public:
+  Matcher(const Predicate& pred, FindFunc find, const std::string& label)
+      : pred_(pred), find_(find), label_(label) {}
+
+  /**
+   * @brief Appends the matching lines of [begin, end) to out, or only
+   * counts them if out is nullptr
+   */
+  void scan(const char* begin, const char* end, std::string* out,
+      std::uint64_t& count) const {
+    const char* pos = begin;
+    while (pos < end) {
+      const char* line = pos;
+      const char* hit  = pos;
+      if (!pred_.text.empty()) {
+        // the literal first, it rules out most lines without looking at them
+        hit = find_(pos, end, pred_.text.data(), pred_.text.size());
+        if (!hit) {
+          break;
+        }
+        const char* newline = static_cast<const char*>(
+            ::memrchr(pos, '\n', static_cast<std::size_t>(hit - pos)));
+        line = newline ? newline + 1 : pos;
+      }
+
+      const char* newline = static_cast<const char*>(
+          std::memchr(hit, '\n', static_cast<std::size_t>(end - hit)));
+      const char* next    = newline ? newline + 1 : end;
+      if ('\0' == line[0]) {
+        // the zeros behind the data of a crashed mmap segment
+        break;
+      }
+
+      if (matches(line, static_cast<std::size_t>(next - line))) {
+        ++count;
+        if (out) {
+          out->append(label_);
+          out->append(line, static_cast<std::size_t>(next - line));
+          if (!newline) {
+            out->push_back('\n');
+          }
+        }
+      }
+      pos = next;
+    }
+  }
+
+ private:
+  bool matches(const char* line, const std::size_t len) const noexcept {
+    if (0 <= pred_.minRank &&
+        levelRank(lineLevel(line, len)) < pred_.minRank) {
+      return false;
+    }
+
+    if (pred_.hasFrom || pred_.hasTo) {
+      char key[TimeKeyLen];
+      if (!lineKey(line, len, key)) {
+        return false;
+      }
+      const std::string stamp(key, TimeKeyLen);
+      return stamp >= pred_.fromKey && stamp <= pred_.toKey;
+    }
+    return true;
+  }
+
+  const Predicate& pred_;
+  FindFunc find_;
+  std::string label_;  // "<file>:" when searching several files
+};
+
+/**
+ * @brief Offset of the first line at or after pos
+ */
+std::size_t lineStart(
+    const char* data, const std::size_t size, const std::size_t pos) {
+  if (0 == pos) {
+    return 0;
+  }
+  const char* newline = static_cast<const char*>(
+      std::memchr(data + pos - 1, '\n', size - pos + 1));
+  return newline ? static_cast<std::size_t>(newline - data) + 1 : size;
+}
+
+/**
+ * @brief Offset of the first record at or after pos, skipping continuation
+ * lines, and its time key
+ */
+std::size_t nextRecord(const char* data, const std::size_t size,
+    std::size_t pos, const std::size_t limit, char* key) {
+  for (pos = lineStart(data, size, pos); pos < limit;
+       pos = lineStart(data, size, pos + 1)) {
+    if (lineKey(data + pos, size - pos, key)) {
+      return pos;
+    }
+  }
+  return limit;
+}
+
+/**
+ * @brief Offset of the first record stamped at or after the key
+ *
+ * Records are written in about the order of their times, every record is
+ * stamped at most RangeSlackNs before the ones written ahead of it, so the
+ * callers widen their keys by that much.
+ */
+std::size_t lowerBound(
+    const char* data, const std::size_t size, const std::string& target) {
+  char key[TimeKeyLen];
+  std::size_t lo = 0;
+  std::size_t hi = size;
+  while (lo < hi) {
+    const std::size_t mid = lo + (hi - lo) / 2;
+    const std::size_t pos = nextRecord(data, size, mid, hi, key);
+    if (pos >= hi || 0 >= target.compare(0, TimeKeyLen, key, TimeKeyLen)) {
+      hi = mid;
+    } else {
+      lo = pos + 1;
+    }
+  }
+  return lineStart(data, size, lo);
+}
+
+/**
+ * @brief Narrows [start, end) of a mapped file to the time range
+ */
+void timeRange(const char* data, const std::size_t size,
+    const Predicate& pred, std::size_t& start, std::size_t& end) {
+  char key[TimeKeyLen];
+  if (nextRecord(data, size, 0, std::min(size, ProbeSize), key) >=
+      std::min(size, ProbeSize)) {
+    // not a log of ours or glog's, no times to go by
+    return;
+  }
+
+  if (pred.hasFrom) {
+    start = std::max(start,
+        lowerBound(data, size, timeKey(pred.fromNs - RangeSlackNs)));
+  }
+  if (pred.hasTo) {
+    end = std::min(end,
+        lowerBound(data, size, timeKey(pred.toNs + RangeSlackNs + 1000000)));
+  }
+  if (start > end) {
+    start = end;
+  }
+}
+
+/**
+ * @brief Searches the chunks of a mapped file on several threads and
+ * prints their results in file order
+ */
+class ChunkSearch {
+ public:
+  ChunkSearch(const Matcher& matcher, const bool count,
+      const unsigned threads)
+      : matcher_(matcher), count_(count), threads_(threads) {}
+
+  std::uint64_t run(
+      const char* data, const std::size_t start, const std::size_t end) {
+    const std::size_t size = end;
+    for (std::size_t pos = start; pos < end;) {
+      const std::size_t next =
+          std::min(end, lineStart(data, size, std::min(end, pos + ChunkSize)));
+      chunks_.push_back({data + pos, data + next, std::string(), 0, false});
+      pos = next;
+    }
+
+    next_.store(0, std::memory_order_relaxed);
+    printed_ = 0;
+    std::vector<std::thread> workers;
+    const std::size_t count = std::min<std::size_t>(threads_, chunks_.size());
+    for (std::size_t i = 0; i < count; ++i) {
+      workers.emplace_back([this] { worker(); });
+    }
+
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < chunks_.size(); ++i) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [&] { return chunks_[i].done; });
+      Chunk& chunk = chunks_[i];
+      lock.unlock();
+
+      total += chunk.count;
+      std::fwrite(chunk.out.data(), 1, chunk.out.size(), stdout);
+      std::string().swap(chunk.out);
+
+      lock.lock();
+      ++printed_;
+      lock.unlock();
+      cond_.notify_all();
+    }
+
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    return total;
+  }
+
+ private:
+  struct Chunk {
+    const char* begin;
+    const char* end;
+    std::string out;
+    std::uint64_t count;
+    bool done;
+  };
+
+  void worker() {
+    for (;;) {
+      const std::size_t i = next_.fetch_add(1, std::memory_order_relaxed);
+      if (i >= chunks_.size()) {
+        return;
+      }
+
+      {
+        // stay close to the printer, bounding the results held in memory
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&] { return i < printed_ + 2 * threads_; });
+      }
+
+      Chunk& chunk = chunks_[i];
+      matcher_.scan(
+          chunk.begin, chunk.end, count_ ? nullptr : &chunk.out, chunk.count);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunk.done = true;
+      }
+      cond_.notify_all();
+    }
+  }
+
+  const Matcher& matcher_;
+  const bool count_;
+  const unsigned threads_;
+  std::vector<Chunk> chunks_;
+  std::atomic<std::size_t> next_{0};
+  std::size_t printed_ = 0;  // Chunks printed, guarded by mutex_
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+/**
+ * @brief Searches a plain file mapped in memory
+ *
+ * @return false if the file can not be read
+ */
+bool searchMapped(const std::string& path, const Matcher& matcher,
+    const Predicate& pred, const bool count, const unsigned threads,
+    std::uint64_t& total) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (0 > fd || 0 > ::fstat(fd, &st)) {
+    std::fprintf(stderr, "Error: can not read %s: %s\n", path.c_str(),
+        std::strerror(errno));
+    if (0 <= fd) {
+      ::close(fd);
+    }
+    return false;
+  }
+
+  const std::size_t size = static_cast<std::size_t>(st.st_size);
+  if (0 == size) {
+    ::close(fd);
+    return true;
+  }
+
+  void* map =
+      ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  ::close(fd);
+  if (MAP_FAILED == map) {
+    std::fprintf(stderr, "Error: can not map %s: %s\n", path.c_str(),
+        std::strerror(errno));
+    return false;
+  }
+
+  const char* data  = static_cast<const char*>(map);
+  std::size_t start = 0;
+  std::size_t end   = size;
+  if (pred.hasFrom || pred.hasTo) {
+    const auto index = readIndex(path + mm::detail::LogIndexSuffix);
+    if (!index.empty()) {
+      std::uint64_t first;
+      std::uint64_t last;
+      indexRange(index, pred.fromNs, pred.toNs, first, last);
+      start = static_cast<std::size_t>(std::min<std::uint64_t>(first, size));
+      end   = static_cast<std::size_t>(std::min<std::uint64_t>(last, size));
+    } else {
+      timeRange(data, size, pred, start, end);
+    }
+  }
+
+  (void)(::madvise(map, size, MADV_SEQUENTIAL));
+  ChunkSearch search(matcher, count, threads);
+  total += search.run(data, start, end);
+  ::munmap(map, size);
+  return true;
+}
+
+/**
+ * @brief Searches a compressed segment as it is inflated
+ *
+ * @return false if the file can not be read
+ */
+bool searchStream(const std::string& path, const Matcher& matcher,
+    const Predicate& pred, const bool count, std::uint64_t& total) {
+  std::uint64_t start = 0;
+  std::uint64_t end   = std::numeric_limits<std::uint64_t>::max();
+  if (pred.hasFrom || pred.hasTo) {
+    indexRange(readIndex(path + mm::detail::LogIndexSuffix), pred.fromNs,
+        pred.toNs, start, end);
+  }
+
+  LogFileReader reader;
+  if (!reader.open(path, start, end)) {
+    return false;
+  }
+
+  std::string pending;
+  std::string out;
+  const char* data = nullptr;
+  ssize_t n;
+  while (0 < (n = reader.read(data))) {
+    pending.append(data, static_cast<std::size_t>(n));
+    const std::size_t lines = pending.rfind('\n') + 1;
+    if (0 == lines) {
+      continue;
+    }
+    matcher.scan(pending.data(), pending.data() + lines,
+        count ? nullptr : &out, total);
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    out.clear();
+    pending.erase(0, lines);
+  }
+
+  if (!pending.empty()) {
+    matcher.scan(pending.data(), pending.data() + pending.size(),
+        count ? nullptr : &out, total);
+    std::fwrite(out.data(), 1, out.size(), stdout);
+  }
+  return 0 <= n;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Predicate pred;
+  bool count       = false;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  std::string simd = "auto";
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg   = argv[i];
+    const char* value = std::strchr(arg, '=');
+    value             = value ? value + 1 : "";
+    if (std::strstr(arg, "--text=") == arg) {
+      pred.text = value;
+    } else if (std::strstr(arg, "--level=") == arg) {
+      pred.minRank = levelRank(value[0]);
+      if (0 > pred.minRank || '\0' != value[1]) {
+        std::fprintf(stderr, "Invalid level: %s\n", value);
+        usage(argv[0], 1);
+      }
+    } else if (std::strstr(arg, "--from=") == arg) {
+      pred.hasFrom = parseTime(value, pred.fromNs);
+      if (!pred.hasFrom) {
+        std::fprintf(stderr, "Invalid time: %s\n", value);
+        usage(argv[0], 1);
+      }
+    } else if (std::strstr(arg, "--to=") == arg) {
+      pred.hasTo = parseTime(value, pred.toNs);
+      if (!pred.hasTo) {
+        std::fprintf(stderr, "Invalid time: %s\n", value);
+        usage(argv[0], 1);
+      }
+    } else if (std::strstr(arg, "--threads=") == arg) {
+      threads = static_cast<unsigned>(std::max(1, std::atoi(value)));
+    } else if (std::strstr(arg, "--simd=") == arg) {
+      simd = value;
+    } else if (std::strcmp(arg, "--count") == 0) {
+      count = true;
+    } else if (std::strcmp(arg, "--help") == 0) {
+      usage(argv[0], 0);
+    } else if ('-' == arg[0]) {
+      std::fprintf(stderr, "Unknown option: %s\n", arg);
+      usage(argv[0], 1);
+    } else {
+      files.push_back(arg);
+    }
+  }
+
+  if (files.empty()) {
+    usage(argv[0], 1);
+  }
+
+  const FindFunc find = selectFind(simd);
+  if (!find) {
+    std::fprintf(stderr, "Unsupported --simd=%s on this CPU\n", simd.c_str());
+    return 1;
+  }
+
+  pred.fromKey = pred.hasFrom ? timeKey(pred.fromNs) : std::string();
+  pred.toKey   = pred.hasTo ? timeKey(pred.toNs) : std::string(TimeKeyLen, '~');
+
+  static char output[LogFileReader::ChunkSize];
+  std::setvbuf(stdout, output, _IOFBF, sizeof(output));
+
+  int ecode = 0;
+  for (const auto& file : files) {
+    const std::string label = files.size() > 1 ? file + ":" : std::string();
+    const Matcher matcher(pred, find, label);
+    std::uint64_t total = 0;
+    const bool ok       = endsWith(file, ".gz")
+                              ? searchStream(file, matcher, pred, count, total)
+                              : searchMapped(
+                                    file, matcher, pred, count, threads, total);
+    if (!ok) {
+      ecode = 2;
+    } else if (count) {
+      std::printf("%s%lu\n", label.c_str(), static_cast<unsigned long>(total));
+    }
+  }
+  std::fflush(stdout);
+  return ecode;
+}
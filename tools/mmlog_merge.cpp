@@ -0,0 +1,290 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+// mmlog-merge: joins the files the OptimizedGLog workers write with
+// --workerFiles into one stream ordered by enqueue time. Every record
+// starts with the key described in LogShard.hpp, a worker writes its
+// records about in key order, so the files are merged as they are read and
+// a record is printed once every file is read past its key plus a window.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "LogBloom.hpp"
+#include "LogRecord.hpp"
+#include "LogShard.hpp"
+
+namespace {
+
+using namespace mm::tools;
+
+// How far behind a record may come after another of the same file, the
+// ring modes take the rings in turn so a file is not strictly in order
+constexpr std::uint64_t DefaultWindowMs = 1000;
+
+struct Record {
+  Record() : key(0), input(0), seq(0), text() {}
+
+  std::uint64_t key;
+  std::size_t input;
+  std::uint64_t seq;  // Keeps records of one file and key in file order
+  std::string text;   // Without the key
+
+  bool operator>(const Record& other) const noexcept {
+    if (key != other.key) {
+      return key > other.key;
+    }
+    if (input != other.input) {
+      return input > other.input;
+    }
+    return seq > other.seq;
+  }
+};
+
+void usage(const char* prog, const int ecode) {
+  std::fprintf(stderr,
+      "%s [options] <file>...\n"
+      "  Merges the worker files of OptimizedGLog (--workerFiles), e.g.\n"
+      "  glogs/myapp.w*.20*, into one stream in enqueue order. .gz files\n"
+      "  are decompressed, .idx and .bloom files skipped.\n"
+      "  [--windowMs=<number>]: disorder tolerated within a file "
+      "(default: %lu)\n"
+      "  [--keys]: keep the key of every record\n",
+      prog, static_cast<unsigned long>(DefaultWindowMs));
+  std::exit(ecode);
+}
+
+/**
+ * @brief Splits one file into records, a keyed line and the continuation
+ * lines of its message
+ */
+class RecordReader {
+ public:
+  RecordReader()
+      : reader_(),
+        buffer_(),
+        pos_(0),
+        eof_(false),
+        failed_(false),
+        pending_(),
+        hasPending_(false),
+        seq_(0) {}
+
+  bool open(const std::string& path) { return reader_.open(path); }
+
+  /**
+   * @return false at the end of the file
+   */
+  bool next(Record& record) {
+    const char* line = nullptr;
+    std::size_t len  = 0;
+    while (readLine(line, len)) {
+      std::uint64_t key = 0;
+      if (!mm::detail::parseLogShardKey(line, len, key)) {
+        if (!hasPending_) {
+          // only a file not written by a worker starts without a key
+          pending_.key = 0;
+          pending_.seq = seq_++;
+          pending_.text.clear();
+          hasPending_ = true;
+        }
+        pending_.text.append(line, len);
+        continue;
+      }
+
+      const bool ready = hasPending_;
+      if (ready) {
+        record = std::move(pending_);
+      }
+      pending_.key = key;
+      pending_.seq = seq_++;
+      pending_.text.assign(line + mm::detail::LogShardKeyLen,
+          len - mm::detail::LogShardKeyLen);
+      hasPending_ = true;
+      if (ready) {
+        return true;
+      }
+    }
+
+    if (!hasPending_) {
+      return false;
+    }
+    record      = std::move(pending_);
+    hasPending_ = false;
+    return true;
+  }
+
+  // Whether the file could be read to its end
+  bool failed() const noexcept { return failed_; }
+
+ private:
+  /**
+   * @brief Next line with its newline, valid until the next call
+   */
+  bool readLine(const char*& line, std::size_t& len) {
+    while (true) {
+      const char* start      = buffer_.data() + pos_;
+      const std::size_t left = buffer_.size() - pos_;
+      const char* newline =
+          static_cast<const char*>(std::memchr(start, '\n', left));
+      if (newline) {
+        line = start;
+        len  = static_cast<std::size_t>(newline - start) + 1;
+        pos_ += len;
+        return true;
+      }
+
+      if (eof_) {
+        if (0 == left) {
+          return false;
+        }
+        // a last line without its newline, from a process still writing
+        buffer_ += '\n';
+        continue;
+      }
+
+      buffer_.erase(0, pos_);
+      pos_ = 0;
+
+      const char* data = nullptr;
+      const ssize_t n  = reader_.read(data);
+      if (n <= 0) {
+        failed_ = n < 0;
+        eof_    = true;
+        reader_.close();
+      } else {
+        buffer_.append(data, static_cast<std::size_t>(n));
+      }
+    }
+  }
+
+  LogFileReader reader_;
+  std::string buffer_;  // Lines not consumed yet from pos_ on
+  std::size_t pos_;
+  bool eof_;
+  bool failed_;
+  Record pending_;  // Read up to its last continuation line so far
+  bool hasPending_;
+  std::uint64_t seq_;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::uint64_t windowNs = DefaultWindowMs * 1000000;
+  bool keys              = false;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (std::strstr(arg, "--windowMs=") == arg) {
+      const char* windowMs = std::strchr(arg, '=') + 1;
+      if ('\0' == *windowMs) {
+        std::fprintf(stderr, "\"--windowMs=\" requires a number\n");
+        usage(argv[0], 1);
+      }
+      windowNs = std::strtoull(windowMs, nullptr, 10) * 1000000;
+    } else if (std::strcmp(arg, "--keys") == 0) {
+      keys = true;
+    } else if (std::strcmp(arg, "--help") == 0) {
+      usage(argv[0], 0);
+    } else if ('-' == arg[0]) {
+      std::fprintf(stderr, "Unknown option: %s\n", arg);
+      usage(argv[0], 1);
+    } else if (!endsWith(arg, mm::detail::LogBloomSuffix) &&
+               !endsWith(arg, mm::detail::LogIndexSuffix)) {
+      files.push_back(arg);
+    }
+  }
+  if (files.empty()) {
+    usage(argv[0], 1);
+  }
+
+  int ecode = 0;
+  std::vector<RecordReader> readers(files.size());
+
+  // Files by the key they are read up to, the next record is read from the
+  // one furthest behind
+  using Watermark = std::pair<std::uint64_t, std::size_t>;
+  std::priority_queue<Watermark, std::vector<Watermark>,
+      std::greater<Watermark>>
+      watermarks;
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    if (readers[i].open(files[i])) {
+      watermarks.push({0, i});
+    } else {
+      ecode = 1;
+    }
+  }
+
+  static char output[LogFileReader::ChunkSize];
+  std::setvbuf(stdout, output, _IOFBF, sizeof(output));
+
+  std::priority_queue<Record, std::vector<Record>, std::greater<Record>>
+      records;
+  char key[mm::detail::LogShardKeyLen];
+  auto print = [&records, &key, keys]() {
+    const Record& record = records.top();
+    if (keys) {
+      mm::detail::formatLogShardKey(key, record.key);
+      std::fwrite(key, 1, sizeof(key), stdout);
+    }
+    std::fwrite(record.text.data(), 1, record.text.size(), stdout);
+    records.pop();
+  };
+
+  while (!watermarks.empty()) {
+    const Watermark behind = watermarks.top();
+    watermarks.pop();
+
+    Record record;
+    RecordReader& reader = readers[behind.second];
+    if (reader.next(record)) {
+      record.input = behind.second;
+      watermarks.push({std::max(behind.first, record.key), behind.second});
+      records.push(std::move(record));
+    } else if (reader.failed()) {
+      ecode = 1;
+    }
+
+    // Records up to the window before the file furthest behind are final
+    const std::uint64_t safe =
+        watermarks.empty() ? UINT64_MAX : watermarks.top().first;
+    while (!records.empty() && records.top().key + windowNs <= safe) {
+      print();
+    }
+  }
+  while (!records.empty()) {
+    print();
+  }
+
+  std::fflush(stdout);
+  return ecode;
+}
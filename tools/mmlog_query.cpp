@@ -0,0 +1,204 @@
+/**
+ * SHANGHAI MASTER MATRIX CONFIDENTIAL
+ * Copyright 2018-2023 Shanghai Master Matrix Corporation All Rights Reserved.
+
+ * The source code, information and material ("Material") contained herein is
+ * owned by Shanghai Master Matrix Corporation or its suppliers and licensors,
+ * and title to such Material remains with Shanghai Master Matrix Corporation,
+ * its suppliers or licensors. This Material contains proprietary information
+ * from Shanghai Master Matrix Corporation or its suppliers and its licensors.
+ * The Material is protected by worldwide copyright laws and treaty provision.
+ * No part of the Material could be used, copied, published, modified, posted,
+ * uploaded, reproduced, transmitted, distributed or disclosed anyway without
+ * Shanghai Master Matrix's prior express written permission.No license under
+ * any patent, copyright or other intellectual property right in the Material
+ * is granted to or conferred upon you, either expressly, by any implications,
+ * inducement, estoppel or otherwise. Any license under intellectual property
+ * rights must be authorized by Shanghai Master Matrix Corporation in writing.
+ *
+ * Unless otherwise agreed by Shanghai Master Matrix in writing, you must not
+ * remove or alter this notice or any other notices embedded in this Material
+ * by Shanghai Master Matrix Corporation or its suppliers or licensors anyway.
+ */
+
+// mmlog-query: prints the lines of log files within a time range, seeking
+// with the time index the AsyncFile sink writes next to its segments
+// (--fileIndexKb). Files without an index, glog's included, are scanned
+// from the start and left once past the range.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "LogRecord.hpp"
+
+namespace {
+
+using namespace mm::tools;
+
+struct QueryRange {
+  std::int64_t fromNs;
+  std::int64_t toNs;
+  std::string fromKey;  // Lines below are skipped
+  std::string toKey;    // Lines above are skipped
+  std::string stopKey;  // Lines above end the file
+};
+
+void usage(const char* prog, const int ecode) {
+  std::fprintf(stderr,
+      "%s --from=<time> --to=<time> <file>...\n"
+      "  Prints the lines of the files stamped within [from, to], <time> is\n"
+      "  \"YYYY-mm-dd HH:MM:SS[.mmm]\" in local time. A file with a\n"
+      "  <file>.idx time index is read from the range only, .gz files are\n"
+      "  decompressed.\n",
+      prog);
+  std::exit(ecode);
+}
+
+/**
+ * @brief Splits a stream into lines and prints those within the range
+ */
+class LineFilter {
+ public:
+  explicit LineFilter(const QueryRange& range)
+      : range_(range), partial_(), inRange_(false), done_(false) {}
+
+  /**
+   * @return false once past the range
+   */
+  bool feed(const char* data, std::size_t len) {
+    while (len > 0 && !done_) {
+      const char* newline =
+          static_cast<const char*>(std::memchr(data, '\n', len));
+      if (!newline) {
+        partial_.append(data, len);
+        break;
+      }
+
+      const std::size_t lineLen = static_cast<std::size_t>(newline - data);
+      if (partial_.empty()) {
+        line(data, lineLen + 1);
+      } else {
+        partial_.append(data, lineLen + 1);
+        line(partial_.data(), partial_.size());
+        partial_.clear();
+      }
+      data += lineLen + 1;
+      len -= lineLen + 1;
+    }
+    return !done_;
+  }
+
+  void finish() {
+    if (!partial_.empty() && !done_) {
+      partial_ += '\n';
+      line(partial_.data(), partial_.size());
+    }
+    partial_.clear();
+  }
+
+ private:
+  void line(const char* data, const std::size_t len) {
+    if ('\0' == data[0]) {
+      // the zeros behind the data of a crashed mmap segment
+      done_ = true;
+      return;
+    }
+
+    char key[TimeKeyLen];
+    if (lineKey(data, len, key)) {
+      const std::string stamp(key, TimeKeyLen);
+      if (stamp > range_.stopKey) {
+        done_ = true;
+        return;
+      }
+      inRange_ = stamp >= range_.fromKey && stamp <= range_.toKey;
+    }
+
+    // continuation lines go with the line before them
+    if (inRange_) {
+      std::fwrite(data, 1, len, stdout);
+    }
+  }
+
+  const QueryRange& range_;
+  std::string partial_;  // Line cut by the end of a chunk
+  bool inRange_;
+  bool done_;
+};
+
+/**
+ * @brief Prints the lines of path within the range
+ *
+ * @return false if the file can not be read
+ */
+bool queryFile(const std::string& path, const QueryRange& range) {
+  std::uint64_t start;
+  std::uint64_t end;
+  indexRange(readIndex(path + mm::detail::LogIndexSuffix), range.fromNs,
+      range.toNs, start, end);
+
+  LogFileReader reader;
+  if (!reader.open(path, start, end)) {
+    return false;
+  }
+
+  LineFilter filter(range);
+  const char* data = nullptr;
+  ssize_t n;
+  while (0 < (n = reader.read(data)) &&
+         filter.feed(data, static_cast<std::size_t>(n))) {
+  }
+  filter.finish();
+  return 0 <= n;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const char* from = nullptr;
+  const char* to   = nullptr;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (std::strstr(arg, "--from=") == arg) {
+      from = std::strchr(arg, '=') + 1;
+    } else if (std::strstr(arg, "--to=") == arg) {
+      to = std::strchr(arg, '=') + 1;
+    } else if (std::strcmp(arg, "--help") == 0) {
+      usage(argv[0], 0);
+    } else if ('-' == arg[0]) {
+      std::fprintf(stderr, "Unknown option: %s\n", arg);
+      usage(argv[0], 1);
+    } else {
+      files.push_back(arg);
+    }
+  }
+
+  QueryRange range;
+  if (!from || !to || files.empty()) {
+    usage(argv[0], 1);
+  }
+  if (!parseTime(from, range.fromNs) || !parseTime(to, range.toNs)) {
+    std::fprintf(stderr, "Invalid time, expected YYYY-mm-dd HH:MM:SS[.mmm]\n");
+    usage(argv[0], 1);
+  }
+  range.fromKey = timeKey(range.fromNs);
+  range.toKey   = timeKey(range.toNs);
+  range.stopKey = timeKey(range.toNs + RangeSlackNs);
+
+  static char output[LogFileReader::ChunkSize];
+  std::setvbuf(stdout, output, _IOFBF, sizeof(output));
+
+  int ecode = 0;
+  for (const auto& file : files) {
+    if (!queryFile(file, range)) {
+      ecode = 1;
+    }
+  }
+  std::fflush(stdout);
+  return ecode;
+}